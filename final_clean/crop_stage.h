@@ -1,7 +1,7 @@
 #pragma once
 #include "src/globals.h"
 #include <merge_b.h>
+#include "src/crops/crop_queue.h"
 
 
-void crops_reset();
-void crops_save_from_last_frame();
+void crops_extract_from_frame(const BeeDetections& dets, CropBatch& batch);
@@ -1,62 +1,80 @@
 #include "crop_stage.h"
 #include "src/sd/sd_core.h"
-#include "src/ui/ui_web.h"
 #include "src/util.h"
+#include "src/sd/sd_writer.h"
+#include "src/log/evlog.h"
+#include "src/camera/camera_ei.h"
+#include "src/camera/jpeg_decode.h"
+#include "src/metrics/metrics.h"
+#include "src/track/bee_tracker.h"
+
+// ---- spatial de-duplication ----
+// Kept windows are bucketed by the grid cell of their top-left corner, one
+// cell per CROP_SIZE, so any window that overlaps a new one sits in the same
+// or a neighbouring cell and a lookup checks at most nine short lists.
+// Frames wider than the grid fold into its last row/column, which keeps
+// neighbours neighbours.
+static constexpr int CROP_GRID_DIM = 16;
+
+struct CropGrid {
+  int16_t head[CROP_GRID_DIM * CROP_GRID_DIM];
+  int16_t next[MAX_CROPS];   // by slot
+};
+
+static inline int crop_grid_cell(int v) {
+  const int c = v / CROP_SIZE;
+  return c < CROP_GRID_DIM ? c : CROP_GRID_DIM - 1;
+}
 
-#include <memory>
-#include "img_converters.h"
-
-void crops_reset() { g_crop_count = 0; }
-
-static uint32_t read_centers_txt(uint32_t idx[], float cx[], float cy[], float sc[],
-                                 char lab[][12], uint32_t maxn) {
-  if (!g_sd_ok) return 0;
-
-  File f = SD_MMC.open(g_last_meta_path, FILE_READ);
-  if (!f) return 0;
-
-  uint32_t n=0;
-  while (f.available() && n<maxn) {
-    String line = f.readStringUntil('\n');
-    if (line.length()<3) continue;
-
-    unsigned ii=0;
-    float x=0,y=0,s=0;
-    char lbuf[16]={0};
+// IoU of two CROP_SIZE windows given their corners.
+static inline float crop_window_iou(int ax, int ay, int bx, int by) {
+  const int ix = CROP_SIZE - abs(ax - bx);
+  const int iy = CROP_SIZE - abs(ay - by);
+  if (ix <= 0 || iy <= 0) return 0.0f;
+  const float inter = (float)ix * (float)iy;
+  return inter / (2.0f * CROP_SIZE * CROP_SIZE - inter);
+}
 
-    int m = sscanf(line.c_str(), "%u %f %f %f %15s", &ii, &x, &y, &s, lbuf);
-    if (m==5) {
-      idx[n]=ii; cx[n]=x; cy[n]=y; sc[n]=s;
-      memset(lab[n],0,12);
-      strncpy(lab[n], lbuf, 11);
-      n++;
+// Slot of the kept window overlapping (x0, y0) the most at or above
+// CROP_DEDUP_IOU, or -1.
+static int crop_grid_find(const CropGrid& g, const CropBatch& batch, int x0, int y0, float& iou_out) {
+  const int cx = crop_grid_cell(x0), cy = crop_grid_cell(y0);
+  int best = -1;
+  float best_iou = CROP_DEDUP_IOU;
+  for (int gy = cy - 1; gy <= cy + 1; ++gy) {
+    if (gy < 0 || gy >= CROP_GRID_DIM) continue;
+    for (int gx = cx - 1; gx <= cx + 1; ++gx) {
+      if (gx < 0 || gx >= CROP_GRID_DIM) continue;
+      for (int s = g.head[gy * CROP_GRID_DIM + gx]; s >= 0; s = g.next[s]) {
+        const CropTile* t = crop_batch_at(batch, (uint32_t)s);
+        const float iou = crop_window_iou(x0, y0, t->x0, t->y0);
+        if (iou >= best_iou) { best = s; best_iou = iou; }
+      }
     }
   }
-  f.close();
-  return n;
+  iou_out = best_iou;
+  return best;
 }
 
-void crops_save_from_last_frame() {
-  if (!sd_writes_enabled()) { sdlog_printf("CROPS skip (saving disabled)\n"); crops_reset(); return; }
-  crops_reset();
-
-  uint32_t idx[MAX_CROPS]; float cx[MAX_CROPS], cy[MAX_CROPS], sc[MAX_CROPS]; char lab[MAX_CROPS][12];
-  uint32_t n = read_centers_txt(idx, cx, cy, sc, lab, MAX_CROPS);
-  if (n == 0) { sdlog_printf("CROPS skip (no centers)\n"); return; }
-
-  File jf = SD_MMC.open(g_last_frame_path, FILE_READ);
-  if (!jf) { sdlog_printf("CROPS fail open frame path=%s\n", g_last_frame_path); return; }
-
-  size_t sz = jf.size();
-  std::unique_ptr<uint8_t[]> jpg(new uint8_t[sz]);
-  if (!jpg) { jf.close(); sdlog_printf("CROPS oom jpg sz=%lu\n", (unsigned long)sz); return; }
+static void crop_grid_add(CropGrid& g, uint32_t slot, int x0, int y0) {
+  int16_t& h = g.head[crop_grid_cell(y0) * CROP_GRID_DIM + crop_grid_cell(x0)];
+  g.next[slot] = h;
+  h = (int16_t)slot;
+}
 
-  size_t r = jf.read(jpg.get(), sz);
-  jf.close();
-  if (r != sz) { sdlog_printf("CROPS read mismatch got=%lu expected=%lu\n", (unsigned long)r, (unsigned long)sz); return; }
+// Cuts one CROP_SIZE tile per bee centre into a batch of the PSRAM crop
+// ring. Centres are taken best score first; one whose window overlaps a
+// kept window by CROP_DEDUP_IOU or more is merged into that crop instead of
+// being cut again. Pixels come from g_fullstage_buf, or, with
+// CAPTURE_SCALED_DECODE, from a windowed full-resolution decode of the held
+// JPEG. Audit JPEGs are handed to the SD writer.
+void crops_extract_from_frame(const BeeDetections& dets, CropBatch& batch) {
+  MetricScope m(Metric::CropExtract);
+  crop_batch_begin(batch, g_frame_counter);
 
-  bool ok = fmt2rgb888(jpg.get(), sz, PIXFORMAT_JPEG, g_fullstage_buf);
-  if (!ok) { sdlog_printf("CROPS decode full frame failed\n"); return; }
+  const uint32_t n = dets.count;
+  if (n == 0) { EVLOG(CROPS_SKIP_NO_CENTERS); return; }
+  if (!CAPTURE_SCALED_DECODE && !g_fullstage_buf) { EVLOG(CROPS_SKIP_NO_FRAME); return; }
 
   int crop_x, crop_y, crop_w, crop_h;
   float scale_x, scale_y;
@@ -65,16 +83,29 @@ void crops_save_from_last_frame() {
                    crop_x, crop_y, crop_w, crop_h, scale_x, scale_y);
 
   const int half = CROP_SIZE / 2;
-  const size_t PIXELS = (size_t)CROP_SIZE * CROP_SIZE;
+  const bool audit = SAVE_CROPS_TO_SD && sd_writes_enabled();
+  const bool dedup = CROP_DEDUP_IOU <= 1.0f;
+  static JpegWindow windows[MAX_CROPS];
+  static CropGrid grid;
+  memset(grid.head, 0xff, sizeof(grid.head));
+
+  // best score first, so the window kept for a cluster is its strongest bee
+  uint8_t order[MAX_CROPS];
+  for (uint32_t i = 0; i < n; ++i) {
+    uint32_t j = i;
+    for (; j > 0 && dets.items[order[j - 1]].score < dets.items[i].score; --j) order[j] = order[j - 1];
+    order[j] = (uint8_t)i;
+  }
 
-  sdlog_printf("CROPS start n=%lu CROP_SIZE=%d\n", (unsigned long)n, CROP_SIZE);
+  EVLOG(CROPS_START, (unsigned long)n, CROP_SIZE);
 
-  for (uint32_t i = 0; i < n && g_crop_count < MAX_CROPS; ++i) {
-    web_pump();
+  uint32_t merged = 0;
+  for (uint32_t k = 0; k < n; ++k) {
     if (should_abort()) break;
 
-    int cxf = (int)lrintf((float)crop_x + cx[i] * scale_x);
-    int cyf = (int)lrintf((float)crop_y + cy[i] * scale_y);
+    const BeeDetection& d = dets.items[order[k]];
+    int cxf = (int)lrintf((float)crop_x + d.cx * scale_x);
+    int cyf = (int)lrintf((float)crop_y + d.cy * scale_y);
 
     int x0 = cxf - half;
     int y0 = cyf - half;
@@ -83,48 +114,61 @@ void crops_save_from_last_frame() {
     if (x0 > (int)g_full_w - CROP_SIZE) x0 = (int)g_full_w - CROP_SIZE;
     if (y0 > (int)g_full_h - CROP_SIZE) y0 = (int)g_full_h - CROP_SIZE;
 
-    for (int y = 0; y < CROP_SIZE; ++y) {
-      const uint8_t* src = g_fullstage_buf + ((size_t)(y0 + y) * g_full_w + x0) * 3;
-      memcpy(g_crop_rgb + (size_t)y * CROP_SIZE * 3, src, (size_t)CROP_SIZE * 3);
+    if (dedup) {
+      float iou = 0.0f;
+      const int hit = crop_grid_find(grid, batch, x0, y0, iou);
+      if (hit >= 0) {
+        crop_batch_at(batch, (uint32_t)hit)->bees++;
+        if (d.track) tracker_bind(d.track, batch.frame, (uint32_t)hit, millis());
+        merged++;
+        EVLOG(CROP_MERGED, (double)d.score, (double)d.cx, (double)d.cy, (unsigned long)hit, (double)iou);
+        continue;
+      }
     }
 
-    bgr_to_rgb_inplace(g_crop_rgb, PIXELS);
+    CropTile* t = crop_batch_push(batch);
+    if (!t) { EVLOG(CROPS_QUEUE_FULL, (unsigned long)crop_queue_capacity()); break; }
 
-    uint8_t* jbuf = nullptr; size_t jlen = 0;
-    bool enc = fmt2jpg(g_crop_rgb, PIXELS * 3, CROP_SIZE, CROP_SIZE, PIXFORMAT_RGB888,
-                       JPEG_QUALITY, &jbuf, &jlen);
-    if (!enc || !jbuf || !jlen) { sdlog_printf("CROPS encode fail i=%lu\n", (unsigned long)i); if (jbuf) free(jbuf); continue; }
+    if (CAPTURE_SCALED_DECODE) {
+      windows[batch.count - 1] = { (uint16_t)x0, (uint16_t)y0, (uint16_t)CROP_SIZE, (uint16_t)CROP_SIZE, t->rgb };
+    } else {
+      for (int y = 0; y < CROP_SIZE; ++y) {
+        const uint8_t* src = g_fullstage_buf + ((size_t)(y0 + y) * g_full_w + x0) * 3;
+        memcpy(t->rgb + (size_t)y * CROP_SIZE * 3, src, (size_t)CROP_SIZE * 3);
+      }
+    }
 
-    char path[64]; int score_i = (int)lrintf(sc[i] * 100.0f);
-    snprintf(path, sizeof(path), "%s/%06lu_%02lu_%s_%u.jpg",
-             g_crops_dir,
-             (unsigned long)g_frame_counter,
-             (unsigned long)g_crop_count,
-             lab[i],
-             (unsigned)score_i);
+    t->bbox_index = d.bbox_index;
+    t->bees = 1;
+    t->x0 = x0;
+    t->y0 = y0;
+    t->score = d.score;
+    memcpy(t->label, d.label, sizeof(t->label));
+    if (dedup) crop_grid_add(grid, t->slot, x0, y0);
+    if (d.track) tracker_bind(d.track, batch.frame, t->slot, millis());
+
+    EVLOG(CROP,
+          (unsigned long)t->slot, (double)d.score, (double)d.cx, (double)d.cy, x0, y0);
+  }
 
-    File f = SD_MMC.open(path, FILE_WRITE);
-    if (!f) { sdlog_printf("SAVE_FAIL crop_jpg path=%s\n", path); free(jbuf); continue; }
+  if (merged) EVLOG(CROPS_DEDUP, (unsigned long)n, (unsigned long)batch.count, (unsigned long)merged);
 
-    size_t w = f.write(jbuf, jlen);
-    f.close();
-    free(jbuf);
+  if (CAPTURE_SCALED_DECODE && batch.count > 0 && !camera_decode_windows(windows, batch.count)) {
+    EVLOG(CROPS_DECODE_FAIL, (unsigned long)batch.count);
+    crop_batch_discard(batch);
+    crop_batch_begin(batch, g_frame_counter);
+  }
 
-    if (w != jlen) {
-      sdlog_printf("SAVE_FAIL crop_jpg incomplete path=%s wrote=%lu expected=%lu\n",
-                   path, (unsigned long)w, (unsigned long)jlen);
-      continue;
+  if (audit) {
+    for (uint32_t i = 0; i < batch.count; ++i) {
+      const CropTile* t = crop_batch_at(batch, i);
+      char base[48], path[128];
+      crop_tile_basename(*t, base, sizeof(base));
+      snprintf(path, sizeof(path), "%s/%s.jpg", g_crops_dir, base);
+      (void)sd_writer_submit_packed_jpeg(path, t->frame, t->rgb, CROP_SIZE, CROP_SIZE, JPEG_QUALITY,
+                                         SdPriority::Low, "crop_jpg");
     }
-
-    g_crop_meta[g_crop_count].bbox_index = idx[i];
-    strncpy(g_crop_meta[g_crop_count].path, path, sizeof(g_crop_meta[g_crop_count].path) - 1);
-    g_crop_meta[g_crop_count].path[sizeof(g_crop_meta[g_crop_count].path) - 1] = 0;
-
-    sdlog_printf("SAVE_OK crop_jpg path=%s score=%.3f center=(%.1f,%.1f) full_roi=(%d,%d)\n",
-                 path, (double)sc[i], (double)cx[i], (double)cy[i], x0, y0);
-
-    g_crop_count++;
   }
 
-  sdlog_printf("CROPS done saved=%lu\n", (unsigned long)g_crop_count);
+  EVLOG(CROPS_DONE, (unsigned long)batch.count);
 }
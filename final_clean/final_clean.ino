@@ -7,8 +7,17 @@
 #include "src/globals.h"
 #include "src/sd/sd_core.h"
 #include "src/ui/ui_web.h"
+#include "src/ui/live_stream.h"
+#include "src/ui/sse.h"
 #include "src/camera/camera_ei.h"
+#include "src/camera/jpeg_decode.h"
+#include "src/camera/motion_gate.h"
 #include "src/hardware/led_status.h"
+#include "src/crops/crop_queue.h"
+#include "src/sd/sd_writer.h"
+#include "src/sd/storage.h"
+#include "src/log/evlog.h"
+#include "src/sched/scheduler.h"
 #include "pipeline.h"
 
 void setup() {
@@ -16,6 +25,7 @@ void setup() {
   Serial.println("EI Inferencing");
 
   led_init();
+  if (!evlog_begin()) Serial.println("WARN: log ring alloc failed, logging to Serial only");
 
   // allocate buffers
   size_t in_bytes = (size_t)EI_CLASSIFIER_INPUT_WIDTH * EI_CLASSIFIER_INPUT_HEIGHT * EI_CAMERA_FRAME_BYTE_SIZE;
@@ -23,32 +33,41 @@ void setup() {
   if (!snapshot_buf) snapshot_buf = (uint8_t*)malloc(in_bytes);
   if (!snapshot_buf) { Serial.println("ERR: snapshot_buf alloc!"); while (true) delay(1000); }
 
-  size_t full_bytes = (size_t)FULL_W * FULL_H * 3;
-  g_fullstage_buf = (uint8_t*)ps_malloc(full_bytes);
-  if (!g_fullstage_buf) g_fullstage_buf = (uint8_t*)malloc(full_bytes);
-  if (!g_fullstage_buf) { Serial.println("ERR: full buffer alloc!"); while (true) delay(1000); }
-
-  g_crop_rgb = (uint8_t*)ps_malloc((size_t)CROP_SIZE * CROP_SIZE * 3);
-  if (!g_crop_rgb) g_crop_rgb = (uint8_t*)malloc((size_t)CROP_SIZE * CROP_SIZE * 3);
-  if (!g_crop_rgb) { Serial.println("ERR: crop buffer alloc!"); while (true) delay(1000); }
-
-  size_t ov_bytes = (size_t)EI_CLASSIFIER_INPUT_WIDTH * EI_CLASSIFIER_INPUT_HEIGHT * 3;
-  g_bee_overlay_buf = (uint8_t*)ps_malloc(ov_bytes);
-  if (!g_bee_overlay_buf) g_bee_overlay_buf = (uint8_t*)malloc(ov_bytes);
-  if (!g_bee_overlay_buf) { Serial.println("ERR: bee overlay buffer alloc!"); while (true) delay(1000); }
-
-  size_t var_bytes = (size_t)EI_VARROA_INPUT_WIDTH * EI_VARROA_INPUT_HEIGHT * 3;
-  g_var_snapshot_buf = (uint8_t*)ps_malloc(var_bytes);
-  if (!g_var_snapshot_buf) g_var_snapshot_buf = (uint8_t*)malloc(var_bytes);
-
-  g_var_overlay_buf = (uint8_t*)ps_malloc(var_bytes);
-  if (!g_var_overlay_buf) g_var_overlay_buf = (uint8_t*)malloc(var_bytes);
+  if (CAPTURE_SCALED_DECODE) {
+    const jpg_scale_t s = jpeg_pick_scale(FULL_W, FULL_H, EI_CLASSIFIER_INPUT_WIDTH, EI_CLASSIFIER_INPUT_HEIGHT);
+    g_stage1_bytes = (size_t)jpeg_scaled_dim(FULL_W, s) * jpeg_scaled_dim(FULL_H, s) * 3;
+    g_stage1_buf = (uint8_t*)ps_malloc(g_stage1_bytes);
+    if (!g_stage1_buf) g_stage1_buf = (uint8_t*)malloc(g_stage1_bytes);
+    if (!g_stage1_buf) { Serial.println("ERR: stage 1 buffer alloc!"); while (true) delay(1000); }
+  } else {
+    size_t full_bytes = (size_t)FULL_W * FULL_H * 3;
+    g_fullstage_buf = (uint8_t*)ps_malloc(full_bytes);
+    if (!g_fullstage_buf) g_fullstage_buf = (uint8_t*)malloc(full_bytes);
+    if (!g_fullstage_buf) { Serial.println("ERR: full buffer alloc!"); while (true) delay(1000); }
+  }
 
-  if (!g_var_snapshot_buf || !g_var_overlay_buf) {
-    Serial.println("ERR: varroa buffers alloc!");
-    while (true) delay(1000);
+  // one frame's worth of crops per pipeline stage
+  const uint32_t want_tiles = PIPELINE_DUAL_CORE ? 2u * MAX_CROPS : (uint32_t)MAX_CROPS;
+  if (!crop_queue_init(want_tiles)) { Serial.println("ERR: crop queue alloc!"); while (true) delay(1000); }
+  if (crop_queue_capacity() < want_tiles)
+    Serial.printf("WARN: crop queue holds %lu of %lu crops\n", (unsigned long)crop_queue_capacity(), (unsigned long)want_tiles);
+
+  // crops at the varroa input size are classified in place
+  if (CROP_SIZE != EI_VARROA_INPUT_WIDTH || CROP_SIZE != EI_VARROA_INPUT_HEIGHT) {
+    size_t var_bytes = (size_t)EI_VARROA_INPUT_WIDTH * EI_VARROA_INPUT_HEIGHT * 3;
+    g_var_snapshot_buf = (uint8_t*)ps_malloc(var_bytes);
+    if (!g_var_snapshot_buf) g_var_snapshot_buf = (uint8_t*)malloc(var_bytes);
+
+    if (!g_var_snapshot_buf) {
+      Serial.println("ERR: varroa buffers alloc!");
+      while (true) delay(1000);
+    }
   }
 
+  if (MOTION_GATE && !motion_gate_begin()) Serial.println("WARN: motion gate buffer alloc failed, every frame runs");
+  if (!live_stream_begin()) Serial.println("WARN: live view buffers alloc failed, /stream disabled");
+  if (!sse_begin()) Serial.println("WARN: event ring alloc failed, /api/events disabled");
+
   // camera
   if (!camera_init_ei()) Serial.println("Failed to initialize Camera!");
 
@@ -62,25 +81,32 @@ void setup() {
       g_save_enabled = false;
       g_infer_enabled = false;
     } else {
-      sdlog_printf("LOG_PATH=%s\n", g_log_path);
+      if (!sd_writer_begin()) Serial.println("WARN: SD writer task not started, saves disabled");
+      if (!storage_begin()) Serial.println("WARN: storage tables alloc failed, old boots are not reclaimed");
+      EVLOG(LOG_PATH, g_log_path);
     }
-    web_begin();
+    if (!web_begin()) Serial.println("WARN: web task not started, serving from loop()");
   }
 
-  last_infer_ms = 0;
+  if (!evlog_start_flush()) Serial.println("WARN: log flush task not started");
+  if (!pipeline_begin()) Serial.println("WARN: varroa task not started, running stages serially");
 }
 
 void loop() {
   web_pump();
 
   if (!g_infer_enabled) {
+    storage_step(STORAGE_MIN_GAP_MS);   // paused: every gap is idle
     delay(5);
     return;
   }
 
   const uint32_t now = millis();
-  if (last_infer_ms == 0 || (now - last_infer_ms) >= INFER_PERIOD_MS) {
-    last_infer_ms = now;
-    pipeline_run_once();
+  if (sched_due(now)) {
+    sched_cycle_start();
+    const CycleResult r = pipeline_run_once();
+    sched_cycle_done(r.bees, r.gated, now, millis());
+  } else {
+    storage_step(sched_wait_ms(now));
   }
 }
@@ -1,4 +1,13 @@
 #pragma once
 #include "src/globals.h"
 
-void pipeline_run_once();
+bool pipeline_begin();
+// What one cycle saw, for the scheduler.
+struct CycleResult {
+  uint32_t bees;   // bee centres the frame held; 0 when it failed
+  bool gated;      // the motion gate dropped the frame before stage 1
+};
+
+// One capture + stage 1 cycle (stage 2 too when not pipelined).
+CycleResult pipeline_run_once();
+void pipeline_drain();
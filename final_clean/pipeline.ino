@@ -1,105 +1,235 @@
 #include "pipeline.h"
-#include "src/ui/ui_web.h"
 #include "src/camera/camera_ei.h"
 #include "bee_stage.h"
 #include "crop_stage.h"
 #include "varroa_stage.h"
 #include "src/hardware/led_status.h"
 #include "src/sd/sd_core.h"
+#include "src/crops/crop_queue.h"
+#include "src/sd/sd_writer.h"
+#include "src/log/evlog.h"
+#include "src/overlay/det_record.h"
+#include "src/metrics/metrics.h"
+#include "src/track/bee_tracker.h"
+#include "src/ui/live_stream.h"
+#include "src/ui/sse.h"
 
 #include <merge_b.h>
 #include "src/ei/ei_signal_shim.h"
 
+// Stage 1 -> stage 2 handoff. The queue holds one frame so capture of
+// frame N+1 overlaps the varroa pass over frame N, and no further.
+struct VarroaJob {
+  CropBatch batch;
+  uint32_t bees;
+  uint32_t centers;
+  uint32_t start_us;    // capture start, for Metric::Frame
+  BeeDetections dets;   // for the frame's detection record
+};
+
+static QueueHandle_t g_varroa_jobs = nullptr;
+static portMUX_TYPE g_inflight_mux = portMUX_INITIALIZER_UNLOCKED;
+static volatile uint32_t g_inflight = 0;
+
+static void inflight_add(int32_t d) {
+  portENTER_CRITICAL(&g_inflight_mux);
+  g_inflight += d;
+  portEXIT_CRITICAL(&g_inflight_mux);
+}
+
 
-static void maybe_finalize_round_and_log() {
-  if (g_round_bees < TARGET_BEES_PER_ROUND) return;
+static void maybe_finalize_round_and_log(const CountSnapshot& c) {
+  if (c.round_bees < TARGET_BEES_PER_ROUND) return;
 
-  const double round_pct = (g_round_bees > 0)
-    ? (100.0 * (double)g_round_mites / (double)g_round_bees)
+  const double round_pct = (c.round_bees > 0)
+    ? (100.0 * (double)c.round_mites / (double)c.round_bees)
     : 0.0;
 
-  const double avg_weighted = (g_total_bees > 0)
-    ? (100.0 * (double)g_total_mites / (double)g_total_bees)
+  const double avg_weighted = (c.total_bees > 0)
+    ? (100.0 * (double)c.total_mites / (double)c.total_bees)
+    : 0.0;
+
+  EVLOG(ROUND_DONE,
+        (unsigned long)c.round_bees,
+        (unsigned long)c.round_mites,
+        round_pct,
+        avg_weighted,
+        (unsigned long)c.total_bees,
+        (unsigned long)c.total_mites);
+
+  counters_reset_round();
+}
+
+// Pushes the frame's counts to the web UI's event stream.
+static void publish_cycle(uint32_t frame, uint32_t bees, uint32_t mites, const CountSnapshot& c) {
+  const double avg_weighted = (c.total_bees > 0)
+    ? (100.0 * (double)c.total_mites / (double)c.total_bees)
     : 0.0;
 
-  sdlog_printf("[ROUND DONE] bees=%lu mites=%lu => %.2f%% | avg_weighted=%.2f%% | totals bees=%lu mites=%lu\n",
-               (unsigned long)g_round_bees,
-               (unsigned long)g_round_mites,
-               round_pct,
-               avg_weighted,
-               (unsigned long)g_total_bees,
-               (unsigned long)g_total_mites);
+  char json[192];
+  snprintf(json, sizeof(json),
+           "{\"frame\":%lu,\"new_bees\":%lu,\"new_mites\":%lu,\"bees\":%lu,\"mites\":%lu,"
+           "\"avg_weighted\":%.2f,\"round_bees\":%lu,\"round_mites\":%lu}",
+           (unsigned long)frame, (unsigned long)bees, (unsigned long)mites,
+           (unsigned long)c.total_bees, (unsigned long)c.total_mites, avg_weighted,
+           (unsigned long)c.round_bees, (unsigned long)c.round_mites);
+  (void)sse_publish("cycle", json);
+}
+
+// Stage 2 plus bookkeeping for one frame; runs on the varroa task when
+// pipelined, inline otherwise.
+static void finish_frame(VarroaJob& job) {
+  uint32_t mites_this = 0;
+
+  // one frame at a time: either the varroa task or, unpipelined, the loop
+  static DetRecord rec;
+  det_record_begin(rec, job.batch.frame, job.dets,
+                   EI_CLASSIFIER_INPUT_WIDTH, EI_CLASSIFIER_INPUT_HEIGHT,
+                   EI_VARROA_INPUT_WIDTH, EI_VARROA_INPUT_HEIGHT);
+
+  if (job.batch.count > 0) mites_this = varroa_run_on_batch_and_count(job.batch, rec);
+  else EVLOG(VARROA_SKIP,
+             (unsigned long)job.batch.frame, (unsigned long)job.centers);
+
+  if (TRACK_BEES) tracker_unbind(job.batch.frame);   // crops that got no result
+  crop_batch_release(job.batch);
+  (void)det_record_submit(rec);
+
+  const CountSnapshot c = counters_add_cycle(job.bees, mites_this);
+  publish_cycle(job.batch.frame, job.bees, mites_this, c);
+
+  led_update_from_avg_weighted();
+
+  EVLOG(CYCLE_SUMMARY,
+        (unsigned long)job.batch.frame,
+        (unsigned long)job.bees,
+        (unsigned long)mites_this,
+        (unsigned long)c.round_bees,
+        (unsigned long)TARGET_BEES_PER_ROUND,
+        (unsigned long)c.round_mites,
+        (unsigned long)c.total_bees,
+        (unsigned long)c.total_mites);
+
+  const SdWriterStats w = sd_writer_stats();
+  EVLOG(SDW_STATS,
+        (unsigned long)w.jobs_done, (unsigned long)w.jobs_failed, (unsigned long)w.jobs_dropped,
+        (unsigned long)w.queued_jobs, (unsigned long)w.queued_bytes, (unsigned long)w.peak_jobs,
+        (unsigned long long)w.bytes_written,
+        (unsigned long)(w.last_latency_us / 1000), (unsigned long)(w.max_latency_us / 1000));
+
+  maybe_finalize_round_and_log(c);
+  metrics_record(Metric::Frame, metrics_now_us() - job.start_us);
+}
+
+static void varroa_task(void*) {
+  static VarroaJob job;
+  while (true) {
+    if (xQueueReceive(g_varroa_jobs, &job, portMAX_DELAY) != pdTRUE) continue;
+    finish_frame(job);
+    inflight_add(-1);
+  }
+}
+
+bool pipeline_begin() {
+  if (!PIPELINE_DUAL_CORE || g_varroa_jobs) return true;
+
+  g_varroa_jobs = xQueueCreate(1, sizeof(VarroaJob));
+  if (!g_varroa_jobs) return false;
 
-  g_round_bees = 0;
-  g_round_mites = 0;
+  return xTaskCreatePinnedToCore(varroa_task, "varroa", VARROA_TASK_STACK, nullptr, 1,
+                                 nullptr, VARROA_TASK_CORE) == pdPASS;
 }
 
-void pipeline_run_once() {
-  web_pump();
-  if (should_abort()) return;
+CycleResult pipeline_run_once() {
+  if (should_abort()) return {};
 
-  sdlog_printf("\n=== CYCLE frame=%lu millis=%lu ===\n",
-               (unsigned long)g_frame_counter, (unsigned long)millis());
+  const uint32_t start_ms = millis();
+  MetricScope cycle(Metric::Cycle);
+  const uint32_t start_us = metrics_now_us();
 
-  if (!camera_capture_ei(EI_CLASSIFIER_INPUT_WIDTH, EI_CLASSIFIER_INPUT_HEIGHT, snapshot_buf)) {
-    sdlog_printf("CYCLE fail capture\n");
+  const CaptureResult cap = camera_capture_ei(EI_CLASSIFIER_INPUT_WIDTH, EI_CLASSIFIER_INPUT_HEIGHT, snapshot_buf);
+  // a motion-gated frame is no cycle: it logs MOTION_SKIP and keeps its number
+  if (cap == CaptureResult::Unchanged) return { 0, true };
+  EVLOG(CYCLE_START, (unsigned long)g_frame_counter, (unsigned long)start_ms);
+  if (cap != CaptureResult::Ok) {
+    EVLOG(CYCLE_FAIL_CAPTURE);
     g_frame_counter++;
-    return;
+    return {};
   }
 
-  web_pump();
-  if (should_abort()) return;
+  if (should_abort()) return {};
 
   ei::signal_t signal;
   signal.total_length = EI_CLASSIFIER_INPUT_WIDTH * EI_CLASSIFIER_INPUT_HEIGHT;
   signal.get_data = &ei_bee_get_data;
 
+  // static: the bee list makes the job too big for the loop task's stack
+  static VarroaJob job;
   ei_impulse_result_t result = { 0 };
+
+  // the boxes live in the SDK, so they are copied out before the varroa
+  // side can run its model
+  ei_impulse_lock();
+  const uint32_t t0 = metrics_now_us();
   EI_IMPULSE_ERROR err = run_classifier(&signal, &result, debug_nn);
+  metrics_record(Metric::BeeInfer, metrics_now_us() - t0);
+  if (err == EI_IMPULSE_OK) {
+    bee_log_detections(result);
+    job.bees = bee_count_detections(result);
+    job.centers = bee_collect_detections(result, job.dets);
+  }
+  ei_impulse_unlock();
 
-  web_pump();
-  if (should_abort()) return;
+  if (should_abort()) return {};
 
   if (err != EI_IMPULSE_OK) {
-    sdlog_printf("CYCLE fail run_classifier err=%d\n", err);
+    EVLOG(CYCLE_FAIL_CLASSIFY, err);
     g_frame_counter++;
-    return;
+    return {};
   }
 
-  bee_log_detections(result);
-  bee_save_overlay(result);
-
-  const uint32_t bees_this = bee_count_detections(result);
-
-  const bool got_centers = bee_write_centers_txt(result);
-  web_pump();
-  if (should_abort()) return;
-
-  if (got_centers) crops_save_from_last_frame();
-
-  uint32_t mites_this = 0;
-  web_pump();
-  if (should_abort()) return;
-
-  if (got_centers && g_crop_count > 0) mites_this = varroa_run_on_new_crops_and_count();
-  else sdlog_printf("VARROA skip got_centers=%d crops=%lu\n", (int)got_centers, (unsigned long)g_crop_count);
-
-  g_round_bees  += bees_this;
-  g_round_mites += mites_this;
-  g_total_bees  += bees_this;
-  g_total_mites += mites_this;
+  job.start_us = start_us;
+  if (job.dets.count > 0) (void)bee_write_centers_txt(job.dets);
+  if (live_stream_wanted(millis()))
+    live_stream_publish(snapshot_buf, EI_CLASSIFIER_INPUT_WIDTH, EI_CLASSIFIER_INPUT_HEIGHT, job.dets, g_frame_counter);
+  if (should_abort()) return { job.centers, false };
+
+  if (TRACK_BEES) {
+    // bees already seen are neither counted nor cropped again until due
+    static BeeDetections todo;
+    const TrackUpdate tu = tracker_update(job.dets, millis(), todo);
+    const uint32_t untracked = job.bees > job.centers ? job.bees - job.centers : 0;   // past MAX_CROPS
+    job.bees = tu.fresh + untracked;
+    EVLOG(TRACK_FRAME, (unsigned long)g_frame_counter, (unsigned long)job.centers,
+          (unsigned long)tu.fresh, (unsigned long)tu.classify, (unsigned long)tu.live);
+    crops_extract_from_frame(todo, job.batch);
+  } else {
+    crops_extract_from_frame(job.dets, job.batch);
+  }
+  camera_release_frame();
+  g_frame_counter++;
 
-  led_update_from_avg_weighted();
+  if (should_abort()) {
+    if (TRACK_BEES) tracker_unbind(job.batch.frame);
+    crop_batch_discard(job.batch);
+    return { job.centers, false };
+  }
 
-  sdlog_printf("CYCLE_SUMMARY bees=%lu mites=%lu | round bees=%lu/%lu mites=%lu | totals bees=%lu mites=%lu\n",
-               (unsigned long)bees_this,
-               (unsigned long)mites_this,
-               (unsigned long)g_round_bees,
-               (unsigned long)TARGET_BEES_PER_ROUND,
-               (unsigned long)g_round_mites,
-               (unsigned long)g_total_bees,
-               (unsigned long)g_total_mites);
+  if (g_varroa_jobs) {
+    // blocks only while the varroa task is still on frame N-1
+    inflight_add(1);
+    xQueueSend(g_varroa_jobs, &job, portMAX_DELAY);
+  } else {
+    finish_frame(job);
+  }
+  return { job.centers, false };
+}
 
-  maybe_finalize_round_and_log();
-  g_frame_counter++;
-}
\ No newline at end of file
+// Waits until the varroa task has finished every frame handed to it and
+// everything it queued for the card, log included, has been written.
+void pipeline_drain() {
+  while (g_inflight) vTaskDelay(1);
+  sd_writer_wait_idle();
+  evlog_sync();
+  sd_writer_wait_idle();
+}
@@ -35,9 +35,21 @@
 #define FULL_H 1024
 #define EI_CAMERA_FRAME_BYTE_SIZE 3
 
+// Decode path. When true, stage 1 decodes the JPEG at a reduced DCT scale
+// (1/2, 1/4 or 1/8, the coarsest that still covers the bee input) and the
+// crop stage decodes only the crop windows at full resolution, so the
+// 1280x1024 RGB frame is never materialised. When false every frame is
+// decoded in full into g_fullstage_buf.
+static constexpr bool CAPTURE_SCALED_DECODE = true;
+
 static constexpr int CROP_SIZE = 160;
 static constexpr int MAX_CROPS = 50;
 
+// Bee windows that overlap an already kept window by at least this IoU are
+// not cropped again: the kept crop stands for every bee merged into it and
+// its mites count once per bee. Above 1 turns de-duplication off.
+static constexpr float CROP_DEDUP_IOU = 0.50f;
+
 // ================================
 // Thresholds / Timing
 // ================================
@@ -47,6 +59,220 @@ static constexpr int   DROPPED_FRAMES = 10;
 
 static constexpr int JPEG_QUALITY = 100;
 
+// audit copies of every bee crop (written in the background when saving is on)
+static constexpr bool SAVE_CROPS_TO_SD = true;
+
+// ================================
+// Overlays
+// ================================
+// Each cycle stores the frame JPEG and a compact detection record next to
+// it (/frames/boot_N/NNNNNN.det). Bee and mite overlays are drawn from those
+// when the web UI first asks for one and cached under /bee_overlays and
+// /overlays.
+static constexpr uint32_t OVERLAY_MAX_BOXES_PER_CROP = 8;
+
+// Each listing also has an append-only manifest next to the records
+// (/frames/boot_N/*.idx). /api/images pages through it; the current boot
+// keeps its newest MANIFEST_TAIL entries per listing in RAM.
+static constexpr uint32_t MANIFEST_TAIL     = 128;
+static constexpr uint32_t MANIFEST_PAGE_MAX = 200;   // largest page /api/images returns
+
+// The gallery list shows thumbnails: the overlay decoded at the coarsest DCT
+// scale that still leaves THUMB_MIN_DIM on both sides, re-encoded and cached
+// in a thumbs/ folder next to it on first request.
+static constexpr uint16_t THUMB_MIN_DIM = 64;
+static constexpr int      THUMB_QUALITY = 70;
+
+// Overlays and thumbnails never change once written. Browsers may reuse them
+// this long without asking, then revalidate by ETag / Last-Modified.
+static constexpr uint32_t HTTP_CACHE_MAX_AGE_S = 3600;
+
+// Overlays and thumbnails are drawn on the web task, which gives way to the
+// pipeline: it only decodes when the decoder is free and the next cycle is
+// at least OVERLAY_RENDER_MIN_GAP_MS away, and otherwise answers 503 with
+// a Retry-After of OVERLAY_RETRY_AFTER_S.
+static constexpr uint32_t OVERLAY_RENDER_MIN_GAP_MS = 300;
+static constexpr uint32_t OVERLAY_RETRY_AFTER_S     = 1;
+
+// ================================
+// Scheduler
+// ================================
+// INFER_PERIOD_MS is the base tick. With SCHED_ADAPTIVE the loop runs
+// cycles back to back (SCHED_MIN_PERIOD_MS) while a frame holds at least
+// SCHED_BUSY_BEES bees, and backs off exponentially up to
+// SCHED_MAX_PERIOD_MS while the entrance is empty. Frames the motion gate
+// drops do not back it off. SCHED_MAX_DUTY caps the share of time the loop
+// spends inside cycles. /api/state can switch it
+// at runtime (sched=0/1).
+static constexpr bool     SCHED_ADAPTIVE      = true;
+static constexpr uint32_t SCHED_MIN_PERIOD_MS = 0;
+static constexpr uint32_t SCHED_MAX_PERIOD_MS = 60000;
+static constexpr uint32_t SCHED_BUSY_BEES     = 5;
+static constexpr float    SCHED_MAX_DUTY      = 0.85f;
+
+// ================================
+// Motion gate
+// ================================
+// Before stage 1 the JPEG is decoded at 1/8 scale into a MOTION_THUMB_W x
+// MOTION_THUMB_H luma thumbnail and compared with a running background.
+// A cycle only goes on when at least MOTION_MIN_CHANGED of the thumbnail
+// differs by more than MOTION_PIXEL_DELTA (after taking out the overall
+// brightness shift), or nothing has run for MOTION_MAX_SKIP_MS. Skipped
+// frames are not saved, decoded or numbered.
+static constexpr bool     MOTION_GATE        = true;
+static constexpr uint32_t MOTION_THUMB_W     = 40;
+static constexpr uint32_t MOTION_THUMB_H     = 32;
+static constexpr uint8_t  MOTION_PIXEL_DELTA = 18;
+static constexpr float    MOTION_MIN_CHANGED = 0.02f;
+static constexpr uint32_t MOTION_BG_SHIFT    = 3;       // background moves 1/8 of the way per frame
+static constexpr uint32_t MOTION_MAX_SKIP_MS = 60000;
+
+// ================================
+// Bee tracking
+// ================================
+// Stage 1 centres are matched to earlier frames' bees by nearest centroid,
+// within TRACK_GATE_PX of bee-model input. A bee is counted once per track;
+// stage 2 runs on it when the track starts and again at most every
+// TRACK_RECHECK_MS (0: never). Tracks missing from TRACK_EXPIRE_FRAMES
+// processed frames in a row end; frames rather than time, so a track lasts
+// as long at a 5 s period as at 200 ms. With TRACK_BEES false every frame is
+// counted and classified on its own.
+static constexpr bool     TRACK_BEES          = true;
+static constexpr float    TRACK_GATE_PX       = 12.0f;
+static constexpr uint32_t TRACK_EXPIRE_FRAMES = 3;
+static constexpr uint32_t TRACK_RECHECK_MS    = 30000;
+static constexpr uint32_t TRACK_MAX           = 64;
+
+// ================================
+// SD write-behind queue
+// ================================
+// What sd_writer does when a new job does not fit the queue:
+//   Block           wait for the writer task to make room
+//   DropOldest      evict the oldest queued artifacts (never log lines)
+//   DropLowPriority drop crop audit copies first, then block
+enum class SdBackpressure : uint8_t { Block, DropOldest, DropLowPriority };
+
+static constexpr SdBackpressure SD_WRITER_POLICY    = SdBackpressure::DropLowPriority;
+static constexpr uint32_t       SD_WRITER_MAX_JOBS  = 96;
+static constexpr uint32_t       SD_WRITER_MAX_BYTES = 2u * 1024u * 1024u;  // PSRAM held by queued payloads
+static constexpr int            SD_WRITER_TASK_CORE = 0;
+
+// ================================
+// Pack
+// ================================
+// Crop audit copies and the running boot's overlay and thumbnail caches go
+// into one file per boot, /packs/boot_N.pak, instead of a file each. The
+// file is extended PACK_GROW_BYTES at a time; every PACK_SEAL_EVERY blobs
+// an index segment is written after them, which is all a reboot leaves to
+// rescan. Once a pack holds PACK_MAX_ENTRIES or PACK_MAX_BYTES, the rest
+// are plain files. The byte cap bounds the one remove that reclaims an old
+// pack: it frees PACK_MAX_BYTES / cluster size FAT entries (8192 at 32 KiB
+// clusters) in a single storage slice.
+static constexpr uint32_t PACK_MAX_ENTRIES = 4096;               // 64 bytes each in PSRAM
+static constexpr uint32_t PACK_MAX_BYTES   = 256u * 1024u * 1024u;
+static constexpr uint32_t PACK_GROW_BYTES  = 1024u * 1024u;
+static constexpr uint32_t PACK_SEAL_EVERY  = 64;
+
+// ================================
+// Storage
+// ================================
+// In the gaps between cycles the storage manager tallies what each boot
+// holds per category and, when a category is over its quota, deletes that
+// category's files from the oldest boots until it is back under
+// STORAGE_LOW_WATER of it. Below STORAGE_MIN_FREE_BYTES free on the card
+// the oldest boots go whole. The running boot is never touched. A quota
+// of 0 leaves that category alone.
+static constexpr uint64_t STORAGE_QUOTA_FRAMES       = 8ull << 30;
+static constexpr uint64_t STORAGE_QUOTA_CROPS        = 512ull << 20;
+static constexpr uint64_t STORAGE_QUOTA_BEE_OVERLAYS = 2ull << 30;
+static constexpr uint64_t STORAGE_QUOTA_OVERLAYS     = 2ull << 30;
+static constexpr uint64_t STORAGE_QUOTA_PACKS        = 2ull << 30;
+static constexpr uint64_t STORAGE_QUOTA_LOGS         = 256ull << 20;
+static constexpr float    STORAGE_LOW_WATER          = 0.9f;
+static constexpr uint64_t STORAGE_MIN_FREE_BYTES     = 1ull << 30;
+// Work is done in slices of at most STORAGE_SLICE_MS, no closer together
+// than STORAGE_SLICE_EVERY_MS, and only while the SD writer queue is empty
+// and the next cycle is at least STORAGE_MIN_GAP_MS away.
+static constexpr uint32_t STORAGE_SLICE_MS        = 20;
+static constexpr uint32_t STORAGE_SLICE_EVERY_MS  = 100;
+static constexpr uint32_t STORAGE_MIN_GAP_MS      = 50;
+static constexpr uint32_t STORAGE_CENSUS_EVERY_MS = 30u * 60u * 1000u;  // full recount; writes are tallied in between
+static constexpr uint32_t STORAGE_FREE_POLL_MS    = 60000;              // the first poll, which can take seconds, is in setup
+static constexpr uint32_t STORAGE_MAX_BOOTS       = 512;                // 56 bytes each in PSRAM, twice
+
+// ================================
+// Event log
+// ================================
+// Log calls append an event id plus raw arguments to a PSRAM ring; a
+// background task formats the Serial echo and writes the binary records to
+// /logs/boot_NNNNNN.blg in large blocks. tools/decode_log.py turns a .blg
+// back into the text log.
+//
+// Levels are compile-time: events above their category's level are not
+// compiled in. Debug covers the per-detection / per-save lines, so the
+// categories that have them stay at Info unless you are chasing something.
+enum class LogLevel : uint8_t { Off, Error, Warn, Info, Debug };
+
+static constexpr LogLevel LOG_LEVEL_CORE   = LogLevel::Debug;
+static constexpr LogLevel LOG_LEVEL_CAM    = LogLevel::Debug;
+static constexpr LogLevel LOG_LEVEL_BEE    = LogLevel::Info;
+static constexpr LogLevel LOG_LEVEL_CROP   = LogLevel::Info;
+static constexpr LogLevel LOG_LEVEL_VARROA = LogLevel::Info;
+static constexpr LogLevel LOG_LEVEL_SD     = LogLevel::Info;
+static constexpr LogLevel LOG_LEVEL_PIPE   = LogLevel::Debug;
+
+static constexpr uint32_t LOG_RING_BYTES   = 64u * 1024u;
+static constexpr uint32_t LOG_FLUSH_BLOCK  = 4096;
+static constexpr uint32_t LOG_FLUSH_MS     = 250;
+
+// ================================
+// Pipelining
+// ================================
+// Run stage 2 (varroa) on its own task pinned to the other core, so frame N+1
+// is captured, decoded and cropped while frame N's crops are classified. The
+// two models share the library's state and take turns (ei_impulse_lock()).
+static constexpr bool     PIPELINE_DUAL_CORE = true;
+static constexpr int      VARROA_TASK_CORE   = 0;   // Arduino loop() runs on core 1
+static constexpr uint32_t VARROA_TASK_STACK  = 16384;
+
+// The HTTP server runs on its own task, off the inference core, so a slow
+// download and a long inference never wait on each other.
+static constexpr int      WEB_TASK_CORE      = 0;
+static constexpr uint32_t WEB_TASK_STACK     = 12288;
+
+// /sd streams each download through a buffer of its own, a whole number of
+// SD sectors, and gives up on a client that takes nothing for this long.
+static constexpr size_t   SD_SECTOR_BYTES       = 512;
+static constexpr size_t   HTTP_STREAM_CHUNK     = 32u * SD_SECTOR_BYTES;
+static constexpr uint32_t HTTP_WRITE_TIMEOUT_MS = 5000;
+
+// /stream: live MJPEG of the stage 1 input with the bee centres marked. The
+// inference task only draws and encodes a frame while someone is watching,
+// at most LIVE_STREAM_MAX_FPS; each client gets a task of its own.
+static constexpr uint32_t LIVE_STREAM_MAX_FPS     = 5;
+static constexpr int      LIVE_STREAM_QUALITY     = 60;
+static constexpr size_t   LIVE_STREAM_MAX_BYTES   = 64u * 1024u;   // per slot, two slots
+static constexpr uint32_t LIVE_STREAM_MAX_CLIENTS = 2;
+static constexpr uint32_t LIVE_STREAM_TASK_STACK  = 4096;
+
+// /api/events: Server-Sent Events pushed to the page (cycle counts, new
+// manifest entries, state changes) instead of it polling. The newest
+// SSE_RING_EVENTS are kept for clients that reconnect.
+static constexpr uint32_t SSE_MAX_CLIENTS  = 3;
+static constexpr uint32_t SSE_RING_EVENTS  = 32;
+static constexpr size_t   SSE_EVENT_MAX    = 768;     // one event with its framing
+static constexpr uint32_t SSE_POLL_MS      = 50;      // how often a client task looks for news
+static constexpr uint32_t SSE_KEEPALIVE_MS = 15000;
+static constexpr uint32_t SSE_TASK_STACK   = 6144;
+
+// /api/export: a boot session as a tar, streamed through one
+// HTTP_STREAM_CHUNK buffer by a task of its own. Directories deeper than
+// EXPORT_MAX_DEPTH under a session directory are left out
+// (overlays/boot_N/mite is one level).
+static constexpr int      EXPORT_MAX_DEPTH   = 2;
+static constexpr uint32_t EXPORT_MAX_CLIENTS = 1;
+static constexpr uint32_t EXPORT_TASK_STACK  = 6144;
+
 // ================================
 // Counting
 // ================================
@@ -1,7 +1,11 @@
 #include "camera_ei.h"
 #include "../sd/sd_core.h"
+#include "../log/evlog.h"
+#include "../metrics/metrics.h"
 #include "edge-impulse-sdk/dsp/image/image.hpp"
 #include "img_converters.h"
+#include "jpeg_decode.h"
+#include "motion_gate.h"
 
 // camera config
 static camera_config_t camera_config = {
@@ -51,21 +55,82 @@ bool camera_init_ei() {
   return true;
 }
 
-bool camera_capture_ei(uint32_t img_width, uint32_t img_height, uint8_t *out_buf) {
-  if (!is_initialised) { sdlog_printf("ERR camera not initialized\n"); return false; }
+static camera_fb_t* g_held_fb = nullptr;
 
+void camera_release_frame() {
+  if (!g_held_fb) return;
+  esp_camera_fb_return(g_held_fb);
+  g_held_fb = nullptr;
+}
+
+bool camera_decode_windows(const JpegWindow* win, uint32_t n) {
+  if (!g_held_fb) return false;
+  MetricScope m(Metric::CropDecode);
+  return jpeg_decode_windows(g_held_fb->buf, g_held_fb->len, win, n);
+}
+
+// Stage 1 input at a reduced DCT scale; the frame stays held for the crops.
+static bool decode_scaled_for_stage1(camera_fb_t* fb, uint32_t img_width, uint32_t img_height, uint8_t* out_buf) {
+  const jpg_scale_t s = jpeg_pick_scale(fb->width, fb->height, (uint16_t)img_width, (uint16_t)img_height);
+
+  uint16_t sw = 0, sh = 0;
+  uint32_t t0 = metrics_now_us();
+  if (!jpeg_decode_scaled(fb->buf, fb->len, s, g_stage1_buf, g_stage1_bytes, &sw, &sh)) return false;
+  metrics_record(Metric::Decode, metrics_now_us() - t0);
+
+  t0 = metrics_now_us();
+  if ((img_width != sw) || (img_height != sh)) {
+    ei::image::processing::crop_and_interpolate_rgb888(
+      g_stage1_buf, sw, sh,
+      out_buf, img_width, img_height);
+  } else {
+    memcpy(out_buf, g_stage1_buf, (size_t)img_width*img_height*3);
+  }
+  metrics_record(Metric::Resize, metrics_now_us() - t0);
+  return true;
+}
+
+CaptureResult camera_capture_ei(uint32_t img_width, uint32_t img_height, uint8_t *out_buf) {
+  if (!is_initialised) { EVLOG(CAM_NOT_INIT); return CaptureResult::Failed; }
+  MetricScope m(Metric::Capture);
+
+  camera_release_frame();
+
+  uint32_t t0 = metrics_now_us();
   camera_fb_t *fb = esp_camera_fb_get();
-  if (!fb) { sdlog_printf("ERR camera capture failed\n"); return false; }
+  metrics_record(Metric::CameraGrab, metrics_now_us() - t0);
+  if (!fb) { EVLOG(CAM_CAPTURE_FAIL); return CaptureResult::Failed; }
+
+  if (MOTION_GATE && !motion_gate_check(fb->buf, fb->len)) {
+    esp_camera_fb_return(fb);
+    return CaptureResult::Unchanged;
+  }
 
   g_full_w = fb->width;
   g_full_h = fb->height;
 
   (void)sd_save_fb_jpeg(fb);
 
+  if (CAPTURE_SCALED_DECODE) {
+    if (!decode_scaled_for_stage1(fb, img_width, img_height, out_buf)) {
+      esp_camera_fb_return(fb);
+      EVLOG(CAM_DECODE_FAIL);
+      return CaptureResult::Failed;
+    }
+    g_held_fb = fb;
+    return CaptureResult::Ok;
+  }
+
+  t0 = metrics_now_us();
+  jpeg_decoder_lock();
   bool converted = fmt2rgb888(fb->buf, fb->len, PIXFORMAT_JPEG, g_fullstage_buf);
+  jpeg_decoder_unlock();
   esp_camera_fb_return(fb);
 
-  if (!converted) { sdlog_printf("ERR full decode failed\n"); return false; }
+  if (!converted) { EVLOG(CAM_DECODE_FAIL); return CaptureResult::Failed; }
+  metrics_record(Metric::Decode, metrics_now_us() - t0);
+
+  t0 = metrics_now_us();
 
   if ((img_width != g_full_w) || (img_height != g_full_h)) {
     ei::image::processing::crop_and_interpolate_rgb888(
@@ -74,6 +139,7 @@ bool camera_capture_ei(uint32_t img_width, uint32_t img_height, uint8_t *out_buf
   } else {
     memcpy(out_buf, g_fullstage_buf, (size_t)img_width*img_height*3);
   }
+  metrics_record(Metric::Resize, metrics_now_us() - t0);
 
-  return true;
+  return CaptureResult::Ok;
 }
@@ -2,4 +2,14 @@
 #include "../globals.h"
 
 bool camera_init_ei();
-bool camera_capture_ei(uint32_t img_width, uint32_t img_height, uint8_t* out_buf);
+
+// Unchanged: the motion gate found nothing new; the frame was dropped and
+// out_buf is untouched.
+enum class CaptureResult : uint8_t { Ok, Failed, Unchanged };
+CaptureResult camera_capture_ei(uint32_t img_width, uint32_t img_height, uint8_t* out_buf);
+
+// With CAPTURE_SCALED_DECODE the captured JPEG is held after
+// camera_capture_ei() so the crop stage can decode its windows from it.
+struct JpegWindow;
+bool camera_decode_windows(const JpegWindow* win, uint32_t n);
+void camera_release_frame();
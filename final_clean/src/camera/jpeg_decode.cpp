@@ -0,0 +1,186 @@
+#include "jpeg_decode.h"
+#include "../metrics/metrics.h"
+
+static SemaphoreHandle_t g_decoder_mu = nullptr;
+static portMUX_TYPE g_decoder_mu_init = portMUX_INITIALIZER_UNLOCKED;
+
+static void decoder_mutex_init() {
+  if (g_decoder_mu) return;
+  SemaphoreHandle_t m = xSemaphoreCreateMutex();
+  portENTER_CRITICAL(&g_decoder_mu_init);
+  if (!g_decoder_mu) { g_decoder_mu = m; m = nullptr; }
+  portEXIT_CRITICAL(&g_decoder_mu_init);
+  if (m) vSemaphoreDelete(m);
+}
+
+void jpeg_decoder_lock() {
+  decoder_mutex_init();
+  if (xSemaphoreTake(g_decoder_mu, 0) == pdTRUE) return;
+  // web renders only ever try the lock, so whoever waits here is the pipeline
+  const uint32_t t0 = metrics_now_us();
+  xSemaphoreTake(g_decoder_mu, portMAX_DELAY);
+  metrics_record(Metric::DecodeWait, metrics_now_us() - t0);
+}
+
+bool jpeg_decoder_try_lock() {
+  decoder_mutex_init();
+  return xSemaphoreTake(g_decoder_mu, 0) == pdTRUE;
+}
+
+void jpeg_decoder_unlock() {
+  xSemaphoreGive(g_decoder_mu);
+}
+
+struct SrcCtx {
+  const uint8_t* jpg;
+  size_t len;
+};
+
+static unsigned int read_cb(void* arg, size_t index, uint8_t* buf, size_t len) {
+  SrcCtx* s = (SrcCtx*)arg;
+  if (index >= s->len) return 0;
+  if (len > s->len - index) len = s->len - index;
+  if (buf) memcpy(buf, s->jpg + index, len);
+  return (unsigned int)len;
+}
+
+// TJpgDec hands out R,G,B; store B,G,R.
+static inline void copy_px_bgr(uint8_t* dst, const uint8_t* src, size_t px) {
+  for (size_t i = 0; i < px; ++i, dst += 3, src += 3) {
+    dst[0] = src[2];
+    dst[1] = src[1];
+    dst[2] = src[0];
+  }
+}
+
+bool jpeg_read_size(const uint8_t* jpg, size_t len, uint16_t* w, uint16_t* h) {
+  if (!jpg || len < 4 || jpg[0] != 0xFF || jpg[1] != 0xD8) return false;
+
+  size_t i = 2;
+  while (i + 4 <= len) {
+    if (jpg[i] != 0xFF) return false;
+    const uint8_t m = jpg[i + 1];
+    if (m == 0xFF) { ++i; continue; }                    // fill byte
+    if (m == 0xD9 || m == 0xDA) return false;            // EOI / SOS before any SOF
+    const size_t seg = ((size_t)jpg[i + 2] << 8) | jpg[i + 3];
+    // SOF0..SOF15, minus DHT (C4), JPG (C8) and DAC (CC)
+    if (m >= 0xC0 && m <= 0xCF && m != 0xC4 && m != 0xC8 && m != 0xCC) {
+      if (seg < 7 || i + 9 > len) return false;
+      if (h) *h = (uint16_t)(((uint16_t)jpg[i + 5] << 8) | jpg[i + 6]);
+      if (w) *w = (uint16_t)(((uint16_t)jpg[i + 7] << 8) | jpg[i + 8]);
+      return true;
+    }
+    i += 2 + seg;
+  }
+  return false;
+}
+
+jpg_scale_t jpeg_pick_scale(uint16_t src_w, uint16_t src_h, uint16_t dst_w, uint16_t dst_h) {
+  for (int s = (int)JPG_SCALE_8X; s > (int)JPG_SCALE_NONE; --s) {
+    if (jpeg_scaled_dim(src_w, (jpg_scale_t)s) >= dst_w && jpeg_scaled_dim(src_h, (jpg_scale_t)s) >= dst_h)
+      return (jpg_scale_t)s;
+  }
+  return JPG_SCALE_NONE;
+}
+
+// ---- scaled whole-image decode ----
+
+struct ScaledCtx {
+  SrcCtx src;
+  uint8_t* out;
+  size_t cap;
+  uint16_t w;
+  uint16_t h;
+  bool fits;
+};
+
+static bool scaled_write_cb(void* arg, uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint8_t* data) {
+  ScaledCtx* c = (ScaledCtx*)arg;
+  if (!data) {
+    if (x == 0 && y == 0) {
+      // start: refuse images that do not fit the caller's buffer
+      c->w = w;
+      c->h = h;
+      c->fits = (size_t)w * h * 3 <= c->cap;
+      return c->fits;
+    }
+    return true;
+  }
+
+  // esp_jpg_decode ignores what the start call returns, so every block is
+  // checked against the output before it is stored
+  if (!c->fits || (uint32_t)x + w > c->w || (uint32_t)y + h > c->h) {
+    c->fits = false;
+    return false;
+  }
+
+  for (uint16_t r = 0; r < h; ++r) {
+    copy_px_bgr(c->out + ((size_t)(y + r) * c->w + x) * 3, data + (size_t)r * w * 3, w);
+  }
+  return true;
+}
+
+bool jpeg_decode_scaled(const uint8_t* jpg, size_t len, jpg_scale_t scale,
+                        uint8_t* out, size_t cap, uint16_t* out_w, uint16_t* out_h, JpegLock lock) {
+  if (!jpg || !len || !out) return false;
+
+  ScaledCtx c = { { jpg, len }, out, cap, 0, 0, false };
+  if (lock == JpegLock::Wait) jpeg_decoder_lock();
+  const esp_err_t err = esp_jpg_decode(len, scale, read_cb, scaled_write_cb, &c);
+  if (lock == JpegLock::Wait) jpeg_decoder_unlock();
+  if (err != ESP_OK || !c.fits) return false;
+
+  if (out_w) *out_w = c.w;
+  if (out_h) *out_h = c.h;
+  return true;
+}
+
+// ---- windowed full-resolution decode ----
+
+struct WindowCtx {
+  SrcCtx src;
+  const JpegWindow* win;
+  uint32_t n;
+  uint16_t bottom;   // first row below every window
+  bool finished;
+};
+
+static bool window_write_cb(void* arg, uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint8_t* data) {
+  WindowCtx* c = (WindowCtx*)arg;
+  if (!data) return true;
+
+  // MCUs arrive top to bottom; nothing below the last window matters
+  if (y >= c->bottom) { c->finished = true; return false; }
+
+  for (uint32_t i = 0; i < c->n; ++i) {
+    const JpegWindow& wn = c->win[i];
+    const int x0 = (x > wn.x) ? x : wn.x;
+    const int y0 = (y > wn.y) ? y : wn.y;
+    const int x1 = ((x + w) < (wn.x + wn.w)) ? (x + w) : (wn.x + wn.w);
+    const int y1 = ((y + h) < (wn.y + wn.h)) ? (y + h) : (wn.y + wn.h);
+    if (x0 >= x1 || y0 >= y1) continue;
+
+    for (int yy = y0; yy < y1; ++yy) {
+      copy_px_bgr(wn.dst + ((size_t)(yy - wn.y) * wn.w + (x0 - wn.x)) * 3,
+                  data + ((size_t)(yy - y) * w + (x0 - x)) * 3,
+                  (size_t)(x1 - x0));
+    }
+  }
+  return true;
+}
+
+bool jpeg_decode_windows(const uint8_t* jpg, size_t len, const JpegWindow* win, uint32_t n, JpegLock lock) {
+  if (!jpg || !len || !win || !n) return false;
+
+  WindowCtx c = { { jpg, len }, win, n, 0, false };
+  for (uint32_t i = 0; i < n; ++i) {
+    const uint16_t b = (uint16_t)(win[i].y + win[i].h);
+    if (b > c.bottom) c.bottom = b;
+  }
+
+  // stopping early is reported as a failure by the decoder
+  if (lock == JpegLock::Wait) jpeg_decoder_lock();
+  const esp_err_t err = esp_jpg_decode(len, JPG_SCALE_NONE, read_cb, window_write_cb, &c);
+  if (lock == JpegLock::Wait) jpeg_decoder_unlock();
+  return err == ESP_OK || c.finished;
+}
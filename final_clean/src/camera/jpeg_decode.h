@@ -0,0 +1,45 @@
+#pragma once
+#include "../globals.h"
+#include "esp_jpg_decode.h"   // esp_jpg_decode, jpg_scale_t
+
+// Partial JPEG decodes on top of esp_jpg_decode (TJpgDec). Output is B,G,R
+// like fmt2rgb888, so the rest of the pipeline sees the same byte order.
+
+// Full-resolution rectangle copied into dst (w*h*3 bytes, tightly packed).
+struct JpegWindow {
+  uint16_t x;
+  uint16_t y;
+  uint16_t w;
+  uint16_t h;
+  uint8_t* dst;
+};
+
+// Frame size from the SOF marker, without decoding.
+bool jpeg_read_size(const uint8_t* jpg, size_t len, uint16_t* w, uint16_t* h);
+
+// Coarsest DCT scale whose output still covers dst_w x dst_h.
+jpg_scale_t jpeg_pick_scale(uint16_t src_w, uint16_t src_h, uint16_t dst_w, uint16_t dst_h);
+inline uint16_t jpeg_scaled_dim(uint16_t v, jpg_scale_t s) { return (uint16_t)(v >> (int)s); }
+
+// Wait: the decode takes the decoder lock itself. Held: the caller has it.
+enum class JpegLock : uint8_t { Wait, Held };
+
+// Decodes the whole image at 1/2^scale into out (cap bytes).
+bool jpeg_decode_scaled(const uint8_t* jpg, size_t len, jpg_scale_t scale,
+                        uint8_t* out, size_t cap, uint16_t* out_w, uint16_t* out_h,
+                        JpegLock lock = JpegLock::Wait);
+
+// Decodes at full resolution but only stores pixels inside the windows, and
+// stops after the last MCU row any window touches.
+bool jpeg_decode_windows(const uint8_t* jpg, size_t len, const JpegWindow* win, uint32_t n,
+                         JpegLock lock = JpegLock::Wait);
+
+// esp_jpg_decode (and fmt2rgb888, which sits on it) works out of one static
+// buffer, so decodes from different tasks must not overlap. The functions
+// above take this lock themselves unless told otherwise; hold it around
+// direct fmt2rgb888 calls. Time spent waiting for it goes to
+// Metric::DecodeWait.
+void jpeg_decoder_lock();
+// Never waits: false when someone else is decoding.
+bool jpeg_decoder_try_lock();
+void jpeg_decoder_unlock();
@@ -0,0 +1,107 @@
+#include "motion_gate.h"
+#include "jpeg_decode.h"
+#include "../log/evlog.h"
+#include "../metrics/metrics.h"
+
+static constexpr uint32_t THUMB_PX = MOTION_THUMB_W * MOTION_THUMB_H;
+
+static uint8_t* g_small = nullptr;   // 1/8-scale decode, B,G,R
+static size_t g_small_bytes = 0;
+static uint8_t g_luma[THUMB_PX];
+static uint16_t g_bg[THUMB_PX];      // background luma, 8.8 fixed point
+static bool g_bg_valid = false;
+static uint32_t g_last_run_ms = 0;
+static MotionStats g_stats = {};
+static portMUX_TYPE g_stats_mux = portMUX_INITIALIZER_UNLOCKED;   // read by the web task
+
+bool motion_gate_begin() {
+  if (g_small) return true;
+  g_small_bytes = (size_t)jpeg_scaled_dim(FULL_W, JPG_SCALE_8X) * jpeg_scaled_dim(FULL_H, JPG_SCALE_8X) * 3;
+  g_small = (uint8_t*)ps_malloc(g_small_bytes);
+  if (!g_small) g_small = (uint8_t*)malloc(g_small_bytes);
+  return g_small != nullptr;
+}
+
+// Box-averages the scaled decode into g_luma (BT.601 weights, /256).
+static void build_thumb(const uint8_t* bgr, uint16_t sw, uint16_t sh) {
+  const uint32_t bw = sw / MOTION_THUMB_W ? sw / MOTION_THUMB_W : 1;
+  const uint32_t bh = sh / MOTION_THUMB_H ? sh / MOTION_THUMB_H : 1;
+  const uint32_t n = bw * bh;
+
+  for (uint32_t ty = 0; ty < MOTION_THUMB_H; ++ty) {
+    for (uint32_t tx = 0; tx < MOTION_THUMB_W; ++tx) {
+      uint32_t sum = 0;
+      const uint32_t y0 = ty * bh < sh ? ty * bh : sh - 1;
+      const uint32_t x0 = tx * bw < sw ? tx * bw : sw - 1;
+      for (uint32_t y = y0; y < y0 + bh && y < sh; ++y) {
+        const uint8_t* p = bgr + ((size_t)y * sw + x0) * 3;
+        for (uint32_t x = 0; x < bw && x0 + x < sw; ++x, p += 3) {
+          sum += (uint32_t)p[2] * 77u + (uint32_t)p[1] * 150u + (uint32_t)p[0] * 29u;
+        }
+      }
+      g_luma[ty * MOTION_THUMB_W + tx] = (uint8_t)(sum / (n * 256u));
+    }
+  }
+}
+
+// Fraction of thumbnail pixels off the background by more than
+// MOTION_PIXEL_DELTA once the mean brightness shift (auto exposure, clouds)
+// is taken out; then moves the background towards this frame.
+static float compare_and_learn() {
+  int32_t shift = 0;
+  for (uint32_t i = 0; i < THUMB_PX; ++i) shift += (int32_t)g_luma[i] - (int32_t)(g_bg[i] >> 8);
+  shift /= (int32_t)THUMB_PX;
+
+  uint32_t changed = 0;
+  for (uint32_t i = 0; i < THUMB_PX; ++i) {
+    const int32_t d = (int32_t)g_luma[i] - (int32_t)(g_bg[i] >> 8) - shift;
+    if (d > MOTION_PIXEL_DELTA || d < -(int32_t)MOTION_PIXEL_DELTA) changed++;
+
+    const int32_t target = (int32_t)g_luma[i] << 8;
+    g_bg[i] = (uint16_t)((int32_t)g_bg[i] + ((target - (int32_t)g_bg[i]) >> MOTION_BG_SHIFT));
+  }
+  return (float)changed / (float)THUMB_PX;
+}
+
+bool motion_gate_check(const uint8_t* jpg, size_t len) {
+  if (!g_small) return true;
+  MetricScope m(Metric::MotionGate);
+
+  uint16_t sw = 0, sh = 0;
+  if (!jpeg_decode_scaled(jpg, len, JPG_SCALE_8X, g_small, g_small_bytes, &sw, &sh)) return true;
+  build_thumb(g_small, sw, sh);
+
+  const uint32_t now = millis();
+  float changed = 1.0f;
+  if (g_bg_valid) {
+    changed = compare_and_learn();
+  } else {
+    for (uint32_t i = 0; i < THUMB_PX; ++i) g_bg[i] = (uint16_t)(g_luma[i] << 8);
+    g_bg_valid = true;
+  }
+  const bool overdue = now - g_last_run_ms >= MOTION_MAX_SKIP_MS;
+  const bool run = changed >= MOTION_MIN_CHANGED || overdue;
+
+  portENTER_CRITICAL(&g_stats_mux);
+  g_stats.last_changed = changed;
+  if (run) g_stats.runs++;
+  else g_stats.skips++;
+  const MotionStats s = g_stats;
+  portEXIT_CRITICAL(&g_stats_mux);
+
+  if (!run) {
+    EVLOG(MOTION_SKIP, (double)changed, (unsigned long)s.skips);
+    return false;
+  }
+
+  g_last_run_ms = now;
+  EVLOG(MOTION_RUN, (double)changed, (unsigned long)s.runs, (unsigned long)s.skips);
+  return true;
+}
+
+MotionStats motion_gate_stats() {
+  portENTER_CRITICAL(&g_stats_mux);
+  const MotionStats s = g_stats;
+  portEXIT_CRITICAL(&g_stats_mux);
+  return s;
+}
@@ -0,0 +1,21 @@
+#pragma once
+#include "../globals.h"
+
+// Cheap pre-stage: the captured JPEG is decoded at 1/8 scale, boiled down
+// to a MOTION_THUMB_W x MOTION_THUMB_H luma thumbnail and compared with a
+// running background. Frames where too little of the thumbnail changed are
+// dropped before anything is saved, decoded or classified.
+
+struct MotionStats {
+  uint32_t runs;
+  uint32_t skips;
+  float last_changed;   // changed-pixel fraction of the last frame
+};
+
+bool motion_gate_begin();
+
+// True when the frame should go through the pipeline. Also true whenever
+// the gate cannot decide (no buffer, decode error), so it fails open.
+bool motion_gate_check(const uint8_t* jpg, size_t len);
+
+MotionStats motion_gate_stats();
@@ -0,0 +1,96 @@
+#include "crop_queue.h"
+
+static constexpr size_t TILE_BYTES = (size_t)CROP_SIZE * CROP_SIZE * 3;
+static constexpr uint32_t MAX_TILES = MAX_CROPS * 2;
+
+static CropTile g_tiles[MAX_TILES];
+static uint8_t* g_tile_pixels = nullptr;
+static uint32_t g_capacity = 0;
+
+// ring state, shared by the capture (push) and varroa (release) sides
+static portMUX_TYPE g_ring_mux = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t g_head = 0;
+static uint32_t g_used = 0;
+
+// Tries want_tiles first and backs off if PSRAM is short, so a large
+// queue never prevents boot.
+bool crop_queue_init(uint32_t want_tiles) {
+  if (g_tile_pixels) return true;
+  if (want_tiles > MAX_TILES) want_tiles = MAX_TILES;
+
+  for (uint32_t cap = want_tiles; cap >= 1; cap /= 2) {
+    g_tile_pixels = (uint8_t*)ps_malloc(TILE_BYTES * cap);
+    if (g_tile_pixels) { g_capacity = cap; break; }
+  }
+  if (!g_tile_pixels) return false;
+
+  for (uint32_t i = 0; i < g_capacity; ++i) g_tiles[i].rgb = g_tile_pixels + TILE_BYTES * i;
+  g_head = 0;
+  g_used = 0;
+  return true;
+}
+
+uint32_t crop_queue_capacity() { return g_capacity; }
+
+uint32_t crop_queue_free() {
+  portENTER_CRITICAL(&g_ring_mux);
+  const uint32_t f = g_capacity - g_used;
+  portEXIT_CRITICAL(&g_ring_mux);
+  return f;
+}
+
+void crop_batch_begin(CropBatch& b, uint32_t frame) {
+  portENTER_CRITICAL(&g_ring_mux);
+  b.first = g_head;
+  portEXIT_CRITICAL(&g_ring_mux);
+  b.frame = frame;
+  b.count = 0;
+}
+
+CropTile* crop_batch_push(CropBatch& b) {
+  CropTile* t = nullptr;
+  portENTER_CRITICAL(&g_ring_mux);
+  if (g_capacity && g_used < g_capacity) {
+    t = &g_tiles[g_head];
+    g_head = (g_head + 1) % g_capacity;
+    g_used++;
+  }
+  portEXIT_CRITICAL(&g_ring_mux);
+
+  if (!t) return nullptr;
+  t->frame = b.frame;
+  t->slot = b.count++;
+  return t;
+}
+
+CropTile* crop_batch_at(const CropBatch& b, uint32_t i) {
+  if (i >= b.count) return nullptr;
+  return &g_tiles[(b.first + i) % g_capacity];
+}
+
+void crop_batch_discard(CropBatch& b) {
+  portENTER_CRITICAL(&g_ring_mux);
+  // only the newest batch can be taken back: its tiles end at g_head
+  if (g_capacity && b.count && b.count <= g_used && (b.first + b.count) % g_capacity == g_head) {
+    g_head = b.first;
+    g_used -= b.count;
+  }
+  portEXIT_CRITICAL(&g_ring_mux);
+  b.count = 0;
+}
+
+void crop_batch_release(CropBatch& b) {
+  portENTER_CRITICAL(&g_ring_mux);
+  g_used = (b.count <= g_used) ? (g_used - b.count) : 0;
+  portEXIT_CRITICAL(&g_ring_mux);
+  b.count = 0;
+}
+
+void crop_tile_basename(const CropTile& t, char* out, size_t out_sz) {
+  if (!out || out_sz == 0) return;
+  snprintf(out, out_sz, "%06lu_%02lu_%s_%u",
+           (unsigned long)t.frame,
+           (unsigned long)t.slot,
+           t.label,
+           (unsigned)lrintf(t.score * 100.0f));
+}
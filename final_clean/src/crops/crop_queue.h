@@ -0,0 +1,40 @@
+#pragma once
+#include "../globals.h"
+
+// One bee crop kept in PSRAM as raw pixels (decoder byte order, like
+// g_fullstage_buf).
+struct CropTile {
+  uint32_t frame;
+  uint32_t slot;        // index within the frame
+  uint32_t bbox_index;  // bee bounding box this crop came from
+  uint32_t bees;        // bee centres this window stands for (>1 when merged)
+  int x0;               // top-left corner in the full-resolution frame
+  int y0;
+  float score;
+  char label[12];
+  uint8_t* rgb;         // CROP_SIZE x CROP_SIZE x 3
+};
+
+// The crops of one frame: a contiguous run of tiles in the crop ring.
+// Batches are released in the order they were started, so the capture side
+// can fill frame N+1 while the varroa side still holds frame N.
+struct CropBatch {
+  uint32_t frame;
+  uint32_t first;
+  uint32_t count;
+};
+
+bool crop_queue_init(uint32_t want_tiles);
+uint32_t crop_queue_capacity();
+uint32_t crop_queue_free();
+
+void crop_batch_begin(CropBatch& b, uint32_t frame);
+CropTile* crop_batch_push(CropBatch& b);
+CropTile* crop_batch_at(const CropBatch& b, uint32_t i);
+// Oldest batch first: frees its tiles from the tail of the ring.
+void crop_batch_release(CropBatch& b);
+// The batch just filled, not handed on (an abort, a failed decode): gives
+// its tiles back at the head, ahead of any older batch still queued.
+void crop_batch_discard(CropBatch& b);
+
+void crop_tile_basename(const CropTile& t, char* out, size_t out_sz);
@@ -1,22 +1,78 @@
 #include "ei_signal_shim.h"
 #include "../globals.h"
+#include "../metrics/metrics.h"
 
-int ei_bee_get_data(size_t offset, size_t length, float *out_ptr) {
-  size_t pixel_ix = offset * 3;
-  for (size_t i=0;i<length;i++, pixel_ix+=3) {
-    out_ptr[i] = (snapshot_buf[pixel_ix] << 16) |
-                 (snapshot_buf[pixel_ix + 1] << 8) |
-                  snapshot_buf[pixel_ix + 2];
+// The SDK pulls the image through get_data() in pages of floats, one
+// 0xRRGGBB value per pixel, and unpacks (and for int8 models quantizes)
+// them again on its side. That contract is fixed by the exported library,
+// so what we can do is make our half cheap: four pixels per iteration out
+// of three aligned 32-bit loads instead of twelve byte loads.
+//
+// Swap: the buffer holds B,G,R and the model wants the first byte low.
+template <bool Swap>
+static inline float pack_px(uint32_t b0, uint32_t b1, uint32_t b2) {
+  return (float)(Swap ? (b2 << 16 | b1 << 8 | b0) : (b0 << 16 | b1 << 8 | b2));
+}
+
+template <bool Swap>
+static void pack_888_to_f32(const uint8_t* src, size_t length, float* out) {
+  size_t i = 0;
+
+  if (((uintptr_t)src & 3u) == 0) {
+    const uint8_t* p = (const uint8_t*)__builtin_assume_aligned(src, 4);
+    for (; i + 4 <= length; i += 4, p += 12) {
+      uint32_t w0, w1, w2;   // little-endian: byte 0 is the low byte
+      memcpy(&w0, p, 4);
+      memcpy(&w1, p + 4, 4);
+      memcpy(&w2, p + 8, 4);
+
+      out[i]     = pack_px<Swap>(w0 & 0xffu, (w0 >> 8) & 0xffu, (w0 >> 16) & 0xffu);
+      out[i + 1] = pack_px<Swap>(w0 >> 24, w1 & 0xffu, (w1 >> 8) & 0xffu);
+      out[i + 2] = pack_px<Swap>((w1 >> 16) & 0xffu, w1 >> 24, w2 & 0xffu);
+      out[i + 3] = pack_px<Swap>((w2 >> 8) & 0xffu, (w2 >> 16) & 0xffu, w2 >> 24);
+    }
+    src = p;
   }
+
+  for (; i < length; ++i, src += 3) out[i] = pack_px<Swap>(src[0], src[1], src[2]);
+}
+
+int ei_bee_get_data(size_t offset, size_t length, float *out_ptr) {
+  // bytes go in as they lie, as they always have: the bee model was trained on that
+  pack_888_to_f32<false>(snapshot_buf + offset * 3, length, out_ptr);
   return 0;
 }
 
+static const uint8_t* g_varroa_input = nullptr;
+
+void ei_varroa_set_input(const uint8_t* px) {
+  g_varroa_input = px;
+}
+
 int ei_varroa_get_data(size_t offset, size_t length, float *out_ptr) {
-  size_t pixel_ix = offset * 3;
-  for (size_t i = 0; i < length; i++, pixel_ix += 3) {
-    out_ptr[i] = (float)((uint32_t)g_var_snapshot_buf[pixel_ix] << 16 |
-                         (uint32_t)g_var_snapshot_buf[pixel_ix + 1] << 8  |
-                         (uint32_t)g_var_snapshot_buf[pixel_ix + 2]);
-  }
+  // tiles come from the decoder as B,G,R; the varroa model was trained on
+  // crops that reached it as R,G,B
+  pack_888_to_f32<true>((g_varroa_input ? g_varroa_input : g_var_snapshot_buf) + offset * 3, length, out_ptr);
   return 0;
 }
+
+static SemaphoreHandle_t g_impulse_mu = nullptr;
+static portMUX_TYPE g_impulse_mu_init = portMUX_INITIALIZER_UNLOCKED;
+
+void ei_impulse_lock() {
+  if (!g_impulse_mu) {
+    SemaphoreHandle_t m = xSemaphoreCreateMutex();
+    portENTER_CRITICAL(&g_impulse_mu_init);
+    if (!g_impulse_mu) { g_impulse_mu = m; m = nullptr; }
+    portEXIT_CRITICAL(&g_impulse_mu_init);
+    if (m) vSemaphoreDelete(m);
+  }
+  if (xSemaphoreTake(g_impulse_mu, 0) == pdTRUE) return;
+  const uint32_t t0 = metrics_now_us();
+  xSemaphoreTake(g_impulse_mu, portMAX_DELAY);
+  metrics_record(Metric::InferWait, metrics_now_us() - t0);
+}
+
+void ei_impulse_unlock() {
+  xSemaphoreGive(g_impulse_mu);
+}
@@ -1,5 +1,18 @@
 #pragma once
 #include <stddef.h>
+#include <stdint.h>
 
 int ei_bee_get_data(size_t offset, size_t length, float* out_ptr);
+
+// Varroa input for the next process_impulse (varroa input size, decoder
+// B,G,R order, handed to the model as R,G,B); a crop tile or
+// g_var_snapshot_buf.
+void ei_varroa_set_input(const uint8_t* px);
 int ei_varroa_get_data(size_t offset, size_t length, float* out_ptr);
+
+// The merged library shares one tensor arena, DSP scratch and result box
+// buffer between the two impulses, so they are not reentrant against each
+// other. Hold this from run_classifier / process_impulse until the result
+// has been copied out; time spent waiting goes to Metric::InferWait.
+void ei_impulse_lock();
+void ei_impulse_unlock();
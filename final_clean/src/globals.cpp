@@ -1,8 +1,8 @@
 #include "globals.h"
 
 // UI flags
-volatile bool g_infer_enabled = false;
-volatile bool g_save_enabled  = false;
+std::atomic<bool> g_infer_enabled{false};
+std::atomic<bool> g_save_enabled{false};
 bool g_web_started = false;
 
 // runtime state
@@ -11,21 +11,21 @@ bool debug_nn = false;
 
 uint8_t* snapshot_buf      = nullptr;
 uint8_t* g_fullstage_buf   = nullptr;
-uint8_t* g_crop_rgb        = nullptr;
-uint8_t* g_bee_overlay_buf = nullptr;
+uint8_t* g_stage1_buf      = nullptr;
+size_t g_stage1_bytes      = 0;
 
 uint16_t g_full_w = FULL_W;
 uint16_t g_full_h = FULL_H;
 
 char g_last_frame_path[128] = {0};
 char g_last_meta_path[128]  = {0};
-uint32_t g_frame_counter = 0;
+std::atomic<uint32_t> g_frame_counter{0};
 
 bool g_sd_ok = false;
 
 // timing
 uint32_t INFER_PERIOD_MS = 5000;
-uint32_t last_infer_ms = 0;
+std::atomic<bool> g_sched_adaptive{SCHED_ADAPTIVE};
 
 // boot session dirs + log
 char g_frames_dir[64]       = {0};
@@ -38,6 +38,7 @@ char g_overlays_nomite_dir[96] = {0};
 const bool LOG_ECHO_SERIAL = true;
 
 const char* LOG_DIR = "/logs";
+const char* PACK_DIR = "/packs";
 const char* BOOT_ID_PATH = "/logs/boot_id.txt";
 const char* OVERLAY_MITE_SUBDIR = "mite";
 const char* OVERLAY_NO_MITE_SUBDIR = "no_mite";
@@ -46,13 +47,8 @@ uint32_t g_boot_id = 0;
 char g_log_path[128] = {0};
 File g_log_file;
 
-// crop meta
-CropMeta g_crop_meta[MAX_CROPS];
-uint32_t g_crop_count = 0;
-
 // varroa buffers
 uint8_t* g_var_snapshot_buf = nullptr;
-uint8_t* g_var_overlay_buf  = nullptr;
 
 // counting
 uint32_t g_round_bees  = 0;
@@ -60,5 +56,36 @@ uint32_t g_round_mites = 0;
 volatile uint32_t g_total_bees  = 0;
 volatile uint32_t g_total_mites = 0;
 
+static portMUX_TYPE g_counts_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static CountSnapshot counters_read_locked() {
+  return { g_round_bees, g_round_mites, g_total_bees, g_total_mites };
+}
+
+CountSnapshot counters_add_cycle(uint32_t bees, uint32_t mites) {
+  portENTER_CRITICAL(&g_counts_mux);
+  g_round_bees  += bees;
+  g_round_mites += mites;
+  g_total_bees  += bees;
+  g_total_mites += mites;
+  const CountSnapshot s = counters_read_locked();
+  portEXIT_CRITICAL(&g_counts_mux);
+  return s;
+}
+
+CountSnapshot counters_snapshot() {
+  portENTER_CRITICAL(&g_counts_mux);
+  const CountSnapshot s = counters_read_locked();
+  portEXIT_CRITICAL(&g_counts_mux);
+  return s;
+}
+
+void counters_reset_round() {
+  portENTER_CRITICAL(&g_counts_mux);
+  g_round_bees = 0;
+  g_round_mites = 0;
+  portEXIT_CRITICAL(&g_counts_mux);
+}
+
 // LED
 Adafruit_NeoPixel strip(LED_COUNT, LED_PIN, NEO_GRB + NEO_KHZ800);
@@ -4,14 +4,17 @@
 #include <SD_MMC.h>
 #include <esp_camera.h>
 #include <Adafruit_NeoPixel.h>
+#include <atomic>
 
 #include "app_config.h"
 
 // -------------------------------
 // Globals that UI may depend on
 // -------------------------------
-extern volatile bool g_infer_enabled;
-extern volatile bool g_save_enabled;
+// Written by the web task, read by the pipeline (and the other way round
+// for the frame counter), so they are atomics.
+extern std::atomic<bool> g_infer_enabled;
+extern std::atomic<bool> g_save_enabled;
 extern bool g_web_started;
 
 // -------------------------------
@@ -22,21 +25,21 @@ extern bool debug_nn;
 
 extern uint8_t* snapshot_buf;
 extern uint8_t* g_fullstage_buf;
-extern uint8_t* g_crop_rgb;
-extern uint8_t* g_bee_overlay_buf;
+extern uint8_t* g_stage1_buf;      // scaled decode target (CAPTURE_SCALED_DECODE)
+extern size_t g_stage1_bytes;
 
 extern uint16_t g_full_w;
 extern uint16_t g_full_h;
 
 extern char g_last_frame_path[128];
 extern char g_last_meta_path[128];
-extern uint32_t g_frame_counter;
+extern std::atomic<uint32_t> g_frame_counter;
 
 extern bool g_sd_ok;
 
 // timing
 extern uint32_t INFER_PERIOD_MS;
-extern uint32_t last_infer_ms;
+extern std::atomic<bool> g_sched_adaptive;   // src/sched/scheduler.h
 
 // -------------------------------
 // Boot session dirs + log
@@ -49,6 +52,7 @@ extern char g_overlays_mite_dir[96];
 extern char g_overlays_nomite_dir[96];
 
 extern const char* LOG_DIR;
+extern const char* PACK_DIR;
 extern const char* BOOT_ID_PATH;
 extern const char* OVERLAY_MITE_SUBDIR;
 extern const char* OVERLAY_NO_MITE_SUBDIR;
@@ -60,17 +64,16 @@ extern File g_log_file;
 extern const bool LOG_ECHO_SERIAL;
 
 // -------------------------------
-// Crop bookkeeping
+// Bee detections handed from stage 1 to the crop stage
+// (centers are in bee-model input coordinates)
 // -------------------------------
-struct CropMeta { uint32_t bbox_index; char path[128]; };
-extern CropMeta g_crop_meta[MAX_CROPS];
-extern uint32_t g_crop_count;
+struct BeeDetection { uint32_t bbox_index; float cx; float cy; float score; char label[12]; uint32_t track; };
+struct BeeDetections { uint32_t count; BeeDetection items[MAX_CROPS]; };
 
 // -------------------------------
 // Varroa buffers
 // -------------------------------
 extern uint8_t* g_var_snapshot_buf;
-extern uint8_t* g_var_overlay_buf;
 
 // -------------------------------
 // Counting
@@ -80,6 +83,13 @@ extern uint32_t g_round_mites;
 extern volatile uint32_t g_total_bees;
 extern volatile uint32_t g_total_mites;
 
+// The varroa task and the UI touch these from different cores; go through
+// the helpers below so bees and mites always move together.
+struct CountSnapshot { uint32_t round_bees; uint32_t round_mites; uint32_t total_bees; uint32_t total_mites; };
+CountSnapshot counters_add_cycle(uint32_t bees, uint32_t mites);
+CountSnapshot counters_snapshot();
+void counters_reset_round();
+
 // -------------------------------
 // LED object (optional global)
 // -------------------------------
@@ -4,8 +4,9 @@ enum class LedState : uint8_t { Unknown, Green, Red };
 static LedState g_led_state = LedState::Unknown;
 
 static inline double avg_weighted_pct_boot() {
-  if (g_total_bees == 0) return 0.0;
-  return 100.0 * (double)g_total_mites / (double)g_total_bees;
+  const CountSnapshot c = counters_snapshot();
+  if (c.total_bees == 0) return 0.0;
+  return 100.0 * (double)c.total_mites / (double)c.total_bees;
 }
 
 static void led_set_rgb(uint8_t r, uint8_t g, uint8_t b) {
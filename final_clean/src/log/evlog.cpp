@@ -0,0 +1,261 @@
+#include "evlog.h"
+#include "../sd/sd_writer.h"
+
+static constexpr uint32_t FLUSH_TASK_STACK = 6144;
+static constexpr UBaseType_t FLUSH_TASK_PRIO = 1;
+static constexpr uint8_t FILE_VERSION = 1;
+
+// Byte ring of whole records. Producers copy in under the mux; the single
+// flush task reads the used span without it, since nothing overwrites that
+// span until the flush task gives it back.
+static uint8_t* g_ring = nullptr;
+static uint32_t g_cap = 0;
+static uint32_t g_head = 0;     // next write offset
+static uint32_t g_used = 0;
+static uint32_t g_dropped = 0;
+static portMUX_TYPE g_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static uint8_t* g_block = nullptr;
+static SemaphoreHandle_t g_kick = nullptr;
+static TaskHandle_t g_task = nullptr;
+static volatile bool g_flushing = false;
+
+static void echo_record(const EvHeader& h, const uint8_t* args) {
+  char line[512];
+  const size_t n = evlog_format(h, args, line, sizeof(line));
+  if (n) Serial.write((const uint8_t*)line, n);
+}
+
+void evlog_commit(EvRecord& r) {
+  r.hdr.ms = millis();
+  const uint32_t len = (uint32_t)sizeof(EvHeader) + r.hdr.len;
+
+  if (!g_ring) {
+    // before evlog_begin(): nowhere to buffer, echo straight away
+    if (LOG_ECHO_SERIAL) echo_record(r.hdr, r.args);
+    return;
+  }
+
+  bool kick = false;
+  portENTER_CRITICAL(&g_mux);
+  if (g_used + len > g_cap) {
+    g_dropped++;
+  } else {
+    const uint8_t* src = (const uint8_t*)&r;
+    const uint32_t first = (g_cap - g_head < len) ? (g_cap - g_head) : len;
+    memcpy(g_ring + g_head, src, first);
+    if (first < len) memcpy(g_ring, src + first, len - first);
+    g_head = (g_head + len) % g_cap;
+    g_used += len;
+    kick = (g_used >= g_cap / 2) && (g_used - len < g_cap / 2);
+  }
+  portEXIT_CRITICAL(&g_mux);
+
+  if (kick && g_kick) xSemaphoreGive(g_kick);
+}
+
+// Moves up to one block of whole records out of the ring; returns bytes moved.
+static uint32_t take_block() {
+  portENTER_CRITICAL(&g_mux);
+  const uint32_t used = g_used;
+  const uint32_t tail = (g_head + g_cap - g_used) % g_cap;
+  portEXIT_CRITICAL(&g_mux);
+
+  uint32_t want = (used < LOG_FLUSH_BLOCK) ? used : LOG_FLUSH_BLOCK;
+  const uint32_t first = (g_cap - tail < want) ? (g_cap - tail) : want;
+  memcpy(g_block, g_ring + tail, first);
+  if (first < want) memcpy(g_block + first, g_ring, want - first);
+
+  uint32_t off = 0;
+  while (off + sizeof(EvHeader) <= want) {
+    EvHeader h;
+    memcpy(&h, g_block + off, sizeof(h));
+    const uint32_t len = (uint32_t)sizeof(EvHeader) + h.len;
+    if (off + len > want) break;
+    off += len;
+  }
+
+  portENTER_CRITICAL(&g_mux);
+  g_used -= off;
+  portEXIT_CRITICAL(&g_mux);
+  return off;
+}
+
+static void flush_pending() {
+  while (true) {
+    g_flushing = true;
+    const uint32_t n = take_block();
+    if (!n) break;
+
+    if (LOG_ECHO_SERIAL) {
+      for (uint32_t off = 0; off < n; ) {
+        EvHeader h;
+        memcpy(&h, g_block + off, sizeof(h));
+        echo_record(h, g_block + off + sizeof(h));
+        off += (uint32_t)sizeof(h) + h.len;
+      }
+    }
+
+    if (sd_writes_enabled()) (void)sd_writer_submit_log(g_block, n);
+  }
+
+  portENTER_CRITICAL(&g_mux);
+  const uint32_t dropped = g_dropped;
+  g_dropped = 0;
+  portEXIT_CRITICAL(&g_mux);
+  if (dropped) EVLOG(LOG_DROPPED, (unsigned long)dropped);
+
+  g_flushing = false;
+}
+
+static void flush_task(void*) {
+  while (true) {
+    xSemaphoreTake(g_kick, pdMS_TO_TICKS(LOG_FLUSH_MS));
+    flush_pending();
+  }
+}
+
+// Allocates the ring. Events logged from here on are buffered until
+// evlog_start_flush(), so boot lines still reach the session log.
+bool evlog_begin() {
+  if (g_ring) return true;
+
+  uint8_t* ring = (uint8_t*)ps_malloc(LOG_RING_BYTES);
+  g_block = (uint8_t*)ps_malloc(LOG_FLUSH_BLOCK);
+  g_kick = xSemaphoreCreateBinary();
+  if (!ring || !g_block || !g_kick) {
+    free(ring); free(g_block);
+    g_block = nullptr;
+    return false;
+  }
+  g_cap = LOG_RING_BYTES;
+  g_ring = ring;
+  return true;
+}
+
+// Call once the SD writer is up (or known to be unavailable).
+bool evlog_start_flush() {
+  if (g_task) return true;
+  if (!g_ring) return false;
+  return xTaskCreate(flush_task, "evlog", FLUSH_TASK_STACK, nullptr, FLUSH_TASK_PRIO, &g_task) == pdPASS;
+}
+
+// Returns once everything logged so far has been handed to the SD writer.
+void evlog_sync() {
+  if (!g_task) return;
+  while (true) {
+    xSemaphoreGive(g_kick);
+    vTaskDelay(1);
+    portENTER_CRITICAL(&g_mux);
+    const bool empty = (g_used == 0);
+    portEXIT_CRITICAL(&g_mux);
+    if (empty && !g_flushing) return;
+  }
+}
+
+uint32_t evlog_dropped() {
+  portENTER_CRITICAL(&g_mux);
+  const uint32_t d = g_dropped;
+  portEXIT_CRITICAL(&g_mux);
+  return d;
+}
+
+static uint32_t table_hash() {
+  uint32_t h = 2166136261u;   // FNV-1a over every format including its NUL
+  for (size_t i = 0; i < (size_t)EvId::COUNT; ++i) {
+    const char* s = EVLOG_FMT[i];
+    do { h ^= (uint8_t)*s; h *= 16777619u; } while (*s++);
+  }
+  return h;
+}
+
+bool evlog_write_file_header(File& f) {
+  uint8_t hdr[12] = { 'E', 'V', 'L', 'G', FILE_VERSION, (uint8_t)sizeof(EvHeader) };
+  const uint16_t count = (uint16_t)EvId::COUNT;
+  const uint32_t hash = table_hash();
+  memcpy(hdr + 6, &count, 2);
+  memcpy(hdr + 8, &hash, 4);
+  return f.write(hdr, sizeof(hdr)) == sizeof(hdr);
+}
+
+// ---- formatting ----
+
+struct EvArg {
+  char tag;
+  int64_t i;
+  uint64_t u;
+  double f;
+  char s[256];
+};
+
+static bool next_arg(const uint8_t*& p, const uint8_t* end, EvArg& a) {
+  if (p >= end) return false;
+  a.tag = (char)*p++;
+  switch (a.tag) {
+    case 'i': { int32_t v;  if (end - p < 4) return false; memcpy(&v, p, 4); p += 4; a.i = v; a.u = (uint64_t)(int64_t)v; a.f = v; return true; }
+    case 'u': { uint32_t v; if (end - p < 4) return false; memcpy(&v, p, 4); p += 4; a.u = v; a.i = v; a.f = v; return true; }
+    case 'I': { int64_t v;  if (end - p < 8) return false; memcpy(&v, p, 8); p += 8; a.i = v; a.u = (uint64_t)v; a.f = (double)v; return true; }
+    case 'U': { uint64_t v; if (end - p < 8) return false; memcpy(&v, p, 8); p += 8; a.u = v; a.i = (int64_t)v; a.f = (double)v; return true; }
+    case 'f': { float v;    if (end - p < 4) return false; memcpy(&v, p, 4); p += 4; a.f = v; a.i = (int64_t)v; a.u = (uint64_t)a.i; return true; }
+    case 's': {
+      if (end - p < 1) return false;
+      size_t n = *p++;
+      if ((size_t)(end - p) < n) return false;
+      memcpy(a.s, p, n);
+      a.s[n] = 0;
+      p += n;
+      return true;
+    }
+  }
+  return false;
+}
+
+size_t evlog_format(const EvHeader& h, const uint8_t* args, char* out, size_t cap) {
+  if (!cap) return 0;
+  out[0] = 0;
+  if (h.id >= (uint16_t)EvId::COUNT) return (size_t)snprintf(out, cap, "EVLOG unknown id=%u\n", (unsigned)h.id);
+
+  const uint8_t* p = args;
+  const uint8_t* end = args + h.len;
+  size_t pos = 0;
+  EvArg a;
+
+  for (const char* f = EVLOG_FMT[h.id]; *f && pos + 1 < cap; ) {
+    if (*f != '%') { out[pos++] = *f++; continue; }
+    if (f[1] == '%') { out[pos++] = '%'; f += 2; continue; }
+
+    // %[flags][width][.prec][length]conv -> keep flags/width/prec, pick our own length
+    char spec[16];
+    size_t k = 0;
+    spec[k++] = *f++;
+    while (*f && strchr("-+ #0", *f) && k < 8) spec[k++] = *f++;
+    while (*f >= '0' && *f <= '9' && k < 10) spec[k++] = *f++;
+    if (*f == '.') { spec[k++] = *f++; while (*f >= '0' && *f <= '9' && k < 12) spec[k++] = *f++; }
+    while (*f && strchr("hlzjtL", *f)) f++;
+    const char conv = *f ? *f++ : 's';
+
+    if (!next_arg(p, end, a)) { a.tag = 's'; strcpy(a.s, "?"); }
+
+    int w = 0;
+    const size_t room = cap - pos;
+    switch (conv) {
+      case 'd': case 'i':
+        memcpy(spec + k, "lld", 4); w = snprintf(out + pos, room, spec, (long long)a.i); break;
+      case 'u': case 'x': case 'X': case 'o':
+        spec[k] = 'l'; spec[k + 1] = 'l'; spec[k + 2] = conv; spec[k + 3] = 0;
+        w = snprintf(out + pos, room, spec, (unsigned long long)a.u); break;
+      case 'c':
+        spec[k] = 'c'; spec[k + 1] = 0; w = snprintf(out + pos, room, spec, (int)a.i); break;
+      case 'f': case 'F': case 'e': case 'E': case 'g': case 'G':
+        spec[k] = conv; spec[k + 1] = 0; w = snprintf(out + pos, room, spec, a.f); break;
+      default:
+        if (a.tag != 's') snprintf(a.s, sizeof(a.s), "%lld", (long long)a.i);
+        spec[k] = 's'; spec[k + 1] = 0; w = snprintf(out + pos, room, spec, a.s); break;
+    }
+    if (w < 0) break;
+    pos += ((size_t)w < room) ? (size_t)w : room - 1;
+  }
+
+  out[pos] = 0;
+  return pos;
+}
@@ -0,0 +1,145 @@
+#pragma once
+#include "../globals.h"
+#include "evlog_events.h"
+
+#include <type_traits>
+
+// Binary event log. EVLOG(NAME, args...) records the event id, a millis()
+// stamp and the raw arguments; formatting happens later on the flush task
+// (Serial echo) or on the host (tools/decode_log.py).
+//
+// Record on the ring and on disk: EvHeader, then per argument a type tag
+// followed by the value ('i'/'u' 32-bit, 'I'/'U' 64-bit, 'f' float,
+// 's' length byte + chars).
+
+enum class EvCat : uint8_t { CORE, CAM, BEE, CROP, VARROA, SD, PIPE };
+
+enum class EvId : uint16_t {
+#define EVLOG_X_ID(name, cat, lvl, fmt) name,
+  EVLOG_EVENTS(EVLOG_X_ID)
+#undef EVLOG_X_ID
+  COUNT
+};
+
+struct __attribute__((packed)) EvHeader {
+  uint16_t id;
+  uint16_t len;   // argument bytes following the header
+  uint32_t ms;
+};
+
+static constexpr size_t EVLOG_MAX_ARGS_BYTES = 384;
+
+static constexpr const char* const EVLOG_FMT[] = {
+#define EVLOG_X_FMT(name, cat, lvl, fmt) fmt,
+  EVLOG_EVENTS(EVLOG_X_FMT)
+#undef EVLOG_X_FMT
+};
+
+static constexpr EvCat EVLOG_CAT[] = {
+#define EVLOG_X_CAT(name, cat, lvl, fmt) EvCat::cat,
+  EVLOG_EVENTS(EVLOG_X_CAT)
+#undef EVLOG_X_CAT
+};
+
+static constexpr LogLevel EVLOG_LEVEL[] = {
+#define EVLOG_X_LVL(name, cat, lvl, fmt) LogLevel::lvl,
+  EVLOG_EVENTS(EVLOG_X_LVL)
+#undef EVLOG_X_LVL
+};
+
+// indexed by EvCat
+static constexpr LogLevel EVLOG_CAT_LEVEL[] = {
+  LOG_LEVEL_CORE, LOG_LEVEL_CAM, LOG_LEVEL_BEE, LOG_LEVEL_CROP,
+  LOG_LEVEL_VARROA, LOG_LEVEL_SD, LOG_LEVEL_PIPE,
+};
+
+constexpr bool evlog_enabled(EvId id) {
+  return EVLOG_LEVEL[(size_t)id] != LogLevel::Off &&
+         (uint8_t)EVLOG_LEVEL[(size_t)id] <= (uint8_t)EVLOG_CAT_LEVEL[(size_t)EVLOG_CAT[(size_t)id]];
+}
+
+constexpr uint8_t evlog_count_args(const char* f, uint8_t n = 0) {
+  return !*f ? n
+       : (f[0] != '%') ? evlog_count_args(f + 1, n)
+       : (f[1] == '%') ? evlog_count_args(f + 2, n)
+       : evlog_count_args(f + 1, (uint8_t)(n + 1));
+}
+
+struct EvRecord {
+  EvHeader hdr;
+  uint8_t args[EVLOG_MAX_ARGS_BYTES];
+};
+
+bool evlog_begin();
+bool evlog_start_flush();
+void evlog_commit(EvRecord& r);
+void evlog_sync();
+uint32_t evlog_dropped();
+
+// File header for .blg logs: magic, version, event count, table hash.
+bool evlog_write_file_header(File& f);
+
+// Formats one record (header + args) into out; returns the text length.
+size_t evlog_format(const EvHeader& h, const uint8_t* args, char* out, size_t cap);
+
+// ---- argument packing ----
+
+inline void evlog_put(EvRecord& r, char tag, const void* v, size_t n) {
+  if ((size_t)r.hdr.len + 1 + n > sizeof(r.args)) return;
+  r.args[r.hdr.len++] = (uint8_t)tag;
+  memcpy(r.args + r.hdr.len, v, n);
+  r.hdr.len += (uint16_t)n;
+}
+
+template <typename T>
+inline typename std::enable_if<std::is_integral<T>::value>::type
+evlog_arg(EvRecord& r, T v) {
+  if (sizeof(T) <= 4) {
+    if (std::is_signed<T>::value) { int32_t x = (int32_t)v; evlog_put(r, 'i', &x, 4); }
+    else                          { uint32_t x = (uint32_t)v; evlog_put(r, 'u', &x, 4); }
+  } else {
+    if (std::is_signed<T>::value) { int64_t x = (int64_t)v; evlog_put(r, 'I', &x, 8); }
+    else                          { uint64_t x = (uint64_t)v; evlog_put(r, 'U', &x, 8); }
+  }
+}
+
+template <typename T>
+inline typename std::enable_if<std::is_enum<T>::value>::type
+evlog_arg(EvRecord& r, T v) {
+  int32_t x = (int32_t)v;
+  evlog_put(r, 'i', &x, 4);
+}
+
+inline void evlog_arg(EvRecord& r, double v) {
+  float x = (float)v;
+  evlog_put(r, 'f', &x, 4);
+}
+
+inline void evlog_arg(EvRecord& r, const char* s) {
+  if (!s) s = "";
+  size_t n = strlen(s);
+  if (n > 255) n = 255;
+  const size_t room = sizeof(r.args) - r.hdr.len;
+  if (room < 2) return;
+  if (n > room - 2) n = room - 2;
+  r.args[r.hdr.len++] = (uint8_t)'s';
+  r.args[r.hdr.len++] = (uint8_t)n;
+  memcpy(r.args + r.hdr.len, s, n);
+  r.hdr.len += (uint16_t)n;
+}
+
+template <EvId ID, typename... A>
+inline void evlog_emit(A... a) {
+  static_assert(sizeof...(A) == evlog_count_args(EVLOG_FMT[(size_t)ID]),
+                "EVLOG argument count does not match the event format");
+  if (!evlog_enabled(ID)) return;
+
+  EvRecord r;
+  r.hdr.id = (uint16_t)ID;
+  r.hdr.len = 0;
+  int unpack[] = { 0, (evlog_arg(r, a), 0)... };
+  (void)unpack;
+  evlog_commit(r);
+}
+
+#define EVLOG(name, ...) evlog_emit<EvId::name>(__VA_ARGS__)
@@ -0,0 +1,63 @@
+#pragma once
+
+// Event table for the binary log: X(name, category, level, format).
+// The format is printf-style and is what the Serial echo and the host
+// decoder (tools/decode_log.py, which parses this file) produce.
+// Append new events at the end; ids are positions in this list.
+#define EVLOG_EVENTS(X) \
+  X(TEXT,                 CORE,   Info,  "%s") \
+  X(LOG_DROPPED,          CORE,   Warn,  "LOG dropped=%lu records (ring full)\n") \
+  X(BOOT,                 CORE,   Info,  "=== BOOT %lu === millis=%lu ===\n") \
+  X(BOOT_DIRS,            CORE,   Info,  "DIR frames=%s\nDIR bee_overlays=%s\nDIR crops=%s\nDIR overlays=%s\n") \
+  X(BOOT_DIRS_OVERLAYS,   CORE,   Info,  "DIR overlays/mite=%s\nDIR overlays/no_mite=%s\n") \
+  X(LOG_PATH,             CORE,   Info,  "LOG_PATH=%s\n") \
+  X(CAM_NOT_INIT,         CAM,    Error, "ERR camera not initialized\n") \
+  X(CAM_CAPTURE_FAIL,     CAM,    Error, "ERR camera capture failed\n") \
+  X(CAM_DECODE_FAIL,      CAM,    Error, "ERR full decode failed\n") \
+  X(CYCLE_START,          PIPE,   Info,  "\n=== CYCLE frame=%lu millis=%lu ===\n") \
+  X(CYCLE_FAIL_CAPTURE,   PIPE,   Warn,  "CYCLE fail capture\n") \
+  X(CYCLE_FAIL_CLASSIFY,  PIPE,   Error, "CYCLE fail run_classifier err=%d\n") \
+  X(CYCLE_SUMMARY,        PIPE,   Info,  "CYCLE_SUMMARY frame=%lu bees=%lu mites=%lu | round bees=%lu/%lu mites=%lu | totals bees=%lu mites=%lu\n") \
+  X(ROUND_DONE,           PIPE,   Info,  "[ROUND DONE] bees=%lu mites=%lu => %.2f%% | avg_weighted=%.2f%% | totals bees=%lu mites=%lu\n") \
+  X(VARROA_SKIP,          PIPE,   Info,  "VARROA skip frame=%lu centers=%lu crops=0\n") \
+  X(BEE_DETECTIONS,       BEE,    Info,  "BEE_DETECTIONS count=%lu (>=%.2f)\n") \
+  X(BEE_BB,               BEE,    Debug, "  bee_bb[%lu] label=%s score=%.3f x=%.1f y=%.1f w=%.1f h=%.1f\n") \
+  X(CROPS_SKIP_NO_CENTERS,CROP,   Info,  "CROPS skip (no centers)\n") \
+  X(CROPS_SKIP_NO_FRAME,  CROP,   Warn,  "CROPS skip (no decoded frame)\n") \
+  X(CROPS_START,          CROP,   Info,  "CROPS start n=%lu CROP_SIZE=%d\n") \
+  X(CROPS_QUEUE_FULL,     CROP,   Warn,  "CROPS queue full cap=%lu\n") \
+  X(CROP,                 CROP,   Debug, "CROP slot=%lu score=%.3f center=(%.1f,%.1f) full_roi=(%d,%d)\n") \
+  X(CROPS_DONE,           CROP,   Info,  "CROPS done queued=%lu\n") \
+  X(VARROA_BATCH_START,   VARROA, Info,  "VARROA batch start frame=%lu crops=%lu\n") \
+  X(VARROA_ERR,           VARROA, Error, "VARROA process_impulse error=%d crop=%s\n") \
+  X(VARROA_NONE,          VARROA, Debug, "VARROA none (>%.2f) crop=%s\n") \
+  X(VARROA_MITES,         VARROA, Info,  "VARROA mites=%lu crop=%s\n") \
+  X(VARROA_BATCH_DONE,    VARROA, Info,  "VARROA batch done frame=%lu mites_total=%lu\n") \
+  X(SAVE_OK,              SD,     Debug, "SAVE_OK %s path=%s bytes=%lu lat_ms=%lu\n") \
+  X(SAVE_FAIL,            SD,     Error, "SAVE_FAIL %s path=%s\n") \
+  X(SDW_DROP,             SD,     Warn,  "SDW drop %s path=%s (queue full)\n") \
+  X(SDW_EVICTED,          SD,     Warn,  "SDW evicted=%lu older jobs for %s path=%s\n") \
+  X(SDW_OOM,              SD,     Error, "SDW oom %s bytes=%lu\n") \
+  X(SDW_STATS,            SD,     Info,  "SDW jobs=%lu failed=%lu dropped=%lu queued=%lu/%luB peak=%lu written=%lluB lat_ms last=%lu max=%lu\n") \
+  X(CROPS_DECODE_FAIL,    CROP,   Error, "CROPS window decode failed crops=%lu\n") \
+  X(OVERLAY_RENDER,       SD,     Debug, "OVERLAY render path=%s bytes=%lu ms=%lu\n") \
+  X(OVERLAY_FAIL,         SD,     Warn,  "OVERLAY render failed path=%s\n") \
+  X(CROP_MERGED,          CROP,   Debug, "CROP merged score=%.3f center=(%.1f,%.1f) into slot=%lu iou=%.2f\n") \
+  X(CROPS_DEDUP,          CROP,   Info,  "CROPS dedup centers=%lu crops=%lu merged=%lu\n") \
+  X(TRACK_FRAME,          BEE,    Info,  "TRACK frame=%lu centers=%lu new=%lu classify=%lu live=%lu\n") \
+  X(MOTION_SKIP,          CAM,    Debug, "MOTION skip changed=%.3f skipped=%lu\n") \
+  X(MOTION_RUN,           CAM,    Info,  "MOTION run changed=%.3f runs=%lu skipped=%lu\n") \
+  X(SCHED_MODE,           PIPE,   Info,  "SCHED mode=%s bees=%lu period_ms=%lu\n") \
+  X(THUMB_RENDER,         SD,     Debug, "THUMB render path=%s %ux%u bytes=%lu ms=%lu\n") \
+  X(LIVE_OPEN,            CORE,   Info,  "LIVE client open fps=%lu clients=%lu\n") \
+  X(LIVE_CLOSE,           CORE,   Info,  "LIVE client close frames=%lu\n") \
+  X(SSE_OPEN,             CORE,   Info,  "SSE client open last_id=%lu clients=%lu\n") \
+  X(SSE_CLOSE,            CORE,   Info,  "SSE client close events=%lu last_id=%lu\n") \
+  X(EXPORT_DONE,          SD,     Info,  "EXPORT %s files=%lu bytes=%lu ms=%lu ok=%u\n") \
+  X(PACK_OPEN,            SD,     Info,  "PACK open path=%s alloc=%lu\n") \
+  X(PACK_SEAL,            SD,     Debug, "PACK seal %s entries=%lu end=%lu ms=%lu\n") \
+  X(PACK_FULL,            SD,     Warn,  "PACK full %s entries=%lu, writing plain files\n") \
+  X(PACK_RECOVER,         SD,     Info,  "PACK load %s entries=%lu scanned=%lu ms=%lu\n") \
+  X(STORAGE_CENSUS,       SD,     Info,  "STORAGE census boots=%lu ms=%lu\n") \
+  X(STORAGE_RECLAIM,      SD,     Info,  "STORAGE reclaim %s boot=%lu files=%lu kb=%lu why=%s\n") \
+  X(TRACK_CREDIT_MISS,    BEE,    Warn,  "TRACK credit frame=%lu slot=%lu mites=%lu found no track (misses=%lu)\n")
@@ -0,0 +1,101 @@
+#include "metrics.h"
+
+struct MetricState {
+  uint32_t count;
+  uint32_t min_us;
+  uint32_t max_us;
+  uint64_t total_us;
+  uint32_t buckets[METRIC_BUCKETS];
+};
+
+static MetricState g_metrics[(size_t)Metric::COUNT];
+static portMUX_TYPE g_metrics_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static const char* const METRIC_NAMES[] = {
+  "cycle", "frame", "capture", "camera_grab", "decode", "resize", "bee_infer",
+  "crop_extract", "crop_decode", "varroa_infer", "varroa_batch", "sd_write", "sd_latency",
+  "motion_gate", "decode_wait", "infer_wait",
+};
+static_assert(sizeof(METRIC_NAMES) / sizeof(METRIC_NAMES[0]) == (size_t)Metric::COUNT,
+              "one name per metric");
+
+const char* metric_name(Metric m) {
+  return (size_t)m < (size_t)Metric::COUNT ? METRIC_NAMES[(size_t)m] : "?";
+}
+
+// Half-octave buckets: [2^k, 1.5*2^k) and [1.5*2^k, 2^(k+1)) for k >= 1.
+static inline uint32_t bucket_of(uint32_t us) {
+  if (us < 2) return 0;
+  const uint32_t k = 31u - (uint32_t)__builtin_clz(us);
+  return 2u * k + ((us >> (k - 1)) & 1u) - 1u;
+}
+
+// Largest value that lands in bucket b.
+static inline uint32_t bucket_upper(uint32_t b) {
+  if (b == 0) return 1;
+  const uint32_t k = (b + 1u) / 2u;
+  if (b & 1u) return (3u << (k - 1)) - 1u;
+  return (k >= 31u) ? UINT32_MAX : (1u << (k + 1)) - 1u;
+}
+
+void metrics_record(Metric m, uint32_t us) {
+  if ((size_t)m >= (size_t)Metric::COUNT) return;
+  const uint32_t b = bucket_of(us);
+
+  portENTER_CRITICAL(&g_metrics_mux);
+  MetricState& s = g_metrics[(size_t)m];
+  if (!s.count || us < s.min_us) s.min_us = us;
+  if (us > s.max_us) s.max_us = us;
+  s.count++;
+  s.total_us += us;
+  s.buckets[b < METRIC_BUCKETS ? b : METRIC_BUCKETS - 1]++;
+  portEXIT_CRITICAL(&g_metrics_mux);
+}
+
+static uint32_t percentile(const MetricState& s, uint32_t pct) {
+  const uint64_t rank = ((uint64_t)s.count * pct + 99u) / 100u;   // 1-based
+  uint64_t seen = 0;
+  for (uint32_t b = 0; b < METRIC_BUCKETS; ++b) {
+    const uint32_t n = s.buckets[b];
+    if (seen + n >= rank) {
+      // spread the bucket's samples evenly over it and take the rank-th,
+      // kept inside what was actually seen
+      const uint64_t lo = b ? (uint64_t)bucket_upper(b - 1) + 1u : 0u;
+      const uint64_t hi = bucket_upper(b);
+      const uint64_t v64 = lo + ((hi - lo) * (2u * (rank - seen) - 1u)) / (2u * n);
+      uint32_t v = (uint32_t)v64;
+      if (v > s.max_us) v = s.max_us;
+      if (v < s.min_us) v = s.min_us;
+      return v;
+    }
+    seen += n;
+  }
+  return s.max_us;
+}
+
+MetricSummary metrics_summary(Metric m) {
+  MetricSummary r = {};
+  if ((size_t)m >= (size_t)Metric::COUNT) return r;
+
+  static MetricState s;   // callers are the web handler only
+  portENTER_CRITICAL(&g_metrics_mux);
+  s = g_metrics[(size_t)m];
+  portEXIT_CRITICAL(&g_metrics_mux);
+
+  r.count = s.count;
+  if (!s.count) return r;
+  r.min_us = s.min_us;
+  r.max_us = s.max_us;
+  r.total_us = s.total_us;
+  r.avg_us = (uint32_t)(s.total_us / s.count);
+  r.p50_us = percentile(s, 50);
+  r.p95_us = percentile(s, 95);
+  r.p99_us = percentile(s, 99);
+  return r;
+}
+
+void metrics_reset() {
+  portENTER_CRITICAL(&g_metrics_mux);
+  memset(g_metrics, 0, sizeof(g_metrics));
+  portEXIT_CRITICAL(&g_metrics_mux);
+}
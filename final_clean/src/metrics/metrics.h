@@ -0,0 +1,63 @@
+#pragma once
+#include "../globals.h"
+
+// Latency histograms for the pipeline stages. Each metric keeps count, sum,
+// min, max and a fixed half-octave histogram of microseconds, so recording
+// is a few adds under a spinlock and needs no allocation. Percentiles come
+// from the histogram, interpolated within the bucket they fall in: that
+// removes the upward bias of reporting bucket edges, but a percentile can
+// still be off by up to the bucket's width, a third to a half of the value.
+
+enum class Metric : uint8_t {
+  Cycle,          // stage 1 of one frame: capture .. hand-off to the varroa side
+  Frame,          // capture start .. that frame's varroa pass and bookkeeping done
+  Capture,        // camera_capture_ei (grab + decode + resize)
+  CameraGrab,     // esp_camera_fb_get
+  Decode,         // stage 1 JPEG decode (scaled or full)
+  Resize,         // crop_and_interpolate to a model input
+  BeeInfer,       // run_classifier
+  CropExtract,    // crops_extract_from_frame
+  CropDecode,     // windowed full-resolution decode of the crops
+  VarroaInfer,    // one process_impulse on one crop
+  VarroaBatch,    // all crops of one frame
+  SdWrite,        // one writer job: encode (if any) + FAT write
+  SdLatency,      // one writer job: submit .. on the card
+  MotionGate,     // 1/8 decode + thumbnail compare
+  DecodeWait,     // a pipeline decode held up by a web render on the decoder
+  InferWait,      // one model run held up by the other stage's
+  COUNT
+};
+
+static constexpr uint32_t METRIC_BUCKETS = 64;
+
+struct MetricSummary {
+  uint32_t count;
+  uint32_t min_us;
+  uint32_t max_us;
+  uint32_t avg_us;
+  uint32_t p50_us;
+  uint32_t p95_us;
+  uint32_t p99_us;
+  uint64_t total_us;
+};
+
+const char* metric_name(Metric m);
+
+void metrics_record(Metric m, uint32_t us);
+MetricSummary metrics_summary(Metric m);
+void metrics_reset();
+
+inline uint32_t metrics_now_us() { return (uint32_t)esp_timer_get_time(); }
+
+// Records the time from construction to scope exit.
+class MetricScope {
+public:
+  explicit MetricScope(Metric m) : m_(m), t0_(metrics_now_us()) {}
+  ~MetricScope() { metrics_record(m_, metrics_now_us() - t0_); }
+  MetricScope(const MetricScope&) = delete;
+  MetricScope& operator=(const MetricScope&) = delete;
+
+private:
+  Metric m_;
+  uint32_t t0_;
+};
@@ -0,0 +1,104 @@
+#include "det_record.h"
+#include "../sd/sd_writer.h"
+#include "../sd/manifest.h"
+
+static void put(DetRecord& r, const void* p, size_t n) {
+  if ((size_t)r.len + n > sizeof(r.buf)) return;
+  memcpy(r.buf + r.len, p, n);
+  r.len += (uint32_t)n;
+}
+
+void det_record_begin(DetRecord& r, uint32_t frame, const BeeDetections& bees,
+                      uint16_t bee_w, uint16_t bee_h, uint16_t var_w, uint16_t var_h) {
+  DetHeader h = {};
+  h.magic = DET_MAGIC;
+  h.frame = frame;
+  h.bee_w = bee_w;
+  h.bee_h = bee_h;
+  h.var_w = var_w;
+  h.var_h = var_h;
+  h.crop_size = (uint16_t)CROP_SIZE;
+  h.n_bees = (uint16_t)bees.count;
+  h.n_crops = 0;
+
+  r.len = 0;
+  put(r, &h, sizeof(h));
+  for (uint32_t i = 0; i < bees.count; ++i) {
+    const DetBee b = { bees.items[i].cx, bees.items[i].cy, bees.items[i].score };
+    put(r, &b, sizeof(b));
+  }
+}
+
+void det_record_add_crop(DetRecord& r, const CropTile& t, uint32_t mites,
+                         const DetBox* boxes, uint32_t n_boxes) {
+  if (n_boxes > OVERLAY_MAX_BOXES_PER_CROP) n_boxes = OVERLAY_MAX_BOXES_PER_CROP;
+  if ((size_t)r.len + sizeof(DetCrop) + n_boxes * sizeof(DetBox) > sizeof(r.buf)) return;
+
+  DetCrop c = {};
+  c.slot = (uint16_t)t.slot;
+  c.x0 = (uint16_t)t.x0;
+  c.y0 = (uint16_t)t.y0;
+  c.mites = (uint8_t)(mites > 255 ? 255 : mites);
+  c.n_boxes = (uint8_t)n_boxes;
+  c.score = t.score;
+  memcpy(c.label, t.label, sizeof(c.label));
+  put(r, &c, sizeof(c));
+  put(r, boxes, n_boxes * sizeof(DetBox));
+
+  DetHeader h;
+  memcpy(&h, r.buf, sizeof(h));
+  h.n_crops++;
+  memcpy(r.buf, &h, sizeof(h));
+}
+
+bool det_record_submit(const DetRecord& r) {
+  if (!sd_writes_enabled() || r.len < sizeof(DetHeader)) return false;
+
+  DetHeader h;
+  memcpy(&h, r.buf, sizeof(h));
+  char path[128];
+  snprintf(path, sizeof(path), "%s/%06lu.det", g_frames_dir, (unsigned long)h.frame);
+  // High: the manifest entries added below point at this file
+  if (!sd_writer_submit_bytes(path, r.buf, r.len, SdPriority::High, "det_record")) return false;
+
+  manifest_add_record(r);
+  return true;
+}
+
+// ---- reading records back ----
+
+bool det_record_check(const uint8_t* buf, size_t n, DetHeader& h) {
+  if (n < sizeof(h)) return false;
+  memcpy(&h, buf, sizeof(h));
+  return h.magic == DET_MAGIC &&
+         sizeof(h) + (size_t)h.n_bees * sizeof(DetBee) <= n;
+}
+
+DetCropCursor det_record_crops(const uint8_t* buf, size_t n, const DetHeader& h) {
+  return { buf + sizeof(DetHeader) + (size_t)h.n_bees * sizeof(DetBee), buf + n, h.n_crops };
+}
+
+bool det_record_next_crop(DetCropCursor& cur, DetCrop& c, const uint8_t** boxes) {
+  if (!cur.left || (size_t)(cur.end - cur.p) < sizeof(DetCrop)) return false;
+  memcpy(&c, cur.p, sizeof(c));
+  const size_t nb = (size_t)c.n_boxes * sizeof(DetBox);
+  if ((size_t)(cur.end - cur.p) < sizeof(DetCrop) + nb) return false;
+  *boxes = cur.p + sizeof(DetCrop);
+  cur.p += sizeof(DetCrop) + nb;
+  cur.left--;
+  return true;
+}
+
+bool det_crop_name(uint32_t frame, const DetCrop& c, bool mite, char* out, size_t out_sz) {
+  CropTile t = {};
+  t.frame = frame;
+  t.slot = c.slot;
+  t.score = c.score;
+  memcpy(t.label, c.label, sizeof(t.label));
+  t.label[sizeof(t.label) - 1] = 0;
+
+  char base[48];
+  crop_tile_basename(t, base, sizeof(base));
+  const int n = snprintf(out, out_sz, mite ? "%s_overlay.jpg" : "%s.jpg", base);
+  return n > 0 && (size_t)n < out_sz;
+}
@@ -0,0 +1,85 @@
+#pragma once
+#include "../globals.h"
+#include "../crops/crop_queue.h"
+
+// Detection records: what each frame's stages found. Overlays are drawn
+// from them on demand, and the manifest lists what each one can produce.
+//
+// /frames/boot_N/NNNNNN.det, written once per frame by the varroa side:
+// DetHeader, n_bees DetBee, then per crop a DetCrop followed by its n_boxes
+// DetBox. Bee centres are in bee-model input coordinates (bee_w x bee_h),
+// mite boxes in varroa input coordinates (var_w x var_h), crop corners in
+// the full-resolution frame.
+static constexpr uint32_t DET_MAGIC = 0x31544544u;   // "DET1"
+
+struct __attribute__((packed)) DetHeader {
+  uint32_t magic;
+  uint32_t frame;
+  uint16_t bee_w;
+  uint16_t bee_h;
+  uint16_t var_w;
+  uint16_t var_h;
+  uint16_t crop_size;
+  uint16_t n_bees;
+  uint16_t n_crops;
+};
+
+struct __attribute__((packed)) DetBee {
+  float cx;
+  float cy;
+  float score;
+};
+
+struct __attribute__((packed)) DetCrop {
+  uint16_t slot;
+  uint16_t x0;
+  uint16_t y0;
+  uint8_t mites;     // as counted by the varroa stage
+  uint8_t n_boxes;   // boxes over VAR_THRESH that follow
+  float score;
+  char label[12];
+};
+
+struct __attribute__((packed)) DetBox {
+  uint16_t x;
+  uint16_t y;
+  uint16_t w;
+  uint16_t h;
+  float score;
+};
+
+static constexpr size_t DET_RECORD_MAX_BYTES =
+  sizeof(DetHeader) +
+  (size_t)MAX_CROPS * (sizeof(DetBee) + sizeof(DetCrop) + OVERLAY_MAX_BOXES_PER_CROP * sizeof(DetBox));
+
+struct DetRecord {
+  uint32_t len;
+  uint8_t buf[DET_RECORD_MAX_BYTES];
+};
+
+void det_record_begin(DetRecord& r, uint32_t frame, const BeeDetections& bees,
+                      uint16_t bee_w, uint16_t bee_h, uint16_t var_w, uint16_t var_h);
+void det_record_add_crop(DetRecord& r, const CropTile& t, uint32_t mites,
+                         const DetBox* boxes, uint32_t n_boxes);
+// Queues the record for the card and adds its overlays to the manifest.
+bool det_record_submit(const DetRecord& r);
+
+// ---- reading records back ----
+
+// False when buf is too short for its header and bee list, or not a record.
+bool det_record_check(const uint8_t* buf, size_t n, DetHeader& h);
+
+// Steps through the crop entries; next is false at the end or on a short
+// record.
+struct DetCropCursor {
+  const uint8_t* p;
+  const uint8_t* end;
+  uint32_t left;
+};
+DetCropCursor det_record_crops(const uint8_t* buf, size_t n, const DetHeader& h);
+bool det_record_next_crop(DetCropCursor& cur, DetCrop& c, const uint8_t** boxes);
+
+// The name a crop's overlay is listed under: <crop>_overlay.jpg for mite
+// views, <crop>.jpg otherwise. False when it does not fit out; such a crop
+// is left out of listings.
+bool det_crop_name(uint32_t frame, const DetCrop& c, bool mite, char* out, size_t out_sz);
@@ -0,0 +1,392 @@
+#include "overlay.h"
+#include "../sd/sd_writer.h"
+#include "../sd/sd_pack.h"
+#include "../log/evlog.h"
+#include "../camera/jpeg_decode.h"
+#include "../sched/scheduler.h"
+#include "../util.h"
+#include "edge-impulse-sdk/dsp/image/image.hpp"
+#include "img_converters.h"
+
+// ---- listing ----
+
+static bool valid_boot(const char* boot) {
+  return boot && !strncmp(boot, "boot_", 5) && !strchr(boot, '/') && !strstr(boot, "..");
+}
+
+static uint8_t* load_file(const char* path, size_t cap, size_t* len) {
+  File f = SD_MMC.open(path, FILE_READ);
+  if (!f || f.isDirectory()) { if (f) f.close(); return nullptr; }
+
+  const size_t n = cap ? cap : f.size();
+  uint8_t* buf = n ? (uint8_t*)ps_malloc(n) : nullptr;
+  if (!buf) buf = n ? (uint8_t*)malloc(n) : nullptr;
+  *len = buf ? f.read(buf, n) : 0;
+  f.close();
+  if (buf && (!*len || (!cap && *len != n))) { free(buf); buf = nullptr; }
+  return buf;
+}
+
+// The running boot's overlays are cached in its pack rather than as files.
+static uint8_t* load_packed(const char* path, size_t* len) {
+  char boot[16], name[sizeof(PackEntry::name)];
+  PackEntry e;
+  if (!sd_pack_split_path(path, boot, sizeof(boot), name, sizeof(name)) ||
+      !sd_pack_find(boot, name, nullptr, e)) return nullptr;
+
+  File f = sd_pack_open_read(boot);
+  uint8_t* buf = (f && f.seek(e.off)) ? (uint8_t*)ps_malloc(e.len) : nullptr;
+  if (buf && f.read(buf, e.len) != e.len) { free(buf); buf = nullptr; }
+  if (f) f.close();
+  *len = buf ? e.len : 0;
+  return buf;
+}
+
+bool overlay_list(const char* base, const char* boot, const char* sub, OverlayListFn fn, void* arg) {
+  if (!base || !valid_boot(boot) || !fn) return false;
+
+  char dir_path[64];
+  snprintf(dir_path, sizeof(dir_path), "/frames/%s", boot);
+  if (!SD_MMC.exists(dir_path)) return false;
+
+  File dir = SD_MMC.open(dir_path);
+  if (!dir || !dir.isDirectory()) { if (dir) dir.close(); return false; }
+
+  const bool bee = !strcmp(base, "/bee_overlays");
+  const bool want_mite = !sub || strcmp(sub, "no_mite") != 0;
+  uint8_t* rec = bee ? nullptr : (uint8_t*)ps_malloc(DET_RECORD_MAX_BYTES);
+  if (!bee && !rec) { dir.close(); return false; }
+
+  char name[80], path[192];
+  while (true) {
+    File e = dir.openNextFile();
+    if (!e) break;
+
+    const char* nm = e.name();
+    const char* bn = nm ? strrchr(nm, '/') : nullptr;
+    bn = bn ? (bn + 1) : (nm ? nm : "");
+    const char* dot = strrchr(bn, '.');
+
+    if (!e.isDirectory() && dot && !strcmp(dot, ".det")) {
+      const unsigned long frame = strtoul(bn, nullptr, 10);
+      if (bee) {
+        snprintf(name, sizeof(name), "%06lu.jpg", frame);
+        snprintf(path, sizeof(path), "%s/%s/%s", base, boot, name);
+        fn(name, path, arg);
+      } else {
+        const size_t n = e.read(rec, DET_RECORD_MAX_BYTES);
+        DetHeader h;
+        if (det_record_check(rec, n, h)) {
+          DetCropCursor cur = det_record_crops(rec, n, h);
+          DetCrop c;
+          const uint8_t* boxes;
+          while (det_record_next_crop(cur, c, &boxes)) {
+            if ((c.mites > 0) != want_mite) continue;
+            if (!det_crop_name(h.frame, c, want_mite, name, sizeof(name))) continue;
+            snprintf(path, sizeof(path), "%s/%s/%s/%s", base, boot,
+                     want_mite ? OVERLAY_MITE_SUBDIR : OVERLAY_NO_MITE_SUBDIR, name);
+            fn(name, path, arg);
+          }
+        }
+      }
+    }
+
+    e.close();
+    delay(0);
+  }
+
+  free(rec);
+  dir.close();
+  return true;
+}
+
+// ---- drawing ----
+// The marks the stages used to burn into every saved overlay: score-tinted
+// outlines, written in the decoder's B,G,R order like the pixels under them.
+
+static inline void put_px(uint8_t* img, int W, int H, int x, int y, uint8_t r, uint8_t g, uint8_t b) {
+  if ((unsigned)x < (unsigned)W && (unsigned)y < (unsigned)H) {
+    size_t i = ((size_t)y * (size_t)W + (size_t)x) * 3;
+    img[i + 0] = b; img[i + 1] = g; img[i + 2] = r;
+  }
+}
+
+static inline int clamp_i(int v, int lo, int hi) { return v < lo ? lo : (v > hi ? hi : v); }
+
+static void draw_rect(uint8_t* img, int W, int H, int x0, int y0, int x1, int y1, float score) {
+  const uint8_t r = (uint8_t)(score * 255);
+  const uint8_t g = 0;
+  const uint8_t b = (uint8_t)((1.0f - score) * 255);
+  for (int x = x0; x <= x1; x++) { put_px(img, W, H, x, y0, r, g, b); put_px(img, W, H, x, y1, r, g, b); }
+  for (int y = y0; y <= y1; y++) { put_px(img, W, H, x0, y, r, g, b); put_px(img, W, H, x1, y, r, g, b); }
+}
+
+// 4x4 marker on a bee centre.
+static void mark_bee(uint8_t* img, int W, int H, float fx, float fy, float score) {
+  static constexpr int kBoxSize = 4;
+  static constexpr int kHalf    = kBoxSize / 2;
+
+  const int cx = (int)lrintf(fx);
+  const int cy = (int)lrintf(fy);
+  const int x0 = clamp_i(cx - kHalf, 0, W - 1);
+  const int y0 = clamp_i(cy - kHalf, 0, H - 1);
+  draw_rect(img, W, H, x0, y0, clamp_i(x0 + (kBoxSize - 1), 0, W - 1),
+            clamp_i(y0 + (kBoxSize - 1), 0, H - 1), score);
+}
+
+static void draw_bee_centres(uint8_t* img, int W, int H, const uint8_t* bees, uint32_t n) {
+  for (uint32_t k = 0; k < n; ++k) {
+    DetBee d;
+    memcpy(&d, bees + k * sizeof(DetBee), sizeof(d));
+    mark_bee(img, W, H, d.cx, d.cy, d.score);
+  }
+}
+
+void overlay_draw_bees(uint8_t* img, int W, int H, const BeeDetections& dets) {
+  for (uint32_t k = 0; k < dets.count; ++k)
+    mark_bee(img, W, H, dets.items[k].cx, dets.items[k].cy, dets.items[k].score);
+}
+
+static void draw_mite_boxes(uint8_t* img, int W, int H, const uint8_t* boxes, uint32_t n) {
+  for (uint32_t k = 0; k < n; ++k) {
+    DetBox bb;
+    memcpy(&bb, boxes + k * sizeof(DetBox), sizeof(bb));
+
+    const float cx = bb.x + bb.w * 0.5f;
+    const float cy = bb.y + bb.h * 0.5f;
+    draw_rect(img, W, H,
+              clamp_i((int)lrintf(cx - bb.w * 0.5f), 0, W - 1),
+              clamp_i((int)lrintf(cy - bb.h * 0.5f), 0, H - 1),
+              clamp_i((int)lrintf(cx + bb.w * 0.5f), 0, W - 1),
+              clamp_i((int)lrintf(cy + bb.h * 0.5f), 0, H - 1), bb.score);
+  }
+}
+
+// Renders run on the web task and yield to the pipeline: while inference
+// runs no decode starts close to the next cycle, and the decoder is never
+// waited for.
+static bool render_decoder_lock() {
+  if (g_infer_enabled && sched_wait_ms(millis()) < OVERLAY_RENDER_MIN_GAP_MS) return false;
+  return jpeg_decoder_try_lock();
+}
+
+// Decoder-order pixels go to the encoder as they lie (see sd_write_jpg).
+static bool encode_bgr(uint8_t* px, int W, int H, int quality, uint8_t** jpg, size_t* len) {
+  const size_t pixels = (size_t)W * (size_t)H;
+  *jpg = nullptr;
+  *len = 0;
+  const bool ok = fmt2jpg(px, pixels * 3u, (uint16_t)W, (uint16_t)H, PIXFORMAT_RGB888,
+                          (uint8_t)quality, jpg, len);
+  if (!ok || !*jpg || !*len) { free(*jpg); *jpg = nullptr; return false; }
+  return true;
+}
+
+// Rebuilds the stage 1 input the way CAPTURE_SCALED_DECODE produces it.
+// (With full decodes the on-device input differs by resampling noise only.)
+static OverlayResult render_bee(const DetHeader& h, const uint8_t* rec, const uint8_t* frame, size_t flen,
+                                uint8_t** jpg, size_t* len) {
+  int fw = 0, fh = 0;
+  if (!jpeg_get_dims_v(frame, flen, fw, fh)) return OverlayResult::NotFound;
+
+  const jpg_scale_t s = jpeg_pick_scale((uint16_t)fw, (uint16_t)fh, h.bee_w, h.bee_h);
+  const size_t scaled_bytes = (size_t)jpeg_scaled_dim((uint16_t)fw, s) * jpeg_scaled_dim((uint16_t)fh, s) * 3;
+  const size_t bee_bytes = (size_t)h.bee_w * h.bee_h * 3;
+
+  uint8_t* scaled = (uint8_t*)ps_malloc(scaled_bytes);
+  uint8_t* img = (uint8_t*)ps_malloc(bee_bytes);
+  uint16_t sw = 0, sh = 0;
+  if (scaled && img && !render_decoder_lock()) {
+    free(scaled);
+    free(img);
+    return OverlayResult::Busy;
+  }
+  bool ok = scaled && img && jpeg_decode_scaled(frame, flen, s, scaled, scaled_bytes, &sw, &sh, JpegLock::Held);
+  if (scaled && img) jpeg_decoder_unlock();
+
+  if (ok) {
+    if (sw != h.bee_w || sh != h.bee_h) {
+      ei::image::processing::crop_and_interpolate_rgb888(scaled, sw, sh, img, h.bee_w, h.bee_h);
+    } else {
+      memcpy(img, scaled, bee_bytes);
+    }
+    free(scaled);
+    scaled = nullptr;
+
+    draw_bee_centres(img, h.bee_w, h.bee_h, rec + sizeof(DetHeader), h.n_bees);
+    ok = encode_bgr(img, h.bee_w, h.bee_h, JPEG_QUALITY, jpg, len);
+  }
+
+  free(scaled);
+  free(img);
+  return ok ? OverlayResult::Ok : OverlayResult::NotFound;
+}
+
+// Crop window at full resolution; mite views are drawn at varroa input size
+// like the stage saw them, no-mite views are the raw crop.
+static OverlayResult render_crop(const DetHeader& h, const DetCrop& c, const uint8_t* boxes, bool mite,
+                                 const uint8_t* frame, size_t flen, uint8_t** jpg, size_t* len) {
+  const uint16_t cs = h.crop_size;
+  uint8_t* tile = (uint8_t*)ps_malloc((size_t)cs * cs * 3);
+  if (!tile) return OverlayResult::NotFound;
+
+  if (!render_decoder_lock()) { free(tile); return OverlayResult::Busy; }
+  const JpegWindow win = { c.x0, c.y0, cs, cs, tile };
+  const bool decoded = jpeg_decode_windows(frame, flen, &win, 1, JpegLock::Held);
+  jpeg_decoder_unlock();
+  if (!decoded) { free(tile); return OverlayResult::NotFound; }
+
+  if (!mite) {
+    const bool ok = encode_bgr(tile, cs, cs, JPEG_QUALITY, jpg, len);
+    free(tile);
+    return ok ? OverlayResult::Ok : OverlayResult::NotFound;
+  }
+
+  uint8_t* img = tile;
+  if (cs != h.var_w || cs != h.var_h) {
+    img = (uint8_t*)ps_malloc((size_t)h.var_w * h.var_h * 3);
+    if (!img) { free(tile); return OverlayResult::NotFound; }
+    ei::image::processing::crop_and_interpolate_rgb888(tile, cs, cs, img, h.var_w, h.var_h);
+    free(tile);
+    tile = nullptr;
+  }
+
+  draw_mite_boxes(img, h.var_w, h.var_h, boxes, c.n_boxes);
+  const bool ok = encode_bgr(img, h.var_w, h.var_h, JPEG_QUALITY, jpg, len);
+  free(img);
+  return ok ? OverlayResult::Ok : OverlayResult::NotFound;
+}
+
+// The running boot's caches go into its pack through the writer; older
+// boots' packs are sealed, so theirs stay plain files.
+static void cache_overlay(const char* path, const uint8_t* jpg, size_t len) {
+  if (!g_sd_ok) return;
+  char boot[16], name[sizeof(PackEntry::name)];
+  const char* cur = strrchr(g_frames_dir, '/');
+  if (cur && sd_pack_split_path(path, boot, sizeof(boot), name, sizeof(name)) && !strcmp(boot, cur + 1)) {
+    const char* base = strrchr(path, '/') + 1;   // names start with the frame number
+    (void)sd_writer_submit_packed(path, (uint32_t)strtoul(base, nullptr, 10), jpg, len,
+                                  SdPriority::Low, "overlay_cache");
+    return;
+  }
+
+  char dir[192];
+  snprintf(dir, sizeof(dir), "%.*s", (int)(strrchr(path, '/') - path), path);
+  if (!SD_MMC.exists(dir)) SD_MMC.mkdir(dir);   // thumbs/
+  File f = SD_MMC.open(path, FILE_WRITE);
+  if (!f) return;
+  const size_t w = f.write(jpg, len);
+  f.close();
+  if (w != len) SD_MMC.remove(path);
+}
+
+OverlayResult overlay_render(const char* path, uint8_t** jpg, size_t* len) {
+  if (!path || !jpg || !len) return OverlayResult::NotFound;
+
+  char boot[32], sub[16], tail[16];
+  unsigned long frame = 0, slot = 0;
+  bool bee = false, mite = false;
+
+  if (sscanf(path, "/bee_overlays/%31[^/]/%lu%15s", boot, &frame, tail) == 3) {
+    bee = true;
+  } else if (sscanf(path, "/overlays/%31[^/]/%15[^/]/%lu_%lu_", boot, sub, &frame, &slot) == 4) {
+    if (!strcmp(sub, OVERLAY_MITE_SUBDIR)) mite = true;
+    else if (strcmp(sub, OVERLAY_NO_MITE_SUBDIR) != 0) return OverlayResult::NotFound;
+  } else {
+    return OverlayResult::NotFound;
+  }
+  if (!valid_boot(boot)) return OverlayResult::NotFound;
+
+  const uint32_t t0 = millis();
+  char src[96];
+  size_t rec_len = 0, frame_len = 0;
+
+  snprintf(src, sizeof(src), "/frames/%s/%06lu.det", boot, frame);
+  uint8_t* rec = load_file(src, DET_RECORD_MAX_BYTES, &rec_len);
+  DetHeader h;
+  if (!rec || !det_record_check(rec, rec_len, h)) { free(rec); return OverlayResult::NotFound; }
+
+  // only the exact names the listing hands out
+  char want[192];
+  DetCrop c = {};
+  const uint8_t* boxes = nullptr;
+  if (bee) {
+    snprintf(want, sizeof(want), "/bee_overlays/%s/%06lu.jpg", boot, frame);
+  } else {
+    DetCropCursor cur = det_record_crops(rec, rec_len, h);
+    bool found = false;
+    while (!found && det_record_next_crop(cur, c, &boxes)) found = (c.slot == slot);
+    want[0] = 0;
+    if (found && (c.mites > 0) == mite) {
+      char name[80];
+      if (det_crop_name(h.frame, c, mite, name, sizeof(name)))
+        snprintf(want, sizeof(want), "/overlays/%s/%s/%s", boot, sub, name);
+    }
+  }
+  if (strcmp(want, path) != 0) { free(rec); return OverlayResult::NotFound; }
+
+  snprintf(src, sizeof(src), "/frames/%s/%06lu.jpg", boot, frame);
+  uint8_t* fjpg = load_file(src, 0, &frame_len);
+  if (!fjpg) { free(rec); return OverlayResult::NotFound; }
+
+  const OverlayResult r = bee ? render_bee(h, rec, fjpg, frame_len, jpg, len)
+                               : render_crop(h, c, boxes, mite, fjpg, frame_len, jpg, len);
+  free(fjpg);
+  free(rec);
+
+  if (r == OverlayResult::NotFound) EVLOG(OVERLAY_FAIL, path);
+  if (r != OverlayResult::Ok) return r;
+
+  cache_overlay(path, *jpg, *len);
+  EVLOG(OVERLAY_RENDER, path, (unsigned long)*len, (unsigned long)(millis() - t0));
+  return OverlayResult::Ok;
+}
+
+// ---- thumbnails ----
+
+bool overlay_thumb_path(const char* path, char* out, size_t out_sz) {
+  if (!path || !out || strstr(path, "/thumbs/")) return false;
+  const char* slash = strrchr(path, '/');
+  if (!slash || !slash[1]) return false;
+  const int n = snprintf(out, out_sz, "%.*s/thumbs%s", (int)(slash - path), path, slash);
+  return n > 0 && (size_t)n < out_sz;
+}
+
+OverlayResult overlay_thumb(const char* path, uint8_t** jpg, size_t* len) {
+  if (!path || !jpg || !len) return OverlayResult::NotFound;
+
+  char tpath[192];
+  if (!overlay_thumb_path(path, tpath, sizeof(tpath))) return OverlayResult::NotFound;
+
+  const uint32_t t0 = millis();
+  size_t src_len = 0;
+  uint8_t* src = load_file(path, 0, &src_len);
+  if (!src) src = load_packed(path, &src_len);
+  if (!src) {
+    const OverlayResult r = overlay_render(path, &src, &src_len);
+    if (r != OverlayResult::Ok) return r;
+  }
+
+  uint16_t w = 0, h = 0;
+  if (!jpeg_read_size(src, src_len, &w, &h) || !w || !h) { free(src); EVLOG(OVERLAY_FAIL, path); return OverlayResult::NotFound; }
+
+  const jpg_scale_t s = jpeg_pick_scale(w, h, THUMB_MIN_DIM, THUMB_MIN_DIM);
+  const uint32_t round = (1u << (int)s) - 1u;   // some decoders round the scaled size up
+  const size_t cap = (size_t)((w + round) >> (int)s) * (size_t)((h + round) >> (int)s) * 3u;
+  uint8_t* px = (uint8_t*)ps_malloc(cap);
+  if (!px) px = (uint8_t*)malloc(cap);
+
+  if (px && !render_decoder_lock()) { free(px); free(src); return OverlayResult::Busy; }
+
+  uint16_t tw = 0, th = 0;
+  bool ok = px && jpeg_decode_scaled(src, src_len, s, px, cap, &tw, &th, JpegLock::Held);
+  if (px) jpeg_decoder_unlock();
+  free(src);
+  ok = ok && encode_bgr(px, tw, th, THUMB_QUALITY, jpg, len);
+  free(px);
+
+  if (!ok) { EVLOG(OVERLAY_FAIL, path); return OverlayResult::NotFound; }
+
+  cache_overlay(tpath, *jpg, *len);
+  EVLOG(THUMB_RENDER, tpath, (unsigned)tw, (unsigned)th, (unsigned long)*len, (unsigned long)(millis() - t0));
+  return OverlayResult::Ok;
+}
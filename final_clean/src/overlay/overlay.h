@@ -0,0 +1,37 @@
+#pragma once
+#include "../globals.h"
+#include "det_record.h"
+
+// Marks each bee centre on a B,G,R image of the bee input size, the way
+// the bee overlay draws them.
+void overlay_draw_bees(uint8_t* img, int W, int H, const BeeDetections& dets);
+
+// ---- on-demand overlays ----
+// Overlay paths keep their old names:
+//   /bee_overlays/boot_N/NNNNNN.jpg                 stage 1 input + bee centres
+//   /overlays/boot_N/mite/<crop>_overlay.jpg        crop + mite boxes
+//   /overlays/boot_N/no_mite/<crop>.jpg             crop as classified
+// but are only produced (and then cached at that path) on first request.
+
+typedef void (*OverlayListFn)(const char* name, const char* path, void* arg);
+
+// Busy: the pipeline has the decoder or is about to need it; ask again later.
+enum class OverlayResult : uint8_t { Ok, NotFound, Busy };
+
+// Lists the overlays a boot's records can produce; false when the boot has
+// no records (sessions from before lazy overlays), so the caller lists files.
+bool overlay_list(const char* base, const char* boot, const char* sub, OverlayListFn fn, void* arg);
+
+// Draws the overlay for path into a malloc'd JPEG (caller frees) and caches
+// it on the card. NotFound when path is not an overlay or its sources are
+// gone.
+OverlayResult overlay_render(const char* path, uint8_t** jpg, size_t* len);
+
+// Thumbnails live next to what they show: <dir>/thumbs/<name>. False when
+// path is itself a thumbnail or does not fit out.
+bool overlay_thumb_path(const char* path, char* out, size_t out_sz);
+
+// Shrinks the image at path (drawing the overlay first when it is not on
+// the card yet) into a malloc'd JPEG (caller frees) and caches it at its
+// thumbnail path.
+OverlayResult overlay_thumb(const char* path, uint8_t** jpg, size_t* len);
@@ -0,0 +1,104 @@
+#include "scheduler.h"
+#include "../log/evlog.h"
+
+static portMUX_TYPE g_sched_mux = portMUX_INITIALIZER_UNLOCKED;
+static SchedState g_state = { SchedMode::Fixed, 0, 0.0f, 0.0f };
+static bool g_started = false;
+static bool g_running = false;
+static uint32_t g_last_start = 0;
+static float g_busy_ms = 0.0f;       // smoothed cycle time
+static float g_interval_ms = 0.0f;   // smoothed start-to-start time
+
+static constexpr float SCHED_SMOOTH = 0.125f;
+
+static inline float smooth(float avg, float v) {
+  return avg > 0.0f ? avg + (v - avg) * SCHED_SMOOTH : v;
+}
+
+bool sched_due(uint32_t now_ms) {
+  portENTER_CRITICAL(&g_sched_mux);
+  const bool due = !g_started || now_ms - g_last_start >= g_state.period_ms;
+  portEXIT_CRITICAL(&g_sched_mux);
+  return due;
+}
+
+uint32_t sched_wait_ms(uint32_t now_ms) {
+  portENTER_CRITICAL(&g_sched_mux);
+  const uint32_t el = now_ms - g_last_start;
+  const uint32_t wait = (g_running || !g_started || el >= g_state.period_ms) ? 0 : g_state.period_ms - el;
+  portEXIT_CRITICAL(&g_sched_mux);
+  return wait;
+}
+
+void sched_cycle_start() {
+  portENTER_CRITICAL(&g_sched_mux);
+  g_running = true;
+  portEXIT_CRITICAL(&g_sched_mux);
+}
+
+static uint32_t clamp_period(uint32_t p) {
+  if (p < SCHED_MIN_PERIOD_MS) p = SCHED_MIN_PERIOD_MS;
+  if (p > SCHED_MAX_PERIOD_MS) p = SCHED_MAX_PERIOD_MS;
+  return p;
+}
+
+void sched_cycle_done(uint32_t bees, bool gated, uint32_t start_ms, uint32_t end_ms) {
+  portENTER_CRITICAL(&g_sched_mux);
+  if (g_started) g_interval_ms = smooth(g_interval_ms, (float)(start_ms - g_last_start));
+  g_busy_ms = smooth(g_busy_ms, (float)(end_ms - start_ms));
+  g_started = true;
+  g_running = false;
+  g_last_start = start_ms;
+
+  const SchedMode prev = g_state.mode;
+  uint32_t period;
+  if (!g_sched_adaptive) {
+    g_state.mode = SchedMode::Fixed;
+    period = INFER_PERIOD_MS;
+  } else {
+    if (gated) {
+      // nothing ran, so nothing learned: hold, but never look less often
+      // than the base tick
+      period = g_state.period_ms < INFER_PERIOD_MS ? g_state.period_ms : INFER_PERIOD_MS;
+    } else if (bees >= SCHED_BUSY_BEES) {
+      g_state.mode = SchedMode::Busy;
+      period = SCHED_MIN_PERIOD_MS;
+    } else if (bees > 0) {
+      g_state.mode = SchedMode::Active;
+      period = INFER_PERIOD_MS;
+    } else {
+      g_state.mode = SchedMode::Idle;
+      period = (prev == SchedMode::Idle && g_state.period_ms) ? g_state.period_ms * 2u : INFER_PERIOD_MS;
+    }
+
+    // duty budget: busy / period <= SCHED_MAX_DUTY
+    const uint32_t floor_ms = (uint32_t)(g_busy_ms / SCHED_MAX_DUTY);
+    if (period < floor_ms) period = floor_ms;
+    period = clamp_period(period);
+  }
+  g_state.period_ms = period;
+  g_state.fps = g_interval_ms > 0.0f ? 1000.0f / g_interval_ms : 0.0f;
+  g_state.duty = g_interval_ms > 0.0f ? g_busy_ms / g_interval_ms : 0.0f;
+  if (g_state.duty > 1.0f) g_state.duty = 1.0f;
+  const SchedState s = g_state;
+  portEXIT_CRITICAL(&g_sched_mux);
+
+  if (s.mode != prev) EVLOG(SCHED_MODE, sched_mode_name(s.mode), (unsigned long)bees, (unsigned long)s.period_ms);
+}
+
+SchedState sched_state() {
+  portENTER_CRITICAL(&g_sched_mux);
+  const SchedState s = g_state;
+  portEXIT_CRITICAL(&g_sched_mux);
+  return s;
+}
+
+const char* sched_mode_name(SchedMode m) {
+  switch (m) {
+    case SchedMode::Fixed:  return "fixed";
+    case SchedMode::Busy:   return "busy";
+    case SchedMode::Active: return "active";
+    case SchedMode::Idle:   return "idle";
+  }
+  return "?";
+}
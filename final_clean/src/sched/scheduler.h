@@ -0,0 +1,32 @@
+#pragma once
+#include "../globals.h"
+
+// Decides when loop() starts the next cycle. With g_sched_adaptive off it
+// is the old fixed INFER_PERIOD_MS tick. With it on, the period follows the
+// bee centres the last cycle saw:
+//   Busy    >= SCHED_BUSY_BEES     SCHED_MIN_PERIOD_MS (back to back at 0)
+//   Active  some bees              INFER_PERIOD_MS
+//   Idle    none                   doubles per empty cycle up to SCHED_MAX_PERIOD_MS
+// and never drops below what keeps the loop inside SCHED_MAX_DUTY. A frame
+// the motion gate dropped says nothing about the bees: it keeps the mode
+// and period, at most INFER_PERIOD_MS, so the cheap gate keeps watching.
+
+enum class SchedMode : uint8_t { Fixed, Busy, Active, Idle };
+
+struct SchedState {
+  SchedMode mode;
+  uint32_t period_ms;   // start-to-start gap before the next cycle
+  float fps;            // measured cycle rate (smoothed)
+  float duty;           // share of wall time spent inside cycles (smoothed)
+};
+
+bool sched_due(uint32_t now_ms);
+// How long before sched_due() turns true; 0 when it already is or a cycle
+// is running.
+uint32_t sched_wait_ms(uint32_t now_ms);
+// loop() brackets every cycle with these.
+void sched_cycle_start();
+void sched_cycle_done(uint32_t bees, bool gated, uint32_t start_ms, uint32_t end_ms);
+
+SchedState sched_state();
+const char* sched_mode_name(SchedMode m);
@@ -0,0 +1,154 @@
+#include "manifest.h"
+#include "sd_writer.h"
+#include "../overlay/det_record.h"
+#include "../ui/sse.h"
+
+static const char* const LIST_FILES[] = { "bee.idx", "mite.idx", "no_mite.idx" };
+static_assert(sizeof(LIST_FILES) / sizeof(LIST_FILES[0]) == (size_t)ManifestList::COUNT,
+              "one file per list");
+
+const char* manifest_list_file(ManifestList l) {
+  return (size_t)l < (size_t)ManifestList::COUNT ? LIST_FILES[(size_t)l] : "?";
+}
+
+// current boot: entries handed to the writer, newest MANIFEST_TAIL in RAM
+struct ManifestTail {
+  uint32_t count;
+  ManifestEntry ring[MANIFEST_TAIL];
+};
+
+static ManifestTail g_tail[(size_t)ManifestList::COUNT];
+static portMUX_TYPE g_tail_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static void list_path(const char* frames_dir, ManifestList l, char* out, size_t out_sz) {
+  snprintf(out, out_sz, "%s/%s", frames_dir, manifest_list_file(l));
+}
+
+bool manifest_append(ManifestList l, const ManifestEntry* e, uint32_t n) {
+  if ((size_t)l >= (size_t)ManifestList::COUNT || !e || !n) return true;
+
+  char path[96];
+  list_path(g_frames_dir, l, path, sizeof(path));
+  // High: the RAM tail below already lists the entry, so the file must get it
+  if (!sd_writer_submit_append(path, (const uint8_t*)e, (size_t)n * sizeof(ManifestEntry),
+                               SdPriority::High, "manifest")) return false;
+
+  ManifestTail& t = g_tail[(size_t)l];
+  portENTER_CRITICAL(&g_tail_mux);
+  for (uint32_t i = 0; i < n; ++i) t.ring[(t.count + i) % MANIFEST_TAIL] = e[i];
+  t.count += n;
+  portEXIT_CRITICAL(&g_tail_mux);
+  return true;
+}
+
+void manifest_add_record(const DetRecord& r) {
+  DetHeader h;
+  if (!det_record_check(r.buf, r.len, h)) return;
+  static ManifestEntry mite[MAX_CROPS], no_mite[MAX_CROPS];   // varroa side only
+  uint32_t n_mite = 0, n_no_mite = 0;
+
+  DetCropCursor cur = det_record_crops(r.buf, r.len, h);
+  DetCrop c;
+  const uint8_t* boxes;
+  while (det_record_next_crop(cur, c, &boxes)) {
+    const bool m = c.mites > 0;
+    ManifestEntry& e = m ? mite[n_mite] : no_mite[n_no_mite];
+    memset(&e, 0, sizeof(e));
+    e.frame = h.frame;
+    if (!det_crop_name(h.frame, c, m, e.name, sizeof(e.name))) continue;
+    ++(m ? n_mite : n_no_mite);
+    if (n_mite == MAX_CROPS || n_no_mite == MAX_CROPS) break;
+  }
+
+  ManifestEntry bee = {};
+  bee.frame = h.frame;
+  snprintf(bee.name, sizeof(bee.name), "%06lu.jpg", (unsigned long)h.frame);
+  if (manifest_append(ManifestList::Bee, &bee, 1)) sse_publish_images(ManifestList::Bee, &bee, 1);
+  if (manifest_append(ManifestList::Mite, mite, n_mite)) sse_publish_images(ManifestList::Mite, mite, n_mite);
+  if (manifest_append(ManifestList::NoMite, no_mite, n_no_mite)) sse_publish_images(ManifestList::NoMite, no_mite, n_no_mite);
+}
+
+// One list of one boot, read through the RAM tail where it covers the range.
+struct ListReader {
+  File f;
+  const ManifestTail* tail;   // current boot only
+  uint32_t count;
+};
+
+static bool reader_open(ListReader& r, const char* boot, ManifestList l) {
+  char dir[64], path[96];
+  snprintf(dir, sizeof(dir), "/frames/%s", boot);
+  list_path(dir, l, path, sizeof(path));
+
+  r.tail = nullptr;
+  r.count = 0;
+  if (!strcmp(dir, g_frames_dir)) {
+    r.tail = &g_tail[(size_t)l];
+    portENTER_CRITICAL(&g_tail_mux);
+    r.count = r.tail->count;
+    portEXIT_CRITICAL(&g_tail_mux);
+  }
+
+  r.f = SD_MMC.open(path, FILE_READ);
+  if (r.f && !r.tail) r.count = (uint32_t)(r.f.size() / sizeof(ManifestEntry));
+  return r.f || (r.tail && r.count);
+}
+
+// Reads entries [i, i + n); returns how many it got.
+static uint32_t reader_get(ListReader& r, uint32_t i, ManifestEntry* out, uint32_t n) {
+  if (i >= r.count) return 0;
+  if (n > r.count - i) n = r.count - i;
+
+  uint32_t got = 0;
+  if (r.tail) {
+    portENTER_CRITICAL(&g_tail_mux);
+    const uint32_t count = r.tail->count;
+    const uint32_t first_cached = count > MANIFEST_TAIL ? count - MANIFEST_TAIL : 0;
+    if (i >= first_cached) {
+      for (; got < n; ++got) out[got] = r.tail->ring[(i + got) % MANIFEST_TAIL];
+    }
+    portEXIT_CRITICAL(&g_tail_mux);
+    if (got) return got;
+  }
+
+  if (!r.f || !r.f.seek(i * sizeof(ManifestEntry))) return 0;
+  return (uint32_t)(r.f.read((uint8_t*)out, (size_t)n * sizeof(ManifestEntry)) / sizeof(ManifestEntry));
+}
+
+// First index whose frame > since; entries are in frame order.
+static uint32_t reader_after(ListReader& r, uint32_t since) {
+  uint32_t lo = 0, hi = r.count;
+  while (lo < hi) {
+    const uint32_t mid = lo + (hi - lo) / 2;
+    ManifestEntry e;
+    if (reader_get(r, mid, &e, 1) != 1) { hi = mid; break; }
+    if (e.frame <= since) lo = mid + 1;
+    else hi = mid;
+  }
+  return lo;
+}
+
+bool manifest_page(const char* boot, ManifestList l, bool has_since, uint32_t since,
+                   uint32_t offset, ManifestEntry* out, uint32_t cap, ManifestPage& page) {
+  page = {};
+  if (!boot || strncmp(boot, "boot_", 5) || strchr(boot, '/') || (size_t)l >= (size_t)ManifestList::COUNT) return false;
+
+  ListReader r;
+  if (!reader_open(r, boot, l)) return false;
+
+  const uint32_t first = has_since ? reader_after(r, since) : 0;
+  page.total = r.count - first;
+  if (offset < page.total) {
+    const uint32_t want = (page.total - offset) < cap ? (page.total - offset) : cap;
+    page.count = reader_get(r, first + offset, out, want);
+    // a read that straddles the cached tail comes back in two parts
+    while (page.count < want) {
+      const uint32_t more = reader_get(r, first + offset + page.count, out + page.count, want - page.count);
+      if (!more) break;
+      page.count += more;
+    }
+  }
+
+  if (r.f) r.f.close();
+  return true;
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include "../globals.h"
+
+// Per-boot image manifest. Every listing the web UI pages through (bee
+// overlays, mite and no-mite crops) has an append-only file of fixed-size
+// entries in frame order, /frames/boot_N/<list>.idx, extended through the
+// SD writer as each frame's detection record is stored. The current boot
+// also keeps its newest MANIFEST_TAIL entries per list in RAM, so polling
+// for new images rarely touches the card. A page is one binary search for
+// `since` plus a read of the page itself.
+
+enum class ManifestList : uint8_t { Bee, Mite, NoMite, COUNT };
+
+struct __attribute__((packed)) ManifestEntry {
+  uint32_t frame;
+  char name[44];   // file name within the listing
+};
+
+const char* manifest_list_file(ManifestList l);   // "bee.idx", ...
+
+// Appends n entries of one frame to the current boot's list.
+bool manifest_append(ManifestList l, const ManifestEntry* e, uint32_t n);
+
+struct DetRecord;
+
+// Appends the overlays a stored record can produce, in the names
+// overlay_list() gives them, and announces them to the web UI.
+void manifest_add_record(const DetRecord& r);
+
+struct ManifestPage {
+  uint32_t total;   // entries with frame > since
+  uint32_t count;   // entries written to out
+};
+
+// Entries of boot's list with frame > since (all when has_since is false),
+// skipping offset, at most cap. False when the boot has no manifest (boots
+// from before it existed), so the caller lists the directory instead.
+bool manifest_page(const char* boot, ManifestList l, bool has_since, uint32_t since,
+                   uint32_t offset, ManifestEntry* out, uint32_t cap, ManifestPage& page);
@@ -1,4 +1,7 @@
 #include "sd_core.h"
+#include "sd_writer.h"
+#include "sd_pack.h"
+#include "../log/evlog.h"
 #include "../util.h"
 #include "img_converters.h"   // fmt2jpg, fmt2rgb888
 
@@ -60,7 +63,7 @@ static uint32_t allocate_unique_boot_id() {
 
   while (true) {
     char test[128];
-    snprintf(test, sizeof(test), "%s/boot_%06lu.txt", LOG_DIR, (unsigned long)cand);
+    snprintf(test, sizeof(test), "%s/boot_%06lu.blg", LOG_DIR, (unsigned long)cand);
     if (!SD_MMC.exists(test)) break;
     cand++;
   }
@@ -69,22 +72,6 @@ static uint32_t allocate_unique_boot_id() {
   return cand;
 }
 
-void sdlog_printf(const char* fmt, ...) {
-  char buf[384];
-  va_list ap;
-  va_start(ap, fmt);
-  vsnprintf(buf, sizeof(buf), fmt, ap);
-  va_end(ap);
-
-  if (LOG_ECHO_SERIAL) Serial.print(buf);
-
-  if (!g_sd_ok || !g_save_enabled) return;
-  if (!g_log_file) return;
-
-  g_log_file.print(buf);
-  g_log_file.flush();
-}
-
 bool sd_init_mount() {
   SD_MMC.setPins(SD_CLK_PIN, SD_CMD_PIN, SD_DATA0_PIN);
   if (!SD_MMC.begin("/sdcard", true, false)) {
@@ -145,54 +132,82 @@ bool sd_copy_file(const char* src_path, const char* dst_path) {
   return true;
 }
 
-bool sd_write_jpg_rgb888(const char* out_path, const uint8_t* rgb, int W, int H, int quality) {
-  if (!sd_writes_enabled() || !out_path || !rgb || W <= 0 || H <= 0) return false;
-
-  uint8_t* jbuf = nullptr;
-  size_t jlen = 0;
+// Encodes into a malloc'd JPEG (caller frees).
+static bool encode_jpg(const uint8_t* px, int W, int H, int quality, uint8_t** jbuf, size_t* jlen) {
+  const size_t pixels = (size_t)W * (size_t)H;
+  *jbuf = nullptr;
+  *jlen = 0;
   const bool enc = fmt2jpg(
-    (uint8_t*)rgb,
-    (size_t)W * (size_t)H * 3u,
+    (uint8_t*)px,
+    pixels * 3u,
     (uint16_t)W,
     (uint16_t)H,
     PIXFORMAT_RGB888,
     (uint8_t)quality,
-    &jbuf,
-    &jlen
+    jbuf,
+    jlen
   );
-  if (!enc || !jbuf || !jlen) { if (jbuf) free(jbuf); return false; }
+  if (!enc || !*jbuf || !*jlen) { free(*jbuf); *jbuf = nullptr; return false; }
+  return true;
+}
+
+bool sd_write_jpg(const char* out_path, const uint8_t* px, int W, int H, int quality,
+                  size_t* out_len) {
+  if (!sd_writes_enabled() || !out_path || !px || W <= 0 || H <= 0) return false;
+
+  uint8_t* jbuf = nullptr;
+  size_t jlen = 0;
+  if (!encode_jpg(px, W, H, quality, &jbuf, &jlen)) return false;
 
   File f = SD_MMC.open(out_path, FILE_WRITE);
   if (!f) { free(jbuf); return false; }
   const size_t w = f.write(jbuf, jlen);
   f.flush(); f.close();
   free(jbuf);
+  if (out_len) *out_len = w;
   return (w == jlen);
 }
 
-bool sd_save_fb_jpeg(camera_fb_t* fb) {
-  if (!sd_writes_enabled() || !fb || fb->format != PIXFORMAT_JPEG) return false;
-
-  snprintf(g_last_frame_path, sizeof(g_last_frame_path),
-           "%s/%06lu.jpg", g_frames_dir, (unsigned long)g_frame_counter);
+bool sd_write_packed(const char* path, uint32_t frame, const uint8_t* data, size_t len) {
+  if (!sd_writes_enabled() || !path || !data || !len) return false;
 
-  File f = SD_MMC.open(g_last_frame_path, FILE_WRITE);
-  if (!f) { sdlog_printf("SAVE_FAIL frame_jpeg path=%s\n", g_last_frame_path); return false; }
+  char boot[16], name[sizeof(PackEntry::name)];
+  const char* cur = strrchr(g_frames_dir, '/');
+  if (cur && sd_pack_split_path(path, boot, sizeof(boot), name, sizeof(name)) &&
+      !strcmp(boot, cur + 1) &&
+      sd_pack_append(name, frame, data, len)) return true;
 
-  size_t w = f.write(fb->buf, fb->len);
+  File f = SD_MMC.open(path, FILE_WRITE);
+  if (!f) return false;
+  const size_t w = f.write(data, len);
   f.close();
+  return w == len;
+}
 
-  if (w != fb->len) {
-    sdlog_printf("SAVE_FAIL frame_jpeg incomplete path=%s wrote=%lu expected=%lu\n",
-                 g_last_frame_path, (unsigned long)w, (unsigned long)fb->len);
-    return false;
-  }
+bool sd_write_jpg_packed(const char* path, uint32_t frame, const uint8_t* px, int W, int H,
+                         int quality, size_t* out_len) {
+  if (!sd_writes_enabled() || !path || !px || W <= 0 || H <= 0) return false;
+
+  uint8_t* jbuf = nullptr;
+  size_t jlen = 0;
+  if (!encode_jpg(px, W, H, quality, &jbuf, &jlen)) return false;
+  const bool ok = sd_write_packed(path, frame, jbuf, jlen);
+  free(jbuf);
+  if (out_len) *out_len = ok ? jlen : 0;
+  return ok;
+}
 
+// Paths are fixed now so later stages can refer to them; the bytes land
+// whenever the writer task gets to them.
+bool sd_save_fb_jpeg(camera_fb_t* fb) {
+  if (!sd_writes_enabled() || !fb || fb->format != PIXFORMAT_JPEG) return false;
+
+  snprintf(g_last_frame_path, sizeof(g_last_frame_path),
+           "%s/%06lu.jpg", g_frames_dir, (unsigned long)g_frame_counter);
   snprintf(g_last_meta_path, sizeof(g_last_meta_path),
            "%s/%06lu.txt", g_frames_dir, (unsigned long)g_frame_counter);
 
-  sdlog_printf("SAVE_OK frame_jpeg path=%s bytes=%lu\n", g_last_frame_path, (unsigned long)fb->len);
-  return true;
+  return sd_writer_submit_bytes(g_last_frame_path, fb->buf, fb->len, SdPriority::Normal, "frame_jpeg");
 }
 
 bool sd_init_boot_session_dirs_and_log() {
@@ -204,7 +219,7 @@ bool sd_init_boot_session_dirs_and_log() {
   if (!ensure_dir("/overlays")) return false;
   if (!ensure_dir(LOG_DIR)) return false;
 
-  if (!sd_wipe_dir_contents("/frames")) return false;
+  // /frames is kept: frames and their .det records are what overlays are drawn from
   if (!sd_wipe_dir_contents("/crops")) return false;
 
   g_boot_id = allocate_unique_boot_id();
@@ -225,16 +240,19 @@ bool sd_init_boot_session_dirs_and_log() {
   if (!ensure_dir(g_overlays_mite_dir)) return false;
   if (!ensure_dir(g_overlays_nomite_dir)) return false;
 
-  snprintf(g_log_path, sizeof(g_log_path), "%s/boot_%06lu.txt", LOG_DIR, (unsigned long)g_boot_id);
+  // without a pack, packed writes fall back to plain files
+  const bool packed = sd_pack_open_session(g_boot_id);
+
+  snprintf(g_log_path, sizeof(g_log_path), "%s/boot_%06lu.blg", LOG_DIR, (unsigned long)g_boot_id);
   g_log_file = SD_MMC.open(g_log_path, FILE_WRITE);
   if (!g_log_file) return false;
-
-  g_log_file.printf("=== BOOT %lu === millis=%lu ===\n", (unsigned long)g_boot_id, (unsigned long)millis());
-  g_log_file.printf("DIR frames=%s\nDIR bee_overlays=%s\nDIR crops=%s\nDIR overlays=%s\n",
-                    g_frames_dir, g_bee_overlays_dir, g_crops_dir, g_overlays_dir);
-  g_log_file.printf("DIR overlays/mite=%s\nDIR overlays/no_mite=%s\n",
-                    g_overlays_mite_dir, g_overlays_nomite_dir);
+  if (!evlog_write_file_header(g_log_file)) return false;
   g_log_file.flush();
 
+  EVLOG(BOOT, (unsigned long)g_boot_id, (unsigned long)millis());
+  EVLOG(BOOT_DIRS, g_frames_dir, g_bee_overlays_dir, g_crops_dir, g_overlays_dir);
+  EVLOG(BOOT_DIRS_OVERLAYS, g_overlays_mite_dir, g_overlays_nomite_dir);
+  if (!packed) Serial.println("WARN: pack not created, crops and overlay caches go to plain files");
+
   return true;
 }
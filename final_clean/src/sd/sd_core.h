@@ -4,10 +4,20 @@
 bool sd_init_mount();
 bool sd_init_boot_session_dirs_and_log();
 
-void sdlog_printf(const char* fmt, ...);
-
 bool sd_wipe_dir_contents(const char* dir_path);
 bool sd_copy_file(const char* src_path, const char* dst_path);
 
-bool sd_write_jpg_rgb888(const char* out_path, const uint8_t* rgb, int W, int H, int quality);
+// px is in decoder order: fmt2rgb888 emits B,G,R and fmt2jpg(PIXFORMAT_RGB888)
+// takes the same order, so every frame, crop and overlay buffer is encoded
+// as it lies.
+bool sd_write_jpg(const char* out_path, const uint8_t* px, int W, int H, int quality,
+                  size_t* out_len = nullptr);
+
+// Small per-boot artifacts: stored in the current boot's pack under the
+// path less its boot dir (see sd_pack.h), or as a plain file at path when
+// path is not in the current boot or the pack cannot take it.
+bool sd_write_packed(const char* path, uint32_t frame, const uint8_t* data, size_t len);
+bool sd_write_jpg_packed(const char* path, uint32_t frame, const uint8_t* px, int W, int H,
+                         int quality, size_t* out_len = nullptr);
+
 bool sd_save_fb_jpeg(camera_fb_t* fb);
@@ -0,0 +1,396 @@
+#include "sd_pack.h"
+#include "../log/evlog.h"
+
+static constexpr uint32_t PACK_MAGIC = 0x314B4150u;   // "PAK1"
+static constexpr uint32_t BLOB_MAGIC = 0x31424C42u;   // "BLB1"
+static constexpr uint32_t SEG_MAGIC  = 0x31584449u;   // "IDX1"
+
+// Sector 0 holds only the header, so repointing it rewrites one sector.
+static constexpr uint32_t PACK_DATA_START = SD_SECTOR_BYTES;
+
+struct __attribute__((packed)) PackHeader {
+  uint32_t magic;
+  uint32_t boot;
+  uint32_t last_seg;   // newest index segment, 0 for none
+  uint32_t sealed;     // entries the segments cover
+  uint32_t data_end;   // first byte past the newest segment
+};
+
+struct __attribute__((packed)) PackBlob {
+  uint32_t magic;
+  uint32_t id;
+  PackEntry e;
+};
+
+struct __attribute__((packed)) PackSegment {
+  uint32_t magic;
+  uint32_t first_id;
+  uint32_t count;
+  uint32_t prev;       // the segment before, 0 for the first
+  uint32_t sum;        // fnv1a of the entries that follow
+};
+
+static uint32_t fnv1a(const void* p, size_t n, uint32_t h = 2166136261u) {
+  const uint8_t* b = (const uint8_t*)p;
+  for (size_t i = 0; i < n; ++i) { h ^= b[i]; h *= 16777619u; }
+  return h;
+}
+
+static uint32_t name_hash(const char* name) { return fnv1a(name, strlen(name)); }
+
+static bool valid_boot(const char* boot) {
+  return boot && !strncmp(boot, "boot_", 5) && !strchr(boot, '/') && strlen(boot) < 16;
+}
+
+static void pack_path(const char* boot, char* out, size_t out_sz) {
+  snprintf(out, out_sz, "%s/%s.pak", PACK_DIR, boot);
+}
+
+bool sd_pack_split_path(const char* path, char* boot, size_t boot_sz, char* name, size_t name_sz) {
+  if (!path || path[0] != '/') return false;
+  const char* b = strchr(path + 1, '/');
+  if (!b) return false;
+  const char* rest = strchr(b + 1, '/');
+  if (!rest || !rest[1] || strstr(path, "..")) return false;
+
+  const int bn = snprintf(boot, boot_sz, "%.*s", (int)(rest - b - 1), b + 1);
+  const int nn = snprintf(name, name_sz, "%.*s%s", (int)(b - path - 1), path + 1, rest);
+  return bn > 0 && (size_t)bn < boot_sz && valid_boot(boot) && nn > 0 && (size_t)nn < name_sz;
+}
+
+// An index in PSRAM: entries in id order, with their name hashes beside
+// them so a lookup compares names only on a hash match.
+struct PackIndex {
+  PackEntry* e;
+  uint32_t* hash;
+  uint32_t cap;
+};
+
+static bool index_alloc(PackIndex& x, uint32_t cap) {
+  x.e = (PackEntry*)ps_malloc((size_t)cap * sizeof(PackEntry));
+  x.hash = (uint32_t*)ps_malloc((size_t)cap * sizeof(uint32_t));
+  if (!x.e || !x.hash) { free(x.e); free(x.hash); x = {}; return false; }
+  x.cap = cap;
+  return true;
+}
+
+static void index_free(PackIndex& x) {
+  free(x.e);
+  free(x.hash);
+  x = {};
+}
+
+static int32_t index_find(const PackIndex& x, uint32_t count, const char* name) {
+  const uint32_t h = name_hash(name);
+  for (uint32_t i = 0; i < count; ++i) {
+    if (x.hash[i] == h && !strncmp(x.e[i].name, name, sizeof(x.e[i].name))) return (int32_t)i;
+  }
+  return -1;
+}
+
+// ---- current boot (writer task) ----
+
+static File g_file;
+static char g_boot[16] = {0};
+static PackIndex g_index = {};
+static PackHeader g_hdr = {};
+static uint32_t g_count = 0;     // appended
+static uint32_t g_end = 0;       // where the next blob goes
+static uint32_t g_alloc = 0;     // file size
+static bool g_dirty = false;
+static bool g_full_logged = false;
+
+// what readers may see
+static uint32_t g_visible = 0;
+static PackStats g_stats = {};
+static portMUX_TYPE g_pack_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static bool write_at(uint32_t off, const void* p, size_t n) {
+  return g_file.seek(off) && g_file.write((const uint8_t*)p, n) == n;
+}
+
+// Extends the file in PACK_GROW_BYTES steps so its clusters are allocated
+// up front, not a few at a time by every append.
+static bool reserve(uint32_t need) {
+  if (need <= g_alloc) return true;
+  uint32_t a = g_alloc;
+  while (a < need) a += PACK_GROW_BYTES;
+  const uint8_t zero = 0;
+  if (!write_at(a - 1, &zero, 1)) return false;
+  g_alloc = a;
+  return true;
+}
+
+static void publish() {
+  portENTER_CRITICAL(&g_pack_mux);
+  g_visible = g_count;
+  g_stats.entries = g_count;
+  g_stats.sealed = g_hdr.sealed;
+  g_stats.data_end = g_end;
+  g_stats.alloc = g_alloc;
+  portEXIT_CRITICAL(&g_pack_mux);
+}
+
+static bool seal() {
+  const uint32_t t0 = millis();
+  PackSegment s = { SEG_MAGIC, g_hdr.sealed, g_count - g_hdr.sealed, g_hdr.last_seg, 0 };
+  s.sum = fnv1a(&g_index.e[s.first_id], (size_t)s.count * sizeof(PackEntry));
+
+  const uint32_t at = g_end;
+  if (!write_at(at, &s, sizeof(s)) ||
+      g_file.write((const uint8_t*)&g_index.e[s.first_id], (size_t)s.count * sizeof(PackEntry)) !=
+        (size_t)s.count * sizeof(PackEntry)) return false;
+  g_end += sizeof(s) + s.count * sizeof(PackEntry);
+  g_file.flush();   // the segment is on the card before the header points at it
+
+  g_hdr.last_seg = at;
+  g_hdr.sealed = g_count;
+  g_hdr.data_end = g_end;
+  if (!write_at(0, &g_hdr, sizeof(g_hdr))) return false;
+  g_file.flush();
+  g_dirty = false;
+  publish();
+  EVLOG(PACK_SEAL, g_boot, (unsigned long)g_count, (unsigned long)g_end, (unsigned long)(millis() - t0));
+  return true;
+}
+
+bool sd_pack_open_session(uint32_t boot_id) {
+  if (g_file) g_file.close();
+  if (!g_index.e && !index_alloc(g_index, PACK_MAX_ENTRIES)) return false;
+  if (!SD_MMC.exists(PACK_DIR) && !SD_MMC.mkdir(PACK_DIR)) return false;
+
+  snprintf(g_boot, sizeof(g_boot), "boot_%06lu", (unsigned long)boot_id);
+  char path[48];
+  pack_path(g_boot, path, sizeof(path));
+
+  g_hdr = { PACK_MAGIC, boot_id, 0, 0, PACK_DATA_START };
+  g_count = 0;
+  g_end = PACK_DATA_START;
+  g_alloc = 0;
+  g_dirty = false;
+  g_full_logged = false;
+
+  File f = SD_MMC.open(path, FILE_WRITE);
+  if (!f) return false;
+  const bool hdr_ok = f.write((const uint8_t*)&g_hdr, sizeof(g_hdr)) == sizeof(g_hdr);
+  f.close();
+  g_file = SD_MMC.open(path, "r+");
+  if (!hdr_ok || !g_file || !reserve(PACK_DATA_START + 1)) { if (g_file) g_file.close(); return false; }
+  g_file.flush();
+
+  portENTER_CRITICAL(&g_pack_mux);
+  g_stats = {};
+  portEXIT_CRITICAL(&g_pack_mux);
+  publish();
+  EVLOG(PACK_OPEN, path, (unsigned long)g_alloc);
+  return true;
+}
+
+bool sd_pack_append(const char* name, uint32_t frame, const uint8_t* data, size_t len) {
+  if (!g_file || !name || !data || !len || strlen(name) >= sizeof(PackEntry::name)) return false;
+  if (index_find(g_index, g_count, name) >= 0) return true;   // drawn twice before the first landed
+
+  const uint32_t seg_room = sizeof(PackSegment) + PACK_SEAL_EVERY * sizeof(PackEntry);
+  if (g_count >= g_index.cap || (uint64_t)g_end + sizeof(PackBlob) + len + seg_room > PACK_MAX_BYTES) {
+    if (!g_full_logged) EVLOG(PACK_FULL, g_boot, (unsigned long)g_count);
+    g_full_logged = true;
+    portENTER_CRITICAL(&g_pack_mux);
+    g_stats.appends_failed++;
+    portEXIT_CRITICAL(&g_pack_mux);
+    return false;
+  }
+
+  PackBlob b = {};
+  b.magic = BLOB_MAGIC;
+  b.id = g_count;
+  b.e.off = g_end + sizeof(PackBlob);
+  b.e.len = (uint32_t)len;
+  b.e.frame = frame;
+  strncpy(b.e.name, name, sizeof(b.e.name) - 1);
+
+  // room for this blob and the segment that may follow it
+  if (!reserve(b.e.off + (uint32_t)len + seg_room) ||
+      !write_at(g_end, &b, sizeof(b)) || g_file.write(data, len) != len) {
+    portENTER_CRITICAL(&g_pack_mux);
+    g_stats.appends_failed++;
+    portEXIT_CRITICAL(&g_pack_mux);
+    return false;   // g_end stays put: the next blob overwrites this one
+  }
+
+  g_end = b.e.off + (uint32_t)len;
+  g_index.e[g_count] = b.e;
+  g_index.hash[g_count] = name_hash(b.e.name);
+  g_count++;
+  g_dirty = true;
+
+  if (g_count - g_hdr.sealed >= PACK_SEAL_EVERY) (void)seal();
+  return true;
+}
+
+void sd_pack_flush() {
+  if (!g_file || !g_dirty) return;
+  g_file.flush();
+  g_dirty = false;
+  publish();
+}
+
+PackStats sd_pack_stats() {
+  portENTER_CRITICAL(&g_pack_mux);
+  const PackStats s = g_stats;
+  portEXIT_CRITICAL(&g_pack_mux);
+  return s;
+}
+
+// ---- readers ----
+
+// The last older boot a reader asked for (web task only). Packs of older
+// boots no longer change, so this stays valid until the storage manager
+// deletes one (g_forgotten, set from its task).
+static char g_cached_boot[16] = {0};
+static PackIndex g_cached = {};
+static uint32_t g_cached_count = 0;
+static volatile uint32_t g_forgotten = 0;
+
+void sd_pack_forget(uint32_t boot_id) { g_forgotten = boot_id; }
+
+// Reads blob headers (stepping over segments) from off on, for ids from id
+// on; stops at the first thing that is not the next blob.
+static uint32_t scan_blobs(File& f, uint32_t off, uint32_t id, PackIndex& x, uint32_t& count) {
+  const uint32_t size = (uint32_t)f.size();
+  uint32_t found = 0;
+  while (count < x.cap && off + sizeof(PackBlob) <= size && f.seek(off)) {
+    PackBlob b;
+    if (f.read((uint8_t*)&b, sizeof(b)) != sizeof(b)) break;
+    if (b.magic == SEG_MAGIC) {
+      const PackSegment& s = *(const PackSegment*)&b;
+      if (s.count > PACK_SEAL_EVERY) break;
+      off += sizeof(PackSegment) + s.count * sizeof(PackEntry);
+      continue;
+    }
+    if (b.magic != BLOB_MAGIC || b.id != id || b.e.off != off + sizeof(PackBlob) ||
+        b.e.len > size - b.e.off || !memchr(b.e.name, 0, sizeof(b.e.name))) break;
+    x.e[count] = b.e;
+    x.hash[count] = name_hash(b.e.name);
+    count++;
+    id++;
+    found++;
+    off = b.e.off + b.e.len;
+  }
+  return found;
+}
+
+// Loads the segment chain; false when it is broken anywhere.
+static bool load_segments(File& f, const PackHeader& h, PackIndex& x) {
+  if (h.sealed > x.cap) return false;
+  uint32_t off = h.last_seg, covered = 0;
+  while (off) {
+    PackSegment s;
+    if (!f.seek(off) || f.read((uint8_t*)&s, sizeof(s)) != sizeof(s) || s.magic != SEG_MAGIC ||
+        s.first_id + s.count > h.sealed || s.prev >= off) return false;
+    const size_t n = (size_t)s.count * sizeof(PackEntry);
+    if (f.read((uint8_t*)&x.e[s.first_id], n) != n || fnv1a(&x.e[s.first_id], n) != s.sum) return false;
+    for (uint32_t i = s.first_id; i < s.first_id + s.count; ++i) x.hash[i] = name_hash(x.e[i].name);
+    covered += s.count;
+    off = s.prev;
+  }
+  return covered == h.sealed;
+}
+
+static bool load_cached(const char* boot) {
+  const uint32_t gone = g_forgotten;
+  if (gone && g_cached.e && strtoul(g_cached_boot + 5, nullptr, 10) == gone) {
+    index_free(g_cached);
+    g_cached_boot[0] = 0;
+    g_cached_count = 0;
+  }
+  if (g_cached.e && !strcmp(g_cached_boot, boot)) return true;
+
+  File f = sd_pack_open_read(boot);
+  PackHeader h;
+  if (!f || f.read((uint8_t*)&h, sizeof(h)) != sizeof(h) || h.magic != PACK_MAGIC) {
+    if (f) f.close();
+    return false;
+  }
+
+  const uint32_t t0 = millis();
+  index_free(g_cached);
+  g_cached_boot[0] = 0;
+  g_cached_count = 0;
+  // sealed entries plus at most one segment's worth after them, unless
+  // the chain is broken and the whole pack has to be scanned
+  bool chain = h.sealed <= PACK_MAX_ENTRIES && index_alloc(g_cached, h.sealed + PACK_SEAL_EVERY);
+  chain = chain && load_segments(f, h, g_cached);
+  uint32_t scanned = 0;
+  if (chain) {
+    g_cached_count = h.sealed;
+    scanned = scan_blobs(f, h.data_end, h.sealed, g_cached, g_cached_count);
+  } else {
+    index_free(g_cached);
+    if (!index_alloc(g_cached, PACK_MAX_ENTRIES)) { f.close(); return false; }
+    scanned = scan_blobs(f, PACK_DATA_START, 0, g_cached, g_cached_count);
+  }
+  f.close();
+
+  snprintf(g_cached_boot, sizeof(g_cached_boot), "%s", boot);
+  if (scanned || !chain)
+    EVLOG(PACK_RECOVER, boot, (unsigned long)g_cached_count, (unsigned long)scanned, (unsigned long)(millis() - t0));
+  return true;
+}
+
+// The index readers see for boot, and how many entries of it are there.
+static const PackIndex* reader_index(const char* boot, uint32_t& count) {
+  if (!valid_boot(boot)) return nullptr;
+  if (g_index.e && !strcmp(boot, g_boot)) {
+    portENTER_CRITICAL(&g_pack_mux);
+    count = g_visible;
+    portEXIT_CRITICAL(&g_pack_mux);
+    return &g_index;
+  }
+  if (!load_cached(boot)) return nullptr;
+  count = g_cached_count;
+  return &g_cached;
+}
+
+bool sd_pack_count(const char* boot, uint32_t* count) {
+  uint32_t n = 0;
+  if (!reader_index(boot, n)) return false;
+  if (count) *count = n;
+  return true;
+}
+
+bool sd_pack_list(const char* boot, const char* prefix, PackListFn fn, void* arg) {
+  uint32_t count = 0;
+  const PackIndex* x = reader_index(boot, count);
+  if (!x || !fn) return false;
+  const size_t pl = prefix ? strlen(prefix) : 0;
+  for (uint32_t i = 0; i < count; ++i) {
+    if (!pl || !strncmp(x->e[i].name, prefix, pl)) fn(i, x->e[i], arg);
+  }
+  return true;
+}
+
+bool sd_pack_get(const char* boot, uint32_t id, PackEntry& e) {
+  uint32_t count = 0;
+  const PackIndex* x = reader_index(boot, count);
+  if (!x || id >= count) return false;
+  e = x->e[id];
+  return true;
+}
+
+bool sd_pack_find(const char* boot, const char* name, uint32_t* id, PackEntry& e) {
+  uint32_t count = 0;
+  const PackIndex* x = reader_index(boot, count);
+  if (!x || !name) return false;
+  const int32_t i = index_find(*x, count, name);
+  if (i < 0) return false;
+  if (id) *id = (uint32_t)i;
+  e = x->e[i];
+  return true;
+}
+
+File sd_pack_open_read(const char* boot) {
+  if (!valid_boot(boot)) return File();
+  char path[48];
+  pack_path(boot, path, sizeof(path));
+  return SD_MMC.open(path, FILE_READ);
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include "../globals.h"
+
+// Per-boot pack: small artifacts (crop audit copies, the running boot's
+// overlay and thumbnail caches) are appended as blobs to one preallocated
+// file, /packs/boot_N.pak, rather than written as a file each, so neither
+// writing one nor listing them costs more as the session grows.
+//
+// Layout: a PackHeader, then blobs (PackBlob + data) in id order. Every
+// PACK_SEAL_EVERY blobs an index segment (PackSegment + its PackEntry
+// records) is written after them and the header repointed at it; segments
+// chain backwards. A reader loads the chain and then scans blob headers
+// past the last segment, which a reboot leaves at most PACK_SEAL_EVERY of.
+
+struct __attribute__((packed)) PackEntry {
+  uint32_t off;     // data offset in the pack
+  uint32_t len;
+  uint32_t frame;
+  char name[52];    // card path less the boot dir: "crops/<tile>.jpg", "overlays/mite/..."
+};
+static_assert(sizeof(PackEntry) == 64, "index records are 64 bytes");
+
+struct PackStats {
+  uint32_t entries;    // current boot, flushed
+  uint32_t sealed;     // of those, covered by an index segment
+  uint32_t appends_failed;
+  uint32_t data_end;   // bytes of the pack in use
+  uint32_t alloc;      // bytes the pack file holds
+};
+
+// Splits /<root>/boot_N/<rest> into "boot_N" and "<root>/<rest>"; false for
+// anything else or when a part does not fit.
+bool sd_pack_split_path(const char* path, char* boot, size_t boot_sz, char* name, size_t name_sz);
+
+// Creates the current boot's pack; called from the session setup.
+bool sd_pack_open_session(uint32_t boot_id);
+
+// ---- SD writer task only ----
+// False when the pack is full or unavailable (the caller writes a plain
+// file instead) or the write failed. A name already in the pack is not
+// stored again.
+bool sd_pack_append(const char* name, uint32_t frame, const uint8_t* data, size_t len);
+// Makes appended blobs visible to readers; the writer calls it once its
+// queue runs dry, so a burst of crops costs one sync.
+void sd_pack_flush();
+
+// ---- readers (web task) ----
+typedef void (*PackListFn)(uint32_t id, const PackEntry& e, void* arg);
+
+// Entries readers can see; false when the boot has no pack.
+bool sd_pack_count(const char* boot, uint32_t* count);
+// Calls fn for each entry of boot's pack whose name starts with prefix
+// (all when null), in id order. False when the boot has no pack.
+bool sd_pack_list(const char* boot, const char* prefix, PackListFn fn, void* arg);
+bool sd_pack_get(const char* boot, uint32_t id, PackEntry& e);
+bool sd_pack_find(const char* boot, const char* name, uint32_t* id, PackEntry& e);
+
+// The pack file, opened for reading; seek to an entry's off for its data.
+File sd_pack_open_read(const char* boot);
+// The storage manager removed boot_id's pack: drops a cached index of it.
+void sd_pack_forget(uint32_t boot_id);
+
+PackStats sd_pack_stats();
@@ -0,0 +1,328 @@
+#include "sd_writer.h"
+#include "sd_core.h"
+#include "sd_pack.h"
+#include "storage.h"
+#include "../log/evlog.h"
+#include "../metrics/metrics.h"
+
+static constexpr uint32_t WRITER_TASK_STACK = 8192;
+static constexpr UBaseType_t WRITER_TASK_PRIO = 1;
+
+enum class SdJobKind : uint8_t { Bytes, Append, Jpeg, Log };
+
+struct SdJob {
+  bool live;
+  SdJobKind kind;
+  SdPriority pri;
+  char tag[24];
+  char path[128];
+  uint8_t* data;
+  size_t len;
+  uint16_t w;
+  uint16_t h;
+  uint8_t quality;
+  bool packed;      // Bytes / Jpeg: into the boot's pack when it can
+  uint32_t frame;
+  int64_t enq_us;
+};
+
+// FIFO of job slots. Evicted jobs stay in place as dead slots so the writer
+// can skip them without reshuffling the ring.
+static SdJob g_jobs[SD_WRITER_MAX_JOBS];
+static uint32_t g_head = 0;       // oldest slot
+static uint32_t g_slots = 0;      // slots in use (live + dead)
+static uint32_t g_live = 0;
+static uint32_t g_bytes = 0;
+
+static SemaphoreHandle_t g_mu = nullptr;
+static SemaphoreHandle_t g_items = nullptr;   // one count per pushed slot
+static SemaphoreHandle_t g_space = nullptr;   // poked whenever room is freed
+static TaskHandle_t g_task = nullptr;
+static volatile bool g_busy = false;
+
+static SdBackpressure g_policy = SD_WRITER_POLICY;
+static SdWriterStats g_stats = {};
+
+static void lock()   { xSemaphoreTake(g_mu, portMAX_DELAY); }
+static void unlock() { xSemaphoreGive(g_mu); }
+
+static void kill_slot_locked(SdJob& j) {
+  if (!j.live) return;
+  free(j.data);
+  j.data = nullptr;
+  g_bytes -= (uint32_t)j.len;
+  g_live--;
+  j.live = false;
+}
+
+// Evicts the oldest queued job the policy allows; false if nothing qualifies.
+static bool evict_one_locked(SdPriority incoming) {
+  for (uint32_t k = 0; k < g_slots; ++k) {
+    SdJob& j = g_jobs[(g_head + k) % SD_WRITER_MAX_JOBS];
+    if (!j.live || j.pri == SdPriority::High) continue;
+    if (g_policy == SdBackpressure::DropLowPriority && j.pri != SdPriority::Low) continue;
+    if (g_policy == SdBackpressure::DropOldest && j.pri > incoming) continue;
+    kill_slot_locked(j);
+    g_stats.jobs_dropped++;
+    return true;
+  }
+  return false;
+}
+
+static bool fits_locked(size_t len) {
+  return g_slots < SD_WRITER_MAX_JOBS && (g_bytes + len) <= SD_WRITER_MAX_BYTES;
+}
+
+// Takes ownership of data (ps_malloc'd). Applies the backpressure policy.
+// Never logs while holding g_mu: the log flusher enqueues too.
+static bool enqueue(SdJob& job) {
+  if (!g_task) { free(job.data); return false; }
+
+  // Log lines are tiny and are only ever held up by a full slot ring.
+  const bool is_log = (job.kind == SdJobKind::Log);
+  uint32_t evicted = 0;
+
+  lock();
+  if (!is_log && job.len > SD_WRITER_MAX_BYTES) {
+    // no amount of eviction or waiting would make room
+    g_stats.jobs_dropped++;
+    unlock();
+    EVLOG(SDW_DROP, job.tag, job.path);
+    free(job.data);
+    return false;
+  }
+  while (!fits_locked(is_log ? 0 : job.len)) {
+    if (!is_log) {
+      if (g_policy == SdBackpressure::DropLowPriority && job.pri == SdPriority::Low) {
+        g_stats.jobs_dropped++;
+        unlock();
+        EVLOG(SDW_DROP, job.tag, job.path);
+        free(job.data);
+        return false;
+      }
+      if (g_policy != SdBackpressure::Block && evict_one_locked(job.pri)) { evicted++; continue; }
+    }
+
+    unlock();
+    xSemaphoreTake(g_space, pdMS_TO_TICKS(20));
+    lock();
+  }
+
+  job.live = true;
+  job.enq_us = esp_timer_get_time();
+  g_jobs[(g_head + g_slots) % SD_WRITER_MAX_JOBS] = job;
+  g_slots++;
+  g_live++;
+  g_bytes += (uint32_t)job.len;
+  if (g_live > g_stats.peak_jobs) g_stats.peak_jobs = g_live;
+  unlock();
+
+  xSemaphoreGive(g_items);
+  if (evicted) EVLOG(SDW_EVICTED, (unsigned long)evicted, job.tag, job.path);
+  return true;
+}
+
+static bool run_job(const SdJob& j, size_t& wrote) {
+  wrote = 0;
+  switch (j.kind) {
+    case SdJobKind::Log:
+      if (!g_log_file) return false;
+      wrote = g_log_file.write(j.data, j.len);
+      return wrote == j.len;
+
+    case SdJobKind::Bytes:
+      if (j.packed) {
+        if (!sd_write_packed(j.path, j.frame, j.data, j.len)) return false;
+        wrote = j.len;
+        return true;
+      }
+      // fall through
+    case SdJobKind::Append: {
+      File f = SD_MMC.open(j.path, j.kind == SdJobKind::Append ? FILE_APPEND : FILE_WRITE);
+      if (!f) return false;
+      wrote = f.write(j.data, j.len);
+      f.close();
+      return wrote == j.len;
+    }
+
+    case SdJobKind::Jpeg:
+      if (j.packed) return sd_write_jpg_packed(j.path, j.frame, j.data, j.w, j.h, j.quality, &wrote);
+      return sd_write_jpg(j.path, j.data, j.w, j.h, j.quality, &wrote);
+  }
+  return false;
+}
+
+static void writer_task(void*) {
+  while (true) {
+    xSemaphoreTake(g_items, portMAX_DELAY);
+
+    lock();
+    SdJob job = g_jobs[g_head];
+    g_jobs[g_head].live = false;
+    g_jobs[g_head].data = nullptr;
+    g_head = (g_head + 1) % SD_WRITER_MAX_JOBS;
+    g_slots--;
+    if (job.live) g_busy = true;
+    unlock();
+
+    if (!job.live) { xSemaphoreGive(g_space); continue; }
+
+    size_t wrote = 0;
+    const uint32_t t0 = metrics_now_us();
+    const bool ok = sd_writes_enabled() && run_job(job, wrote);
+
+    // batch log flushes: only flush once no more lines are waiting
+    if (job.kind == SdJobKind::Log && g_log_file && uxSemaphoreGetCount(g_items) == 0) g_log_file.flush();
+    // same for the pack (a no-op unless blobs went in): readers see a burst once it has landed
+    if (uxSemaphoreGetCount(g_items) == 0) sd_pack_flush();
+
+    const uint32_t lat = (uint32_t)(esp_timer_get_time() - job.enq_us);
+    metrics_record(Metric::SdWrite, metrics_now_us() - t0);
+    metrics_record(Metric::SdLatency, lat);
+
+    lock();
+    free(job.data);
+    g_bytes -= (uint32_t)job.len;
+    g_live--;
+    if (ok) g_stats.jobs_done++; else g_stats.jobs_failed++;
+    g_stats.bytes_written += wrote;
+    g_stats.last_latency_us = lat;
+    g_stats.total_latency_us += lat;
+    if (lat > g_stats.max_latency_us) g_stats.max_latency_us = lat;
+    g_busy = false;
+    unlock();
+    xSemaphoreGive(g_space);
+    // for storage quotas; a packed job stands for the running boot's pack
+    if (ok) storage_note_write(job.packed ? PACK_DIR : job.path, wrote);
+
+    if (job.kind == SdJobKind::Log) continue;
+    if (ok) EVLOG(SAVE_OK, job.tag, job.path, (unsigned long)wrote, (unsigned long)(lat / 1000));
+    else    EVLOG(SAVE_FAIL, job.tag, job.path);
+  }
+}
+
+bool sd_writer_begin() {
+  if (g_task) return true;
+
+  g_mu = xSemaphoreCreateMutex();
+  g_items = xSemaphoreCreateCounting(SD_WRITER_MAX_JOBS, 0);
+  g_space = xSemaphoreCreateBinary();
+  if (!g_mu || !g_items || !g_space) return false;
+
+  return xTaskCreatePinnedToCore(writer_task, "sd_writer", WRITER_TASK_STACK, nullptr,
+                                 WRITER_TASK_PRIO, &g_task, SD_WRITER_TASK_CORE) == pdPASS;
+}
+
+static bool is_writer_task() {
+  return g_task && xTaskGetCurrentTaskHandle() == g_task;
+}
+
+void sd_writer_set_policy(SdBackpressure p) { g_policy = p; }
+
+static void fill_header(SdJob& j, SdJobKind kind, SdPriority pri, const char* path, const char* tag) {
+  memset(&j, 0, sizeof(j));
+  j.kind = kind;
+  j.pri = pri;
+  snprintf(j.path, sizeof(j.path), "%s", path ? path : "");
+  snprintf(j.tag, sizeof(j.tag), "%s", tag ? tag : "file");
+}
+
+static bool submit_copy(SdJobKind kind, const char* path, const uint8_t* data, size_t len,
+                        SdPriority pri, const char* tag) {
+  if (!sd_writes_enabled() || !path || !data || !len) return false;
+
+  SdJob j;
+  fill_header(j, kind, pri, path, tag);
+  j.data = (uint8_t*)ps_malloc(len);
+  if (!j.data) { EVLOG(SDW_OOM, j.tag, (unsigned long)len); return false; }
+  memcpy(j.data, data, len);
+  j.len = len;
+  return enqueue(j);
+}
+
+bool sd_writer_submit_bytes(const char* path, const uint8_t* data, size_t len,
+                            SdPriority pri, const char* tag) {
+  return submit_copy(SdJobKind::Bytes, path, data, len, pri, tag);
+}
+
+bool sd_writer_submit_append(const char* path, const uint8_t* data, size_t len,
+                             SdPriority pri, const char* tag) {
+  return submit_copy(SdJobKind::Append, path, data, len, pri, tag);
+}
+
+bool sd_writer_submit_packed(const char* path, uint32_t frame, const uint8_t* data, size_t len,
+                             SdPriority pri, const char* tag) {
+  if (!sd_writes_enabled() || !path || !data || !len) return false;
+
+  SdJob j;
+  fill_header(j, SdJobKind::Bytes, pri, path, tag);
+  j.data = (uint8_t*)ps_malloc(len);
+  if (!j.data) { EVLOG(SDW_OOM, j.tag, (unsigned long)len); return false; }
+  memcpy(j.data, data, len);
+  j.len = len;
+  j.packed = true;
+  j.frame = frame;
+  return enqueue(j);
+}
+
+static bool submit_jpeg(const char* path, const uint8_t* px, int W, int H, int quality,
+                        SdPriority pri, const char* tag, bool packed, uint32_t frame) {
+  if (!sd_writes_enabled() || !path || !px || W <= 0 || H <= 0) return false;
+
+  const size_t len = (size_t)W * (size_t)H * 3u;
+  SdJob j;
+  fill_header(j, SdJobKind::Jpeg, pri, path, tag);
+  j.packed = packed;
+  j.frame = frame;
+  j.data = (uint8_t*)ps_malloc(len);
+  if (!j.data) { EVLOG(SDW_OOM, j.tag, (unsigned long)len); return false; }
+  memcpy(j.data, px, len);
+  j.len = len;
+  j.w = (uint16_t)W;
+  j.h = (uint16_t)H;
+  j.quality = (uint8_t)quality;
+  return enqueue(j);
+}
+
+bool sd_writer_submit_jpeg(const char* path, const uint8_t* px, int W, int H, int quality,
+                           SdPriority pri, const char* tag) {
+  return submit_jpeg(path, px, W, H, quality, pri, tag, false, 0);
+}
+
+bool sd_writer_submit_packed_jpeg(const char* path, uint32_t frame, const uint8_t* px, int W, int H,
+                                  int quality, SdPriority pri, const char* tag) {
+  return submit_jpeg(path, px, W, H, quality, pri, tag, true, frame);
+}
+
+bool sd_writer_submit_log(const uint8_t* data, size_t len) {
+  if (!data || !len) return false;
+
+  SdJob j;
+  fill_header(j, SdJobKind::Log, SdPriority::High, g_log_path, "log");
+  j.data = (uint8_t*)ps_malloc(len);
+  if (!j.data) return false;
+  memcpy(j.data, data, len);
+  j.len = len;
+  return enqueue(j);
+}
+
+void sd_writer_wait_idle() {
+  if (!g_task || is_writer_task()) return;
+  while (true) {
+    lock();
+    const bool idle = (g_live == 0) && !g_busy;
+    unlock();
+    if (idle) return;
+    vTaskDelay(1);
+  }
+}
+
+SdWriterStats sd_writer_stats() {
+  if (!g_mu) return g_stats;
+  lock();
+  SdWriterStats s = g_stats;
+  s.queued_jobs = g_live;
+  s.queued_bytes = g_bytes;
+  unlock();
+  return s;
+}
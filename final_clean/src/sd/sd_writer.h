@@ -0,0 +1,49 @@
+#pragma once
+#include "../globals.h"
+#include "sd_core.h"
+
+// Write-behind queue in front of the SD card. Callers hand over a copy of the
+// payload and return immediately; a dedicated task does the FAT work, so card
+// stalls no longer land on the inference path.
+
+enum class SdPriority : uint8_t {
+  Low,     // droppable artifacts (crop audit copies, no-mite crops)
+  Normal,  // frames, overlays, metadata
+  High,    // log lines, .det records, manifest entries; never dropped
+};
+
+struct SdWriterStats {
+  uint32_t jobs_done;
+  uint32_t jobs_failed;
+  uint32_t jobs_dropped;
+  uint32_t queued_jobs;
+  uint32_t queued_bytes;
+  uint32_t peak_jobs;
+  uint64_t bytes_written;
+  uint32_t last_latency_us;   // enqueue -> on card, last job
+  uint32_t max_latency_us;
+  uint64_t total_latency_us;
+};
+
+bool sd_writer_begin();
+void sd_writer_set_policy(SdBackpressure p);
+
+bool sd_writer_submit_bytes(const char* path, const uint8_t* data, size_t len,
+                            SdPriority pri, const char* tag);
+// Appends to path instead of replacing it. Jobs run in submit order, so
+// appends to one file land in the order they were made.
+bool sd_writer_submit_append(const char* path, const uint8_t* data, size_t len,
+                             SdPriority pri, const char* tag);
+bool sd_writer_submit_jpeg(const char* path, const uint8_t* px, int W, int H, int quality,
+                           SdPriority pri, const char* tag);
+// Small per-boot artifacts: stored in the boot's pack when they can be
+// (see sd_write_packed), as a plain file at path otherwise.
+bool sd_writer_submit_packed(const char* path, uint32_t frame, const uint8_t* data, size_t len,
+                             SdPriority pri, const char* tag);
+bool sd_writer_submit_packed_jpeg(const char* path, uint32_t frame, const uint8_t* px, int W, int H,
+                                  int quality, SdPriority pri, const char* tag);
+// Appends a block of already-encoded log records to the session log.
+bool sd_writer_submit_log(const uint8_t* data, size_t len);
+
+void sd_writer_wait_idle();
+SdWriterStats sd_writer_stats();
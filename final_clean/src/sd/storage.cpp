@@ -0,0 +1,511 @@
+#include "storage.h"
+#include "sd_pack.h"
+#include "sd_writer.h"
+#include "../log/evlog.h"
+
+// What one boot holds on the card, per category.
+struct BootUsage {
+  uint32_t id;
+  uint32_t pad;
+  uint64_t bytes[STORAGE_CATS];
+};
+static_assert(sizeof(BootUsage) == 56, "matches the STORAGE_MAX_BOOTS note");
+
+// Sorted by id, so the oldest boot comes first.
+struct BootTable {
+  BootUsage* b;
+  uint32_t n;
+};
+
+static const char* cat_root(StorageCat c) {
+  switch (c) {
+    case StorageCat::Frames:      return "/frames";
+    case StorageCat::Crops:       return "/crops";
+    case StorageCat::BeeOverlays: return "/bee_overlays";
+    case StorageCat::Overlays:    return "/overlays";
+    case StorageCat::Packs:       return PACK_DIR;
+    case StorageCat::Logs:        return LOG_DIR;
+    default:                      return "";
+  }
+}
+
+static uint64_t cat_quota(StorageCat c) {
+  switch (c) {
+    case StorageCat::Frames:      return STORAGE_QUOTA_FRAMES;
+    case StorageCat::Crops:       return STORAGE_QUOTA_CROPS;
+    case StorageCat::BeeOverlays: return STORAGE_QUOTA_BEE_OVERLAYS;
+    case StorageCat::Overlays:    return STORAGE_QUOTA_OVERLAYS;
+    case StorageCat::Packs:       return STORAGE_QUOTA_PACKS;
+    case StorageCat::Logs:        return STORAGE_QUOTA_LOGS;
+    default:                      return 0;
+  }
+}
+
+// Packs and logs are one file per boot; the rest a directory per boot.
+static bool cat_is_file(StorageCat c) { return c == StorageCat::Packs || c == StorageCat::Logs; }
+
+const char* storage_cat_name(StorageCat c) {
+  switch (c) {
+    case StorageCat::Frames:      return "frames";
+    case StorageCat::Crops:       return "crops";
+    case StorageCat::BeeOverlays: return "bee_overlays";
+    case StorageCat::Overlays:    return "overlays";
+    case StorageCat::Packs:       return "packs";
+    case StorageCat::Logs:        return "logs";
+    default:                      return "?";
+  }
+}
+
+// "/<root>/boot_N[...]": the category and N; false for anything else.
+static bool split_card_path(const char* path, StorageCat* cat, uint32_t* boot) {
+  if (!path) return false;
+  for (size_t i = 0; i < STORAGE_CATS; ++i) {
+    const char* root = cat_root((StorageCat)i);
+    const size_t n = strlen(root);
+    if (strncmp(path, root, n) || (path[n] && path[n] != '/')) continue;
+    *cat = (StorageCat)i;
+    *boot = 0;
+    if (path[n] != '/' || strncmp(path + n + 1, "boot_", 5)) return true;   // e.g. a pack blob
+    char* end = nullptr;
+    *boot = (uint32_t)strtoul(path + n + 6, &end, 10);
+    return end != path + n + 6;
+  }
+  return false;
+}
+
+// ---- state (loop task; g_live and the counters also under g_st_mu) ----
+
+// A mutex rather than a spinlock: the table walks in storage_stats() and
+// pick_job() cover up to STORAGE_MAX_BOOTS entries in PSRAM.
+static SemaphoreHandle_t g_st_mu = nullptr;
+static void lock()   { xSemaphoreTake(g_st_mu, portMAX_DELAY); }
+static void unlock() { xSemaphoreGive(g_st_mu); }
+
+static BootTable g_live = {};   // what the card holds now, as far as known
+static BootTable g_next = {};   // the census in progress
+static StorageStats g_stats = {};
+static bool g_ready = false;
+
+static uint32_t g_last_slice = 0;
+static uint32_t g_last_census = 0;
+static uint32_t g_last_poll = 0;
+static bool g_polled = false;
+
+static bool table_alloc(BootTable& t) {
+  const size_t n = (size_t)STORAGE_MAX_BOOTS * sizeof(BootUsage);
+  t.b = (BootUsage*)ps_malloc(n);
+  if (!t.b) t.b = (BootUsage*)malloc(n);
+  t.n = 0;
+  return t.b != nullptr;
+}
+
+static BootUsage* table_find(BootTable& t, uint32_t id) {
+  uint32_t lo = 0, hi = t.n;
+  while (lo < hi) {
+    const uint32_t mid = (lo + hi) / 2;
+    if (t.b[mid].id < id) lo = mid + 1; else hi = mid;
+  }
+  return lo < t.n && t.b[lo].id == id ? &t.b[lo] : nullptr;
+}
+
+// Entry for id, added in order when new; null when the table is full.
+static BootUsage* table_get(BootTable& t, uint32_t id) {
+  uint32_t lo = 0, hi = t.n;
+  while (lo < hi) {
+    const uint32_t mid = (lo + hi) / 2;
+    if (t.b[mid].id < id) lo = mid + 1; else hi = mid;
+  }
+  if (lo < t.n && t.b[lo].id == id) return &t.b[lo];
+  if (t.n == STORAGE_MAX_BOOTS) return nullptr;
+  memmove(&t.b[lo + 1], &t.b[lo], (t.n - lo) * sizeof(BootUsage));
+  memset(&t.b[lo], 0, sizeof(BootUsage));
+  t.b[lo].id = id;
+  t.n++;
+  return &t.b[lo];
+}
+
+static bool usage_empty(const BootUsage& u) {
+  for (size_t i = 0; i < STORAGE_CATS; ++i) if (u.bytes[i]) return false;
+  return true;
+}
+
+void storage_note_write(const char* path, size_t len) {
+  StorageCat c;
+  uint32_t boot;
+  // blobs in the running boot's pack (boot 0) are counted from its size instead
+  if (!g_ready || !g_st_mu || !len || !split_card_path(path, &c, &boot) || !boot) return;
+  lock();
+  BootUsage* u = table_get(g_live, boot);
+  if (u) u->bytes[(size_t)c] += len;
+  unlock();
+}
+
+// ---- directory walk, resumable across slices ----
+
+static constexpr int WALK_DEPTH = 4;   // /overlays/boot_N/mite/thumbs
+
+struct Walk {
+  File dir[WALK_DEPTH];
+  char path[WALK_DEPTH][96];
+  int depth = -1;
+};
+
+enum class WalkStep : uint8_t { File, DirDone, End };
+
+static void walk_close(Walk& w) {
+  for (; w.depth >= 0; --w.depth) w.dir[w.depth].close();
+}
+
+static bool walk_push(Walk& w, const char* path) {
+  if (w.depth + 1 >= WALK_DEPTH) return false;
+  File d = SD_MMC.open(path);
+  if (!d || !d.isDirectory()) { if (d) d.close(); return false; }
+  w.depth++;
+  w.dir[w.depth] = d;
+  snprintf(w.path[w.depth], sizeof(w.path[0]), "%s", path);
+  return true;
+}
+
+static bool walk_open(Walk& w, const char* root) {
+  walk_close(w);
+  return walk_push(w, root);
+}
+
+// Next file (path and size) or, once a directory is exhausted, that
+// directory, so it can be removed after its contents. Anything nested
+// deeper than WALK_DEPTH is left alone.
+static WalkStep walk_next(Walk& w, char* path, size_t path_sz, uint32_t* size) {
+  while (w.depth >= 0) {
+    File e = w.dir[w.depth].openNextFile();
+    if (!e) {
+      w.dir[w.depth].close();
+      snprintf(path, path_sz, "%s", w.path[w.depth]);
+      w.depth--;
+      return WalkStep::DirDone;
+    }
+    const char* nm = e.name();
+    const char* bn = nm ? strrchr(nm, '/') : nullptr;
+    bn = bn ? bn + 1 : (nm ? nm : "");
+    const bool is_dir = e.isDirectory();
+    const bool named = bn[0] != 0;
+    *size = is_dir ? 0 : (uint32_t)e.size();
+    snprintf(path, path_sz, "%s/%s", w.path[w.depth], bn);
+    e.close();   // the name goes with it
+    if (!named) continue;
+
+    if (!is_dir) return WalkStep::File;
+    (void)walk_push(w, path);
+  }
+  return WalkStep::End;
+}
+
+static Walk g_walk;
+static char g_path[128];
+
+// ---- census: recounts every category into g_next, then swaps it in ----
+
+static bool g_census = false;
+static size_t g_census_cat = 0;
+static bool g_census_open = false;
+static uint32_t g_census_t0 = 0;
+
+static void census_start(uint32_t now) {
+  g_census = true;
+  g_census_cat = 0;
+  g_census_open = false;
+  g_census_t0 = now;
+  g_next.n = 0;
+}
+
+static void census_finish(uint32_t now) {
+  uint32_t boots;
+  lock();
+  // the running boot keeps what the writer reported if that is more: it
+  // went on writing while the census went by
+  const BootUsage* cur = table_find(g_live, g_boot_id);
+  BootUsage* nxt = cur ? table_get(g_next, g_boot_id) : nullptr;
+  if (cur && nxt)
+    for (size_t i = 0; i < STORAGE_CATS; ++i)
+      if (cur->bytes[i] > nxt->bytes[i]) nxt->bytes[i] = cur->bytes[i];
+  const BootTable t = g_live;
+  g_live = g_next;
+  g_next = t;
+  boots = g_live.n;
+  g_stats.censuses++;
+  g_stats.census_ms = now - g_census_t0;
+  unlock();
+
+  g_census = false;
+  g_ready = true;
+  g_last_census = now;
+  EVLOG(STORAGE_CENSUS, (unsigned long)boots, (unsigned long)(now - g_census_t0));
+}
+
+// One entry of the census; false once it is complete.
+static bool census_step(uint32_t now) {
+  if (g_census_cat == STORAGE_CATS) { census_finish(now); return false; }
+
+  const StorageCat c = (StorageCat)g_census_cat;
+  if (!g_census_open) {
+    g_census_open = walk_open(g_walk, cat_root(c));
+    if (!g_census_open) g_census_cat++;
+    return true;
+  }
+
+  uint32_t size = 0;
+  const WalkStep s = walk_next(g_walk, g_path, sizeof(g_path), &size);
+  if (s == WalkStep::End) {
+    g_census_open = false;
+    g_census_cat++;
+  } else if (s == WalkStep::File) {
+    StorageCat fc;
+    uint32_t boot;
+    if (split_card_path(g_path, &fc, &boot) && boot) {
+      BootUsage* u = table_get(g_next, boot);
+      if (u) u->bytes[(size_t)fc] += size;
+    }
+  }
+  return true;
+}
+
+// ---- free space ----
+
+static void poll_free(uint32_t now) {
+  const uint64_t total = SD_MMC.totalBytes();
+  const uint64_t used = SD_MMC.usedBytes();
+  lock();
+  g_stats.card_total = total;
+  g_stats.card_free = total > used ? total - used : 0;
+  unlock();
+  g_last_poll = now;
+  g_polled = true;
+}
+
+// ---- reclaim: one category of one boot at a time ----
+
+struct Reclaim {
+  bool active;
+  bool walking;
+  uint32_t boot;
+  StorageCat cat;
+  const char* why;
+  uint32_t files;
+  uint64_t bytes;
+};
+
+static Reclaim g_job = {};
+static bool g_over[STORAGE_CATS] = {};   // reclaiming down to STORAGE_LOW_WATER
+static bool g_low = false;               // reclaiming whole boots for free space
+static uint32_t g_sweep_boot = 0;        // gone from the table; its empty dirs are next
+static size_t g_sweep_cat = 0;
+
+// Oldest boot other than the running one holding anything in c (or in any
+// category when c is Count); 0 when there is none.
+static uint32_t oldest_holding(StorageCat c, StorageCat* first) {
+  for (uint32_t i = 0; i < g_live.n; ++i) {
+    const BootUsage& u = g_live.b[i];
+    if (u.id == g_boot_id) continue;
+    for (size_t k = 0; k < STORAGE_CATS; ++k) {
+      if (!u.bytes[k] || (c != StorageCat::Count && (StorageCat)k != c)) continue;
+      *first = (StorageCat)k;
+      return u.id;
+    }
+  }
+  return 0;
+}
+
+static uint64_t cat_total(StorageCat c) {
+  uint64_t sum = 0;
+  for (uint32_t i = 0; i < g_live.n; ++i) sum += g_live.b[i].bytes[(size_t)c];
+  return sum;
+}
+
+static bool pick_job() {
+  StorageCat c = StorageCat::Count;
+  uint32_t boot = 0;
+  const char* why = nullptr;
+
+  // the directories a boot leaves behind once its files are gone
+  while (g_sweep_boot && g_sweep_cat < STORAGE_CATS && cat_is_file((StorageCat)g_sweep_cat)) g_sweep_cat++;
+  if (g_sweep_boot && g_sweep_cat == STORAGE_CATS) g_sweep_boot = 0;
+  if (g_sweep_boot) {
+    g_job = {};
+    g_job.active = true;
+    g_job.boot = g_sweep_boot;
+    g_job.cat = (StorageCat)g_sweep_cat++;
+    g_job.why = "sweep";
+    return true;
+  }
+
+  lock();
+  if (g_polled) {
+    const uint64_t free_now = g_stats.card_free;
+    if (free_now < STORAGE_MIN_FREE_BYTES) g_low = true;
+    else if (free_now >= (uint64_t)(STORAGE_MIN_FREE_BYTES / STORAGE_LOW_WATER)) g_low = false;
+  }
+  if (g_low) {
+    boot = oldest_holding(StorageCat::Count, &c);
+    why = "free";
+    if (!boot) g_low = false;   // nothing left to give
+  }
+  for (size_t i = 0; !boot && i < STORAGE_CATS; ++i) {
+    const StorageCat k = (StorageCat)i;
+    const uint64_t quota = cat_quota(k);
+    if (!quota) continue;
+    const uint64_t used = cat_total(k);
+    if (used > quota) g_over[i] = true;
+    else if (used <= (uint64_t)(quota * STORAGE_LOW_WATER)) g_over[i] = false;
+    if (!g_over[i]) continue;
+    boot = oldest_holding(k, &c);
+    why = "quota";
+    if (!boot) g_over[i] = false;   // the running boot alone is over
+  }
+  unlock();
+
+  if (!boot) return false;
+  g_job = {};
+  g_job.active = true;
+  g_job.boot = boot;
+  g_job.cat = c;
+  g_job.why = why;
+  return true;
+}
+
+static void job_finish() {
+  bool whole = false;
+  lock();
+  BootUsage* u = table_find(g_live, g_job.boot);
+  if (u) {
+    u->bytes[(size_t)g_job.cat] = 0;
+    if (usage_empty(*u)) {
+      memmove(u, u + 1, (size_t)(&g_live.b[g_live.n] - (u + 1)) * sizeof(BootUsage));
+      g_live.n--;
+      whole = true;
+    }
+  }
+  g_stats.files_reclaimed += g_job.files;
+  g_stats.bytes_reclaimed += g_job.bytes;
+  if (whole) g_stats.boots_reclaimed++;
+  g_stats.card_free += g_job.bytes;
+  unlock();
+
+  g_job.active = false;
+  if (whole) {
+    g_sweep_boot = g_job.boot;
+    g_sweep_cat = 0;
+  }
+  if (g_job.files) EVLOG(STORAGE_RECLAIM, storage_cat_name(g_job.cat), (unsigned long)g_job.boot,
+        (unsigned long)g_job.files, (unsigned long)(g_job.bytes >> 10), g_job.why);
+}
+
+// One file or directory of the current job.
+static void job_step() {
+  const StorageCat c = g_job.cat;
+  if (cat_is_file(c)) {
+    snprintf(g_path, sizeof(g_path), "%s/boot_%06lu.%s", cat_root(c), (unsigned long)g_job.boot,
+             c == StorageCat::Packs ? "pak" : "blg");
+    if (c == StorageCat::Packs) sd_pack_forget(g_job.boot);
+    File f = SD_MMC.open(g_path, FILE_READ);
+    const uint32_t size = f ? (uint32_t)f.size() : 0;
+    if (f) f.close();
+    if (size || SD_MMC.exists(g_path)) {
+      if (SD_MMC.remove(g_path)) { g_job.files++; g_job.bytes += size; }
+    }
+    job_finish();
+    return;
+  }
+
+  if (!g_job.walking) {
+    snprintf(g_path, sizeof(g_path), "%s/boot_%06lu", cat_root(c), (unsigned long)g_job.boot);
+    g_job.walking = walk_open(g_walk, g_path);
+    if (!g_job.walking) job_finish();   // gone already
+    return;
+  }
+
+  uint32_t size = 0;
+  switch (walk_next(g_walk, g_path, sizeof(g_path), &size)) {
+    case WalkStep::File:
+      if (SD_MMC.remove(g_path)) { g_job.files++; g_job.bytes += size; }
+      break;
+    case WalkStep::DirDone:
+      (void)SD_MMC.rmdir(g_path);
+      break;
+    case WalkStep::End:
+      g_job.walking = false;
+      job_finish();
+      break;
+  }
+}
+
+// ---- driver ----
+
+bool storage_begin() {
+  if (g_live.b) return true;
+  if (!g_st_mu) g_st_mu = xSemaphoreCreateMutex();
+  if (!g_st_mu || !table_alloc(g_live) || !table_alloc(g_next)) return false;
+  for (size_t i = 0; i < STORAGE_CATS; ++i) g_stats.cat[i].quota = cat_quota((StorageCat)i);
+  // the first free-space query of a large card walks the whole FAT and can
+  // take seconds; FATFS keeps the count from then on, so later polls from
+  // storage_step() are quick
+  if (g_sd_ok) poll_free(millis());
+  return true;
+}
+
+void storage_step(uint32_t gap_ms) {
+  if (!g_live.b || !g_sd_ok || gap_ms < STORAGE_MIN_GAP_MS) return;
+  const uint32_t t0 = millis();
+  if (g_stats.slices && t0 - g_last_slice < STORAGE_SLICE_EVERY_MS) return;
+  if (sd_writer_stats().queued_jobs) return;   // the card is busy with the pipeline's output
+  g_last_slice = t0;
+
+  // the running boot's pack grows in PACK_GROW_BYTES steps; it holds what its file does
+  const uint32_t pack_alloc = sd_pack_stats().alloc;
+  if (g_ready && pack_alloc) {
+    lock();
+    BootUsage* u = table_get(g_live, g_boot_id);
+    if (u) u->bytes[(size_t)StorageCat::Packs] = pack_alloc;
+    unlock();
+  }
+
+  // a poll gets a slice of its own
+  if (!g_polled || t0 - g_last_poll >= STORAGE_FREE_POLL_MS) {
+    poll_free(t0);
+  } else {
+    if (!g_census && !g_job.active && (!g_ready || t0 - g_last_census >= STORAGE_CENSUS_EVERY_MS))
+      census_start(t0);
+    while (millis() - t0 < STORAGE_SLICE_MS) {
+      if (g_census) {
+        if (!census_step(millis())) break;
+        continue;
+      }
+      if (!g_job.active && !pick_job()) break;
+      job_step();
+    }
+  }
+
+  lock();
+  g_stats.slices++;
+  g_stats.busy_ms += millis() - t0;
+  unlock();
+}
+
+StorageStats storage_stats() {
+  if (!g_st_mu) return {};
+  lock();
+  StorageStats s = g_stats;
+  s.ready = g_ready;
+  s.boots = g_live.n;
+  s.oldest_boot = g_live.n ? g_live.b[0].id : 0;
+  for (size_t i = 0; i < STORAGE_CATS; ++i) {
+    s.cat[i].bytes = 0;
+    s.cat[i].boots = 0;
+  }
+  for (uint32_t b = 0; b < g_live.n; ++b) {
+    for (size_t i = 0; i < STORAGE_CATS; ++i) {
+      s.cat[i].bytes += g_live.b[b].bytes[i];
+      if (g_live.b[b].bytes[i]) s.cat[i].boots++;
+    }
+  }
+  unlock();
+  return s;
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include "../globals.h"
+
+// Storage manager: keeps the card from filling over weeks of unattended
+// running. It knows what every boot holds in each category below, from a
+// census of the card plus what the SD writer reports writing, and reclaims
+// the oldest boots' files when a category goes over its STORAGE_QUOTA_* or
+// the card runs low (see the Storage section of app_config.h).
+//
+// All card work happens in storage_step(), one bounded slice at a time, so
+// a census or a reclaim spreads over as many gaps between cycles as it
+// needs and never holds up the next one.
+
+enum class StorageCat : uint8_t { Frames, Crops, BeeOverlays, Overlays, Packs, Logs, Count };
+
+static constexpr size_t STORAGE_CATS = (size_t)StorageCat::Count;
+
+struct StorageCatStats {
+  uint64_t bytes;   // all boots, running one included
+  uint64_t quota;   // 0: none
+  uint32_t boots;   // boots holding anything in this category
+};
+
+struct StorageStats {
+  bool     ready;            // a census has completed
+  uint64_t card_total;       // from the last free-space poll
+  uint64_t card_free;        // last poll, plus what was reclaimed since
+  uint32_t boots;
+  uint32_t oldest_boot;      // 0: none
+  uint32_t censuses;
+  uint32_t census_ms;        // wall time the last census spanned
+  uint32_t files_reclaimed;
+  uint64_t bytes_reclaimed;
+  uint32_t boots_reclaimed;  // boots removed from the card entirely
+  uint32_t slices;
+  uint32_t busy_ms;          // time spent inside slices
+  StorageCatStats cat[STORAGE_CATS];
+};
+
+// Allocates the boot tables; call once the boot session exists.
+bool storage_begin();
+
+// Does at most one slice of census or reclaim work. gap_ms is how long the
+// caller can spare before it needs the card and CPU back; too short a gap,
+// a busy SD writer or a slice taken too recently make it a no-op.
+void storage_step(uint32_t gap_ms);
+
+// SD writer task: len bytes just went to path. PACK_DIR stands for a blob
+// stored in the running boot's pack, which is counted by its file size.
+void storage_note_write(const char* path, size_t len);
+
+StorageStats storage_stats();
+const char* storage_cat_name(StorageCat c);
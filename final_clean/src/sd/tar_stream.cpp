@@ -0,0 +1,178 @@
+#include "tar_stream.h"
+
+static constexpr size_t TAR_BLOCK = 512;
+
+struct __attribute__((packed)) TarHeader {
+  char name[100];
+  char mode[8];
+  char uid[8];
+  char gid[8];
+  char size[12];
+  char mtime[12];
+  char chksum[8];
+  char typeflag;
+  char linkname[100];
+  char magic[6];
+  char version[2];
+  char uname[32];
+  char gname[32];
+  char devmajor[8];
+  char devminor[8];
+  char prefix[155];
+  char pad[12];
+};
+static_assert(sizeof(TarHeader) == TAR_BLOCK, "one tar block");
+
+bool tar_begin(TarStream& t, size_t cap, TarWriteFn out, void* arg) {
+  t = {};
+  t.cap = cap - cap % TAR_BLOCK;
+  if (t.cap < TAR_BLOCK || !out) return false;
+  // internal RAM first: the SD driver DMAs straight into it
+  t.buf = (uint8_t*)malloc(t.cap);
+  if (!t.buf) t.buf = (uint8_t*)ps_malloc(t.cap);
+  if (!t.buf) return false;
+  t.out = out;
+  t.arg = arg;
+  t.ok = true;
+  return true;
+}
+
+static bool flush(TarStream& t) {
+  if (t.ok && t.fill) {
+    t.ok = t.out(t.buf, t.fill, t.arg);
+    t.bytes += t.fill;
+  }
+  t.fill = 0;
+  return t.ok;
+}
+
+// Octal, zero-padded to width - 1 digits and NUL-terminated.
+static void put_octal(char* field, size_t width, uint64_t v) {
+  field[width - 1] = 0;
+  for (size_t i = width - 1; i-- > 0; v >>= 3) field[i] = (char)('0' + (v & 7u));
+}
+
+// Long names go into prefix + name, split at a '/'.
+static bool put_name(TarHeader& h, const char* name) {
+  const size_t n = strlen(name);
+  if (n < sizeof(h.name)) { memcpy(h.name, name, n); return true; }
+
+  for (const char* s = name + n - 1; s > name; --s) {
+    if (*s != '/') continue;
+    const size_t pre = (size_t)(s - name), rest = n - pre - 1;
+    if (pre <= sizeof(h.prefix) && rest && rest <= sizeof(h.name)) {
+      memcpy(h.prefix, name, pre);
+      memcpy(h.name, s + 1, rest);
+      return true;
+    }
+  }
+  return false;
+}
+
+static bool put_header(TarStream& t, const char* name, uint64_t size, time_t mtime) {
+  if (t.fill + TAR_BLOCK > t.cap && !flush(t)) return false;
+
+  TarHeader& h = *(TarHeader*)(t.buf + t.fill);
+  memset(&h, 0, sizeof(h));
+  if (!put_name(h, name)) return true;   // skipped, not fatal
+
+  put_octal(h.mode, sizeof(h.mode), 0644);
+  put_octal(h.uid, sizeof(h.uid), 0);
+  put_octal(h.gid, sizeof(h.gid), 0);
+  put_octal(h.size, sizeof(h.size), size);
+  put_octal(h.mtime, sizeof(h.mtime), mtime > 0 ? (uint64_t)mtime : 0);
+  h.typeflag = '0';
+  memcpy(h.magic, "ustar", 6);
+  memcpy(h.version, "00", 2);
+
+  memset(h.chksum, ' ', sizeof(h.chksum));
+  uint32_t sum = 0;
+  for (size_t i = 0; i < TAR_BLOCK; ++i) sum += ((const uint8_t*)&h)[i];
+  put_octal(h.chksum, 7, sum);   // six digits, NUL, then the space already there
+
+  t.fill += TAR_BLOCK;
+  return true;
+}
+
+bool tar_add_range(TarStream& t, File& f, size_t off, size_t size, const char* name, time_t mtime) {
+  if (!t.ok) return false;
+  const size_t fill_before = t.fill;
+  if (!put_header(t, name, size, mtime)) return false;
+  if (t.fill == fill_before) return true;   // name did not fit
+  const bool readable = !off || f.seek((uint32_t)off);   // if not, zeros keep the header true
+
+  // read straight into the buffer; a file that shrank is padded with zeros
+  // so the archive still matches its header
+  size_t left = size;
+  while (left && t.ok) {
+    if (t.fill == t.cap && !flush(t)) break;
+    size_t want = t.cap - t.fill;
+    if (want > left) want = left;
+    size_t n = readable ? f.read(t.buf + t.fill, want) : 0;
+    if (n < want) memset(t.buf + t.fill + n, 0, want - n);
+    t.fill += want;
+    left -= want;
+    delay(0);
+  }
+
+  const size_t tail = size % TAR_BLOCK;
+  if (t.ok && tail) {
+    // data ended mid-block: the block is in the buffer, zero its rest
+    const size_t pad = TAR_BLOCK - tail;
+    memset(t.buf + t.fill, 0, pad);
+    t.fill += pad;
+  }
+  if (t.ok) t.files++;
+  return t.ok;
+}
+
+bool tar_add_file(TarStream& t, const char* sd_path, const char* name) {
+  if (!t.ok) return false;
+  File f = SD_MMC.open(sd_path, FILE_READ);
+  if (!f || f.isDirectory()) { if (f) f.close(); return true; }
+  const bool ok = tar_add_range(t, f, 0, f.size(), name, f.getLastWrite());
+  f.close();
+  return ok;
+}
+
+bool tar_add_tree(TarStream& t, const char* sd_dir, const char* name_prefix, int max_depth) {
+  if (!t.ok) return false;
+  File dir = SD_MMC.open(sd_dir);
+  if (!dir || !dir.isDirectory()) { if (dir) dir.close(); return true; }
+
+  char path[160], name[200];
+  while (t.ok) {
+    File e = dir.openNextFile();
+    if (!e) break;
+    const char* nm = e.name();
+    const char* bn = nm ? strrchr(nm, '/') : nullptr;
+    bn = bn ? bn + 1 : (nm ? nm : "");
+    const bool is_dir = e.isDirectory();
+    const bool thumbs = !strcmp(bn, "thumbs");
+    const bool named = bn[0] != 0;
+    snprintf(path, sizeof(path), "%s/%s", sd_dir, bn);
+    snprintf(name, sizeof(name), "%s/%s", name_prefix, bn);
+    e.close();   // the name goes with it
+    if (!named) continue;
+
+    if (is_dir) {
+      if (max_depth > 0 && !thumbs) (void)tar_add_tree(t, path, name, max_depth - 1);
+    } else {
+      (void)tar_add_file(t, path, name);
+    }
+  }
+  dir.close();
+  return t.ok;
+}
+
+bool tar_end(TarStream& t) {
+  for (int i = 0; i < 2 && t.ok; ++i) {
+    if (t.fill + TAR_BLOCK > t.cap && !flush(t)) break;
+    memset(t.buf + t.fill, 0, TAR_BLOCK);
+    t.fill += TAR_BLOCK;
+  }
+  flush(t);
+  free(t.buf);
+  t.buf = nullptr;
+  return t.ok;
+}
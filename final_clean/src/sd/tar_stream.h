@@ -0,0 +1,41 @@
+#pragma once
+#include "../globals.h"
+
+// Writes a ustar archive of files on the card to a sink, through one fixed
+// buffer: headers and file data are packed into it and handed to the sink
+// whenever it fills, so memory stays constant whatever the archive size
+// and nothing is staged on the card. Files still growing are archived at
+// the size they had when opened.
+
+typedef bool (*TarWriteFn)(const uint8_t* p, size_t n, void* arg);
+
+struct TarStream {
+  uint8_t* buf;
+  size_t cap;      // a multiple of the 512-byte tar block
+  size_t fill;
+  TarWriteFn out;
+  void* arg;
+  bool ok;         // false once the sink refused data
+  uint32_t files;
+  uint64_t bytes;  // archive bytes handed to the sink
+};
+
+// cap is rounded down to whole blocks; false when no buffer could be had.
+bool tar_begin(TarStream& t, size_t cap, TarWriteFn out, void* arg);
+
+// Adds one file as `name` (relative, '/'-separated). A missing file is
+// skipped and still returns true; false only once the sink has failed.
+bool tar_add_file(TarStream& t, const char* sd_path, const char* name);
+
+// Adds size bytes of an open file from off as `name`: for members that
+// live inside a bigger file, like pack entries. f is left open.
+bool tar_add_range(TarStream& t, File& f, size_t off, size_t size, const char* name, time_t mtime);
+
+// Adds every file under sd_dir as name_prefix/..., descending at most
+// max_depth directory levels below it. Directories named "thumbs" are left
+// out: they are remade on demand.
+bool tar_add_tree(TarStream& t, const char* sd_dir, const char* name_prefix, int max_depth);
+
+// Writes the end-of-archive blocks, flushes and frees the buffer. The
+// buffer is freed whatever happened; the result says if the archive is whole.
+bool tar_end(TarStream& t);
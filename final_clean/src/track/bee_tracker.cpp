@@ -0,0 +1,144 @@
+#include "bee_tracker.h"
+#include "../log/evlog.h"
+
+struct Track {
+  uint32_t id;          // 0: free
+  float cx;
+  float cy;
+  uint32_t seen_ms;
+  uint32_t missed;      // processed frames since last seen
+  uint32_t checked_ms;
+  bool checked;
+  uint32_t mites;       // most seen on this bee
+  uint32_t bind_frame;
+  uint32_t bind_slot;
+  bool bound;
+};
+
+static Track g_tracks[TRACK_MAX];
+static uint32_t g_next_id = 1;
+static uint32_t g_credit_misses = 0;
+static portMUX_TYPE g_track_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static Track* track_find(uint32_t id) {
+  for (uint32_t i = 0; i < TRACK_MAX; ++i) if (g_tracks[i].id == id) return &g_tracks[i];
+  return nullptr;
+}
+
+// A free entry, else the one unseen for longest. Tracks waiting on a crop
+// result are kept; nullptr when every entry is.
+static Track* track_alloc() {
+  Track* oldest = nullptr;
+  for (uint32_t i = 0; i < TRACK_MAX; ++i) {
+    Track& t = g_tracks[i];
+    if (!t.id) return &t;
+    if (t.bound) continue;
+    if (!oldest || (int32_t)(t.seen_ms - oldest->seen_ms) < 0) oldest = &t;
+  }
+  return oldest;
+}
+
+TrackUpdate tracker_update(BeeDetections& dets, uint32_t now_ms, BeeDetections& todo) {
+  TrackUpdate u = {};
+  todo.count = 0;
+  bool claimed[TRACK_MAX] = {};
+  const float gate2 = TRACK_GATE_PX * TRACK_GATE_PX;
+
+  portENTER_CRITICAL(&g_track_mux);
+  for (uint32_t i = 0; i < TRACK_MAX; ++i) {
+    Track& t = g_tracks[i];
+    if (t.id && !t.bound && t.missed >= TRACK_EXPIRE_FRAMES) t.id = 0;
+  }
+
+  for (uint32_t i = 0; i < dets.count; ++i) {
+    BeeDetection& d = dets.items[i];
+
+    int best = -1;
+    float best_d2 = gate2;
+    for (uint32_t k = 0; k < TRACK_MAX; ++k) {
+      const Track& t = g_tracks[k];
+      if (!t.id || claimed[k]) continue;
+      const float dx = t.cx - d.cx, dy = t.cy - d.cy;
+      const float d2 = dx * dx + dy * dy;
+      if (d2 <= best_d2) { best = (int)k; best_d2 = d2; }
+    }
+
+    Track* t;
+    if (best >= 0) {
+      t = &g_tracks[best];
+    } else {
+      t = track_alloc();
+      if (!t) { d.track = 0; u.fresh++; continue; }   // counted, not tracked
+      *t = {};
+      t->id = g_next_id++;
+      if (!g_next_id) g_next_id = 1;
+      u.fresh++;
+    }
+    claimed[t - g_tracks] = true;
+    t->cx = d.cx;
+    t->cy = d.cy;
+    t->seen_ms = now_ms;
+    t->missed = 0;
+    d.track = t->id;
+
+    // one crop in flight per track
+    const bool due = !t->bound &&
+                     (!t->checked || (TRACK_RECHECK_MS && now_ms - t->checked_ms >= TRACK_RECHECK_MS));
+    if (due) todo.items[todo.count++] = d;
+  }
+
+  // misses are counted per processed frame, so the cycle period and frames
+  // the motion gate drops do not age a track
+  for (uint32_t i = 0; i < TRACK_MAX; ++i) {
+    Track& t = g_tracks[i];
+    if (!t.id) continue;
+    if (!claimed[i]) t.missed++;
+    u.live++;
+  }
+  portEXIT_CRITICAL(&g_track_mux);
+
+  u.classify = todo.count;
+  return u;
+}
+
+void tracker_bind(uint32_t track, uint32_t frame, uint32_t slot, uint32_t now_ms) {
+  portENTER_CRITICAL(&g_track_mux);
+  Track* t = track_find(track);
+  if (t) {
+    t->bind_frame = frame;
+    t->bind_slot = slot;
+    t->bound = true;
+    t->checked = true;
+    t->checked_ms = now_ms;
+  }
+  portEXIT_CRITICAL(&g_track_mux);
+}
+
+uint32_t tracker_credit(uint32_t frame, uint32_t slot, uint32_t mites) {
+  uint32_t add = 0, hits = 0, misses = 0;
+  portENTER_CRITICAL(&g_track_mux);
+  for (uint32_t i = 0; i < TRACK_MAX; ++i) {
+    Track& t = g_tracks[i];
+    if (!t.id || !t.bound || t.bind_frame != frame || t.bind_slot != slot) continue;
+    t.bound = false;
+    hits++;
+    if (mites > t.mites) { add += mites - t.mites; t.mites = mites; }
+  }
+  if (!hits) misses = ++g_credit_misses;
+  portEXIT_CRITICAL(&g_track_mux);
+
+  if (misses) EVLOG(TRACK_CREDIT_MISS, (unsigned long)frame, (unsigned long)slot,
+                    (unsigned long)mites, (unsigned long)misses);
+  return add;
+}
+
+void tracker_unbind(uint32_t frame) {
+  portENTER_CRITICAL(&g_track_mux);
+  for (uint32_t i = 0; i < TRACK_MAX; ++i) {
+    Track& t = g_tracks[i];
+    if (!t.id || !t.bound || t.bind_frame != frame) continue;
+    t.bound = false;
+    t.checked = false;   // no result came back: classify it again
+  }
+  portEXIT_CRITICAL(&g_track_mux);
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include "../globals.h"
+
+// Cross-frame bee tracks. Stage 1 centres (bee-model input coordinates) are
+// matched to the live tracks by nearest centroid within TRACK_GATE_PX. A bee
+// is counted when its track starts; stage 2 runs on it then and again every
+// TRACK_RECHECK_MS while the track lives. Tracks missing from
+// TRACK_EXPIRE_FRAMES processed frames in a row end, except while a crop of
+// theirs is still being classified. The capture side updates and binds, the
+// varroa side credits, so every call takes the tracker lock.
+
+struct TrackUpdate {
+  uint32_t fresh;      // tracks started this frame (bees to count)
+  uint32_t classify;   // detections due for stage 2
+  uint32_t live;       // tracks alive after the update
+};
+
+// Sets dets.items[i].track, and copies the detections due for stage 2 into
+// todo.
+TrackUpdate tracker_update(BeeDetections& dets, uint32_t now_ms, BeeDetections& todo);
+
+// Ties a track to the crop slot it is classified in; the track counts as
+// checked from now on.
+void tracker_bind(uint32_t track, uint32_t frame, uint32_t slot, uint32_t now_ms);
+
+// Stage 2 result for one crop. Each track bound to it keeps the most mites
+// it has been seen with; returns what that adds to the totals. A result no
+// track is bound to is logged as TRACK_CREDIT_MISS.
+uint32_t tracker_credit(uint32_t frame, uint32_t slot, uint32_t mites);
+
+// Frees the tracks still bound to frame's crops once those crops are done
+// with or dropped without a result; they are classified again when next
+// seen.
+void tracker_unbind(uint32_t frame);
@@ -0,0 +1,190 @@
+#include "live_stream.h"
+#include "sd_web_ui.h"
+#include "../overlay/overlay.h"
+#include "../log/evlog.h"
+#include "img_converters.h"
+#include <new>
+
+// Two slots: clients read the front one, the pipeline fills the other and
+// flips. A slot is only refilled once no client is still sending from it;
+// if a slow client pins the back slot, the new frame is dropped instead.
+struct LiveSlot {
+  uint8_t* jpg;
+  size_t len;
+  uint32_t frame;
+  uint32_t readers;
+};
+
+static LiveSlot g_slots[2] = {};
+static uint32_t g_front = 0;
+static uint32_t g_seq = 0;            // bumped on every flip
+static uint32_t g_last_publish_ms = 0;
+static uint8_t* g_scratch = nullptr;  // the drawn frame, bee input size
+static size_t g_scratch_bytes = 0;
+static LiveStreamStats g_stats = {};
+static portMUX_TYPE g_live_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static constexpr uint32_t NO_SLOT = 0xFFFFFFFFu;
+
+bool live_stream_begin() {
+  for (LiveSlot& s : g_slots) {
+    if (s.jpg) continue;
+    s.jpg = (uint8_t*)ps_malloc(LIVE_STREAM_MAX_BYTES);
+    if (!s.jpg) s.jpg = (uint8_t*)malloc(LIVE_STREAM_MAX_BYTES);
+    if (!s.jpg) return false;
+  }
+  return true;
+}
+
+bool live_stream_wanted(uint32_t now_ms) {
+  if (!g_slots[1].jpg) return false;
+  portENTER_CRITICAL(&g_live_mux);
+  const bool watched = g_stats.clients > 0;
+  portEXIT_CRITICAL(&g_live_mux);
+  return watched && (now_ms - g_last_publish_ms) >= 1000u / LIVE_STREAM_MAX_FPS;
+}
+
+void live_stream_publish(const uint8_t* bgr, int W, int H, const BeeDetections& dets, uint32_t frame) {
+  if (!bgr || !g_slots[1].jpg) return;
+  g_last_publish_ms = millis();
+
+  const size_t pixels = (size_t)W * (size_t)H;
+  if (g_scratch_bytes < pixels * 3u) {
+    free(g_scratch);
+    g_scratch_bytes = pixels * 3u;
+    g_scratch = (uint8_t*)ps_malloc(g_scratch_bytes);
+    if (!g_scratch) g_scratch = (uint8_t*)malloc(g_scratch_bytes);
+    if (!g_scratch) { g_scratch_bytes = 0; return; }
+  }
+
+  memcpy(g_scratch, bgr, pixels * 3u);
+  overlay_draw_bees(g_scratch, W, H, dets);   // on a copy: bgr is the model's input
+
+  uint8_t* jpg = nullptr;
+  size_t len = 0;
+  if (!fmt2jpg(g_scratch, pixels * 3u, (uint16_t)W, (uint16_t)H, PIXFORMAT_RGB888,
+               (uint8_t)LIVE_STREAM_QUALITY, &jpg, &len) || !jpg) {
+    free(jpg);
+    return;
+  }
+
+  // only this task writes slots, so the back one cannot gain readers while
+  // it is filled: clients only ever take the front one
+  portENTER_CRITICAL(&g_live_mux);
+  const uint32_t back = g_front ^ 1u;
+  const bool free_slot = g_slots[back].readers == 0;
+  if (!free_slot || len > LIVE_STREAM_MAX_BYTES) g_stats.dropped++;
+  portEXIT_CRITICAL(&g_live_mux);
+
+  if (free_slot && len <= LIVE_STREAM_MAX_BYTES) {
+    memcpy(g_slots[back].jpg, jpg, len);
+    portENTER_CRITICAL(&g_live_mux);
+    g_slots[back].len = len;
+    g_slots[back].frame = frame;
+    g_front = back;
+    g_seq++;
+    g_stats.published++;
+    g_stats.last_frame = frame;
+    g_stats.last_bytes = (uint32_t)len;
+    portEXIT_CRITICAL(&g_live_mux);
+  }
+  free(jpg);
+}
+
+// ---- clients ----
+
+struct StreamClient {
+  WiFiClient client;
+  uint32_t interval_ms;
+  uint32_t max_frames;
+};
+
+static constexpr const char* STREAM_BOUNDARY = "frame";
+
+static bool send_slot(WiFiClient& c, uint32_t idx) {
+  const LiveSlot& s = g_slots[idx];
+  char part[128];
+  const int n = snprintf(part, sizeof(part),
+                         "--%s\r\nContent-Type: image/jpeg\r\nContent-Length: %lu\r\nX-Frame: %lu\r\n\r\n",
+                         STREAM_BOUNDARY, (unsigned long)s.len, (unsigned long)s.frame);
+  return web_write_all(c, (const uint8_t*)part, (size_t)n) &&
+         web_write_all(c, s.jpg, s.len) &&
+         web_write_all(c, (const uint8_t*)"\r\n", 2);
+}
+
+static void stream_task(void* arg) {
+  StreamClient* sc = (StreamClient*)arg;
+  WiFiClient& c = sc->client;
+  c.setNoDelay(true);
+
+  char head[192];
+  const int n = snprintf(head, sizeof(head),
+                         "HTTP/1.1 200 OK\r\n"
+                         "Content-Type: multipart/x-mixed-replace; boundary=%s\r\n"
+                         "Cache-Control: no-store, no-cache, must-revalidate, max-age=0\r\n"
+                         "Connection: close\r\n\r\n", STREAM_BOUNDARY);
+  bool ok = web_write_all(c, (const uint8_t*)head, (size_t)n);
+
+  uint32_t seen = 0, sent = 0, last_ms = 0;
+  while (ok && c.connected() && (!sc->max_frames || sent < sc->max_frames)) {
+    if (sent && millis() - last_ms < sc->interval_ms) { vTaskDelay(pdMS_TO_TICKS(10)); continue; }
+
+    uint32_t idx = NO_SLOT;
+    portENTER_CRITICAL(&g_live_mux);
+    if (g_seq != seen && g_slots[g_front].len) {
+      idx = g_front;
+      seen = g_seq;
+      g_slots[idx].readers++;
+    }
+    portEXIT_CRITICAL(&g_live_mux);
+    if (idx == NO_SLOT) { vTaskDelay(pdMS_TO_TICKS(20)); continue; }
+
+    last_ms = millis();
+    ok = send_slot(c, idx);
+    sent++;
+
+    portENTER_CRITICAL(&g_live_mux);
+    g_slots[idx].readers--;
+    portEXIT_CRITICAL(&g_live_mux);
+  }
+
+  c.stop();
+  delete sc;
+  portENTER_CRITICAL(&g_live_mux);
+  g_stats.clients--;
+  portEXIT_CRITICAL(&g_live_mux);
+  EVLOG(LIVE_CLOSE, (unsigned long)sent);
+  vTaskDelete(nullptr);
+}
+
+bool live_stream_serve(const WiFiClient& client, uint32_t fps, uint32_t max_frames) {
+  if (!g_slots[1].jpg) return false;
+
+  portENTER_CRITICAL(&g_live_mux);
+  const bool room = g_stats.clients < LIVE_STREAM_MAX_CLIENTS;
+  if (room) g_stats.clients++;
+  portEXIT_CRITICAL(&g_live_mux);
+  if (!room) return false;
+
+  if (fps < 1) fps = 1;
+  if (fps > LIVE_STREAM_MAX_FPS) fps = LIVE_STREAM_MAX_FPS;
+  StreamClient* sc = new (std::nothrow) StreamClient{ client, 1000u / fps, max_frames };
+  if (sc && xTaskCreatePinnedToCore(stream_task, "stream", LIVE_STREAM_TASK_STACK, sc, 1,
+                                    nullptr, WEB_TASK_CORE) == pdPASS) {
+    EVLOG(LIVE_OPEN, (unsigned long)fps, (unsigned long)live_stream_stats().clients);
+    return true;
+  }
+
+  delete sc;
+  portENTER_CRITICAL(&g_live_mux);
+  g_stats.clients--;
+  portEXIT_CRITICAL(&g_live_mux);
+  return false;
+}
+
+LiveStreamStats live_stream_stats() {
+  portENTER_CRITICAL(&g_live_mux);
+  const LiveStreamStats s = g_stats;
+  portEXIT_CRITICAL(&g_live_mux);
+  return s;
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include "../globals.h"
+#include <WiFi.h>
+
+// Live view for /stream: the stage 1 input with the bee centres marked,
+// encoded into one of two PSRAM slots and sent to each watching client as
+// multipart/x-mixed-replace, without touching the card. Frames are only
+// drawn while someone is watching, at most LIVE_STREAM_MAX_FPS.
+
+struct LiveStreamStats {
+  uint32_t clients;
+  uint32_t published;
+  uint32_t dropped;     // encoded but both slots busy or too big
+  uint32_t last_frame;
+  uint32_t last_bytes;
+};
+
+bool live_stream_begin();
+
+// Pipeline side: true when a frame published now would be watched.
+bool live_stream_wanted(uint32_t now_ms);
+void live_stream_publish(const uint8_t* bgr, int W, int H, const BeeDetections& dets, uint32_t frame);
+
+// Web side: hands the client to a task of its own that sends a frame at
+// most every 1000/fps ms, stopping after max_frames when that is not 0.
+// False (and the client untouched) when the stream is full or unavailable.
+bool live_stream_serve(const WiFiClient& client, uint32_t fps, uint32_t max_frames);
+
+LiveStreamStats live_stream_stats();
@@ -2,6 +2,19 @@
 #include <WiFi.h>
 #include <WebServer.h>
 #include <SD_MMC.h>
+#include "../overlay/overlay.h"
+#include "../sd/manifest.h"
+#include "../metrics/metrics.h"
+#include "../camera/motion_gate.h"
+#include "../sched/scheduler.h"
+#include "../sd/sd_writer.h"
+#include "../sd/tar_stream.h"
+#include "../sd/sd_pack.h"
+#include "../sd/storage.h"
+#include "../log/evlog.h"
+#include "live_stream.h"
+#include "sse.h"
+#include <new>
 
 static WebServer server(80);
 
@@ -14,6 +27,36 @@ static inline void no_cache() {
   server.sendHeader("Expires", "0");
 }
 
+struct Validators {
+  char etag[32];
+  char modified[40];   // empty when the file has no usable time
+};
+
+// Images, thumbnails and closed sessions are written once under a name that
+// never gets reused, so browsers may keep them and revalidate by ETag after
+// max-age; files still growing (the current log) are revalidated every time.
+// Sends the validators for f; true when the request's copy is still current.
+static bool cache_headers(File& f, bool immutable, Validators& v) {
+  const time_t mtime = f.getLastWrite();
+  snprintf(v.etag, sizeof(v.etag), "\"%lx-%lx\"", (unsigned long)f.size(), (unsigned long)mtime);
+
+  v.modified[0] = 0;
+  struct tm tm;
+  if (mtime > 0 && gmtime_r(&mtime, &tm)) strftime(v.modified, sizeof(v.modified), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+
+  bool fresh = false;
+  if (server.hasHeader("If-None-Match")) fresh = server.header("If-None-Match").indexOf(v.etag) >= 0;
+  else if (v.modified[0] && server.hasHeader("If-Modified-Since")) fresh = server.header("If-Modified-Since") == v.modified;
+
+  char cc[40];
+  if (immutable) snprintf(cc, sizeof(cc), "public, max-age=%lu", (unsigned long)HTTP_CACHE_MAX_AGE_S);
+  else snprintf(cc, sizeof(cc), "no-cache");
+  server.sendHeader("Cache-Control", cc);
+  server.sendHeader("ETag", v.etag);
+  if (v.modified[0]) server.sendHeader("Last-Modified", v.modified);
+  return fresh;
+}
+
 static void json_chunk_begin() {
   no_cache();
   server.setContentLength(CONTENT_LENGTH_UNKNOWN);
@@ -30,6 +73,7 @@ static const char* mime_for(const char* path) {
   if (!strcasecmp(dot, ".bmp")) return "image/bmp";
   if (!strcasecmp(dot, ".jpg") || !strcasecmp(dot, ".jpeg")) return "image/jpeg";
   if (!strcasecmp(dot, ".png")) return "image/png";
+  if (!strcasecmp(dot, ".txt")) return "text/plain";
   return "application/octet-stream";
 }
 
@@ -44,7 +88,9 @@ static bool safe_path(const String& p) {
   if (!p.length() || p[0] != '/') return false;
   if (p.indexOf("..") >= 0) return false;
   // only allow these
-  return p.startsWith("/overlays/") || p.startsWith("/bee_overlays/");
+  return p.startsWith("/overlays/") || p.startsWith("/bee_overlays/") ||
+         p.startsWith("/frames/") || p.startsWith("/crops/") ||
+         p.startsWith(String(LOG_DIR) + "/");
 }
 
 static void handle_health() {
@@ -56,26 +102,119 @@ static void handle_health() {
 static void handle_state_get() {
   no_cache();
 
-  const uint32_t bees  = g_total_bees;
-  const uint32_t mites = g_total_mites;
+  const CountSnapshot c = counters_snapshot();
+  const uint32_t bees  = c.total_bees;
+  const uint32_t mites = c.total_mites;
   const double avg_w = (bees > 0) ? (100.0 * (double)mites / (double)bees) : 0.0;
 
-  char buf[160];
+  const SchedState s = sched_state();
+
+  char buf[320];
   snprintf(buf, sizeof(buf),
-           "{\"infer\":%s,\"save\":%s,\"bees\":%lu,\"mites\":%lu,\"avg_weighted\":%.2f}",
+           "{\"infer\":%s,\"save\":%s,\"bees\":%lu,\"mites\":%lu,\"avg_weighted\":%.2f,"
+           "\"sched\":{\"adaptive\":%s,\"mode\":\"%s\",\"period_ms\":%lu,\"fps\":%.2f,\"duty\":%.2f}}",
            g_infer_enabled ? "true" : "false",
            g_save_enabled  ? "true" : "false",
            (unsigned long)bees,
            (unsigned long)mites,
-           avg_w);
+           avg_w,
+           g_sched_adaptive ? "true" : "false",
+           sched_mode_name(s.mode), (unsigned long)s.period_ms, (double)s.fps, (double)s.duty);
 
   server.send(200, "application/json", buf);
 }
 
+// Stage latencies plus the writer, log, motion gate, pack and storage counters; ?reset=1 clears the
+// histograms after this snapshot.
+static void handle_metrics() {
+  json_chunk_begin();
+
+  char buf[256];
+  snprintf(buf, sizeof(buf),
+           "{\"uptime_ms\":%lu,\"frames\":%lu,\"infer_period_ms\":%lu,\"stages\":{",
+           (unsigned long)millis(), (unsigned long)g_frame_counter, (unsigned long)INFER_PERIOD_MS);
+  server.sendContent(buf);
+
+  for (size_t i = 0; i < (size_t)Metric::COUNT; ++i) {
+    const MetricSummary s = metrics_summary((Metric)i);
+    snprintf(buf, sizeof(buf),
+             "%s\"%s\":{\"count\":%lu,\"min_us\":%lu,\"avg_us\":%lu,\"p50_us\":%lu,"
+             "\"p95_us\":%lu,\"p99_us\":%lu,\"max_us\":%lu,\"total_ms\":%llu}",
+             i ? "," : "", metric_name((Metric)i),
+             (unsigned long)s.count, (unsigned long)s.min_us, (unsigned long)s.avg_us,
+             (unsigned long)s.p50_us, (unsigned long)s.p95_us, (unsigned long)s.p99_us,
+             (unsigned long)s.max_us, (unsigned long long)(s.total_us / 1000));
+    server.sendContent(buf);
+  }
+
+  const SdWriterStats w = sd_writer_stats();
+  snprintf(buf, sizeof(buf),
+           "},\"sd\":{\"jobs_done\":%lu,\"jobs_failed\":%lu,\"jobs_dropped\":%lu,"
+           "\"queued_jobs\":%lu,\"queued_bytes\":%lu,\"peak_jobs\":%lu,\"bytes_written\":%llu},"
+           "\"log_dropped\":%lu,",
+           (unsigned long)w.jobs_done, (unsigned long)w.jobs_failed, (unsigned long)w.jobs_dropped,
+           (unsigned long)w.queued_jobs, (unsigned long)w.queued_bytes, (unsigned long)w.peak_jobs,
+           (unsigned long long)w.bytes_written, (unsigned long)evlog_dropped());
+  server.sendContent(buf);
+
+  const MotionStats mo = motion_gate_stats();
+  snprintf(buf, sizeof(buf),
+           "\"motion\":{\"enabled\":%s,\"runs\":%lu,\"skips\":%lu,\"last_changed\":%.3f}",
+           MOTION_GATE ? "true" : "false",
+           (unsigned long)mo.runs, (unsigned long)mo.skips, (double)mo.last_changed);
+  server.sendContent(buf);
+
+  const PackStats pk = sd_pack_stats();
+  snprintf(buf, sizeof(buf),
+           ",\"pack\":{\"entries\":%lu,\"sealed\":%lu,\"failed\":%lu,\"data_end\":%lu,\"alloc\":%lu}",
+           (unsigned long)pk.entries, (unsigned long)pk.sealed, (unsigned long)pk.appends_failed,
+           (unsigned long)pk.data_end, (unsigned long)pk.alloc);
+  server.sendContent(buf);
+
+  const StorageStats st = storage_stats();
+  // two chunks: all of it at full width does not fit buf
+  snprintf(buf, sizeof(buf),
+           ",\"storage\":{\"ready\":%s,\"card_total\":%llu,\"card_free\":%llu,\"boots\":%lu,\"oldest_boot\":%lu,",
+           st.ready ? "true" : "false", (unsigned long long)st.card_total, (unsigned long long)st.card_free,
+           (unsigned long)st.boots, (unsigned long)st.oldest_boot);
+  server.sendContent(buf);
+  snprintf(buf, sizeof(buf),
+           "\"censuses\":%lu,\"census_ms\":%lu,\"files_reclaimed\":%lu,\"bytes_reclaimed\":%llu,"
+           "\"boots_reclaimed\":%lu,\"slices\":%lu,\"busy_ms\":%lu,\"cats\":{",
+           (unsigned long)st.censuses, (unsigned long)st.census_ms, (unsigned long)st.files_reclaimed,
+           (unsigned long long)st.bytes_reclaimed, (unsigned long)st.boots_reclaimed, (unsigned long)st.slices,
+           (unsigned long)st.busy_ms);
+  server.sendContent(buf);
+  for (size_t i = 0; i < STORAGE_CATS; ++i) {
+    snprintf(buf, sizeof(buf), "%s\"%s\":{\"bytes\":%llu,\"quota\":%llu,\"boots\":%lu}", i ? "," : "",
+             storage_cat_name((StorageCat)i), (unsigned long long)st.cat[i].bytes,
+             (unsigned long long)st.cat[i].quota, (unsigned long)st.cat[i].boots);
+    server.sendContent(buf);
+  }
+  server.sendContent("}}");
+
+  const LiveStreamStats lv = live_stream_stats();
+  snprintf(buf, sizeof(buf),
+           ",\"live\":{\"clients\":%lu,\"published\":%lu,\"dropped\":%lu,\"last_frame\":%lu,\"last_bytes\":%lu}}",
+           (unsigned long)lv.clients, (unsigned long)lv.published, (unsigned long)lv.dropped,
+           (unsigned long)lv.last_frame, (unsigned long)lv.last_bytes);
+  server.sendContent(buf);
+  json_chunk_end();
+
+  if (server.hasArg("reset") && server.arg("reset") != "0") metrics_reset();
+}
+
 static void handle_state_post() {
-  // infer=0/1 save=0/1 (query or form body)
+  // infer=0/1 save=0/1 sched=0/1 (query or form body)
   if (server.hasArg("infer")) g_infer_enabled = (server.arg("infer") != "0");
   if (server.hasArg("save"))  g_save_enabled  = (server.arg("save")  != "0");
+  if (server.hasArg("sched")) g_sched_adaptive = (server.arg("sched") != "0");
+
+  char json[64];
+  snprintf(json, sizeof(json), "{\"infer\":%s,\"save\":%s,\"sched\":%s}",
+           g_infer_enabled ? "true" : "false", g_save_enabled ? "true" : "false",
+           g_sched_adaptive ? "true" : "false");
+  (void)sse_publish("state", json);
   handle_state_get();
 }
 
@@ -146,6 +285,66 @@ static void handle_boots() {
   server.sendContent("");
 }
 
+// /api/images output. Without offset/limit/since the reply is the plain
+// array of every entry; with any of them it is one page:
+//   {"items":[{name,path,frame}...],"total":N,"offset":O,"count":C}
+// where total counts the entries after `since` (a frame number).
+struct ListCtx {
+  bool paged;
+  bool has_since;
+  uint32_t since;
+  uint32_t offset;
+  uint32_t limit;
+  uint32_t skip;    // entries still to skip for offset
+  uint32_t total;
+  uint32_t sent;
+  bool started;
+};
+
+static void list_start(ListCtx& c) {
+  if (c.started) return;
+  json_chunk_begin();
+  server.sendContent(c.paged ? "{\"items\":[" : "[");
+  c.started = true;
+}
+
+static void list_item(ListCtx& c, const char* name, const char* path, uint32_t frame) {
+  list_start(c);
+  char buf[288];
+  snprintf(buf, sizeof(buf), "%s{\"name\":\"%s\",\"path\":\"%s\",\"frame\":%lu}",
+           c.sent ? "," : "", name, path, (unsigned long)frame);
+  server.sendContent(buf);
+  c.sent++;
+}
+
+static void list_finish(ListCtx& c) {
+  list_start(c);
+  if (c.paged) {
+    char buf[96];
+    snprintf(buf, sizeof(buf), "],\"total\":%lu,\"offset\":%lu,\"count\":%lu}",
+             (unsigned long)c.total, (unsigned long)c.offset, (unsigned long)c.sent);
+    server.sendContent(buf);
+  } else {
+    server.sendContent("]");
+  }
+  json_chunk_end();
+}
+
+// Directory-walk listings (boots without a manifest): the file names start
+// with the frame number, which is what `since` filters on.
+static void list_walk_emit(const char* name, const char* path, void* arg) {
+  ListCtx* c = (ListCtx*)arg;
+  const uint32_t frame = (uint32_t)strtoul(name, nullptr, 10);
+  if (c->has_since && frame <= c->since) return;
+  c->total++;
+  if (c->skip) { c->skip--; return; }
+  if (c->sent < c->limit) list_item(*c, name, path, frame);
+}
+
+static uint32_t arg_u32(const char* name, uint32_t def) {
+  return server.hasArg(name) ? (uint32_t)strtoul(server.arg(name).c_str(), nullptr, 10) : def;
+}
+
 static void handle_images() {
   const char* base = root_to_base(server.hasArg("root") ? server.arg("root") : "");
   const String boot = server.hasArg("boot") ? server.arg("boot") : "";
@@ -157,17 +356,52 @@ static void handle_images() {
     return;
   }
 
-  String dirPath;
-  if (!strcmp(base, "/overlays")) {
-    const String chosen = sub.length() ? sub : "mite";
-    dirPath = String(base) + "/" + boot + "/" + chosen;
-  } else {
-    dirPath = String(base) + "/" + boot;
+  const bool bee = strcmp(base, "/overlays") != 0;
+  const String chosen = sub.length() ? sub : "mite";
+  const String dirPath = bee ? String(base) + "/" + boot : String(base) + "/" + boot + "/" + chosen;
+
+  ListCtx ctx = {};
+  ctx.paged = server.hasArg("offset") || server.hasArg("limit") || server.hasArg("since");
+  ctx.has_since = server.hasArg("since");
+  ctx.since = arg_u32("since", 0);
+  ctx.offset = ctx.skip = arg_u32("offset", 0);
+  ctx.limit = ctx.paged ? arg_u32("limit", MANIFEST_PAGE_MAX) : UINT32_MAX;
+  if (ctx.paged && (ctx.limit == 0 || ctx.limit > MANIFEST_PAGE_MAX)) ctx.limit = MANIFEST_PAGE_MAX;
+
+  // the manifest: one page costs a binary search plus the page itself
+  const ManifestList list = bee ? ManifestList::Bee
+                          : (chosen == "no_mite" ? ManifestList::NoMite : ManifestList::Mite);
+  static ManifestEntry page_buf[MANIFEST_PAGE_MAX];   // web task only
+  ManifestPage page;
+  uint32_t at = ctx.offset;
+  if (manifest_page(boot.c_str(), list, ctx.has_since, ctx.since, at,
+                    page_buf, ctx.limit < MANIFEST_PAGE_MAX ? ctx.limit : MANIFEST_PAGE_MAX, page)) {
+    ctx.total = page.total;
+    char path[192];
+    while (true) {
+      for (uint32_t i = 0; i < page.count; ++i) {
+        snprintf(path, sizeof(path), "%s/%s", dirPath.c_str(), page_buf[i].name);
+        list_item(ctx, page_buf[i].name, path, page_buf[i].frame);
+      }
+      at += page.count;
+      // unpaged: keep reading pages until the list is done
+      if (ctx.paged || page.count == 0 || at >= page.total) break;
+      if (!manifest_page(boot.c_str(), list, ctx.has_since, ctx.since, at,
+                         page_buf, MANIFEST_PAGE_MAX, page)) break;
+      delay(0);
+    }
+    list_finish(ctx);
+    return;
+  }
+
+  // boots with detection records list what they can render, cached or not
+  if (overlay_list(base, boot.c_str(), chosen.c_str(), list_walk_emit, &ctx)) {
+    list_finish(ctx);
+    return;
   }
 
   if (!SD_MMC.exists(dirPath)) {
-    no_cache();
-    server.send(200, "application/json", "[]");
+    list_finish(ctx);
     return;
   }
 
@@ -179,10 +413,7 @@ static void handle_images() {
     return;
   }
 
-  json_chunk_begin();
-  server.sendContent("[");
-  bool first = true;
-
+  char path[192];
   while (true) {
     File e = dir.openNextFile();
     if (!e) break;
@@ -193,16 +424,8 @@ static void handle_images() {
       bn = bn ? (bn + 1) : (nm ? nm : "");
 
       if (is_image(bn)) {
-        if (!first) server.sendContent(",");
-        first = false;
-
-        server.sendContent("{\"name\":\"");
-        server.sendContent(bn);
-        server.sendContent("\",\"path\":\"");
-        server.sendContent(dirPath.c_str());
-        server.sendContent("/");
-        server.sendContent(bn);
-        server.sendContent("\"}");
+        snprintf(path, sizeof(path), "%s/%s", dirPath.c_str(), bn);
+        list_walk_emit(bn, path, &ctx);
       }
     }
 
@@ -210,9 +433,8 @@ static void handle_images() {
     delay(0);
   }
 
-  server.sendContent("]");
   dir.close();
-  json_chunk_end();
+  list_finish(ctx);
 }
 
 static String normalize_path(String p) {
@@ -223,6 +445,221 @@ static String normalize_path(String p) {
   return p;
 }
 
+bool web_write_all(WiFiClient& c, const uint8_t* p, size_t n) {
+  uint32_t idle_since = millis();
+  while (n) {
+    const size_t w = c.write(p, n);
+    if (w) {
+      p += w;
+      n -= w;
+      idle_since = millis();
+      continue;
+    }
+    if (!c.connected() || millis() - idle_since > HTTP_WRITE_TIMEOUT_MS) return false;
+    delay(1);
+  }
+  return true;
+}
+
+enum class RangeKind : uint8_t { None, Ok, Unsatisfiable };
+
+// One "bytes=a-b" / "bytes=a-" / "bytes=-n" range. Multi-range requests and
+// other units are served whole (None), as RFC 9110 allows.
+static RangeKind parse_range(const String& h, size_t total, size_t& first, size_t& last) {
+  if (!h.startsWith("bytes=") || h.indexOf(',') >= 0) return RangeKind::None;
+  const char* spec = h.c_str() + 6;
+  const char* dash = strchr(spec, '-');
+  if (!dash) return RangeKind::None;
+
+  char* e = nullptr;
+  if (dash == spec) {
+    // suffix: the last n bytes
+    const unsigned long n = strtoul(dash + 1, &e, 10);
+    if (e == dash + 1 || *e) return RangeKind::None;
+    if (!n || !total) return RangeKind::Unsatisfiable;
+    first = (n >= total) ? 0 : total - n;
+    last = total - 1;
+    return RangeKind::Ok;
+  }
+
+  const unsigned long a = strtoul(spec, &e, 10);
+  if (e != dash) return RangeKind::None;
+  unsigned long b = (unsigned long)total - 1;
+  if (dash[1]) {
+    b = strtoul(dash + 1, &e, 10);
+    if (*e || b < a) return RangeKind::None;
+  }
+  if (a >= total) return RangeKind::Unsatisfiable;
+  first = a;
+  last = (b >= total) ? total - 1 : b;
+  return RangeKind::Ok;
+}
+
+// Sends [first, first + len) of f and closes it. Each request streams
+// through a buffer of its own. Internal RAM first: the SD driver DMAs
+// straight into it, where PSRAM goes through a bounce buffer one sector
+// at a time.
+static void stream_range(File& f, size_t first, size_t len) {
+  if (first && !f.seek((uint32_t)first)) { f.close(); return; }
+
+  size_t cap = HTTP_STREAM_CHUNK;
+  uint8_t* buf = (uint8_t*)malloc(cap);
+  if (!buf) buf = (uint8_t*)ps_malloc(cap);
+  if (!buf) { cap = SD_SECTOR_BYTES * 8u; buf = (uint8_t*)malloc(cap); }
+  if (!buf) { f.close(); return; }
+
+  WiFiClient c = server.client();
+  c.setNoDelay(true);
+  size_t left = len;
+  // the first read ends on a sector boundary so the rest are whole sectors
+  size_t want = cap - (first % SD_SECTOR_BYTES);
+  while (left) {
+    if (want > left) want = left;
+    const size_t n = f.read(buf, want);
+    if (!n) break;
+    if (!web_write_all(c, buf, n)) break;
+    left -= n;
+    want = cap;
+    delay(0);
+  }
+
+  free(buf);
+  f.close();
+}
+
+// Streams an open file, or the part of it a Range header asks for; 304 when
+// the browser's copy is current.
+static void send_file(File& f, const char* mime, bool immutable) {
+  Validators v;
+  if (cache_headers(f, immutable, v)) {
+    f.close();
+    server.send(304, mime, "");
+    return;
+  }
+
+  const size_t total = f.size();
+  size_t first = 0, last = total ? total - 1 : 0;
+  RangeKind range = RangeKind::None;
+  if (server.hasHeader("Range")) {
+    // If-Range: only resume what is still the same file
+    const String if_range = server.hasHeader("If-Range") ? server.header("If-Range") : String();
+    if (!if_range.length() || if_range == v.etag || (v.modified[0] && if_range == v.modified))
+      range = parse_range(server.header("Range"), total, first, last);
+  }
+
+  server.sendHeader("Accept-Ranges", "bytes");
+  if (range == RangeKind::Unsatisfiable) {
+    char cr[32];
+    snprintf(cr, sizeof(cr), "bytes */%lu", (unsigned long)total);
+    server.sendHeader("Content-Range", cr);
+    f.close();
+    server.send(416, "text/plain", "");
+    return;
+  }
+
+  if (strcmp(mime, "application/octet-stream") != 0) {
+    server.sendHeader("Content-Disposition", "inline");  // force display in <img>
+  } else {
+    const char* slash = strrchr(f.path(), '/');
+    char cd[96];
+    snprintf(cd, sizeof(cd), "attachment; filename=\"%s\"", slash ? slash + 1 : f.path());
+    server.sendHeader("Content-Disposition", cd);
+  }
+
+  const size_t len = total ? last - first + 1 : 0;
+  if (range == RangeKind::Ok) {
+    char cr[48];
+    snprintf(cr, sizeof(cr), "bytes %lu-%lu/%lu", (unsigned long)first, (unsigned long)last, (unsigned long)total);
+    server.sendHeader("Content-Range", cr);
+  }
+  server.setContentLength(len);
+  server.send(range == RangeKind::Ok ? 206 : 200, mime, ""); // headers only, body streamed below
+
+  stream_range(f, first, len);
+}
+
+// Sends a JPEG that was just drawn; it carries the validators of the copy
+// cached at cached_path, or no-cache headers when that write failed.
+static void send_rendered(const char* cached_path, const char* mime, const uint8_t* jpg, size_t len) {
+  File f = SD_MMC.open(cached_path, FILE_READ);
+  Validators v;
+  if (f && !f.isDirectory() && f.size() == len) (void)cache_headers(f, true, v);
+  else no_cache();
+  if (f) f.close();
+
+  server.sendHeader("Content-Disposition", "inline");
+  server.setContentLength(len);
+  server.send(200, mime, "");
+  WiFiClient c = server.client();
+  c.setNoDelay(true);
+  (void)web_write_all(c, jpg, len);
+}
+
+// A render that could not run now (the pipeline has the decoder) asks the
+// browser to come back instead of caching a miss.
+static void send_not_rendered(OverlayResult r) {
+  no_cache();
+  if (r == OverlayResult::Busy) {
+    server.sendHeader("Retry-After", String(OVERLAY_RETRY_AFTER_S));
+    server.send(503, "text/plain", "busy");
+    return;
+  }
+  server.send(404, "text/plain", "not found");
+}
+
+// Images and detection records never change once written; manifests and
+// logs keep growing while their session runs.
+static bool is_immutable(const String& p) {
+  if (is_image(p.c_str())) return true;
+  const char* dot = strrchr(p.c_str(), '.');
+  return dot && !strcasecmp(dot, ".det");
+}
+
+// Pack entries never change; the ETag is their place in the boot's pack.
+static void send_pack_entry(const char* boot, uint32_t id, const PackEntry& e) {
+  File f = sd_pack_open_read(boot);
+  if (!f) {
+    no_cache();
+    server.send(404, "text/plain", "not found");
+    return;
+  }
+
+  char etag[48], cc[40];
+  snprintf(etag, sizeof(etag), "\"%s-%lx-%lx\"", boot + 5, (unsigned long)id, (unsigned long)e.len);
+  snprintf(cc, sizeof(cc), "public, max-age=%lu", (unsigned long)HTTP_CACHE_MAX_AGE_S);
+  server.sendHeader("Cache-Control", cc);
+  server.sendHeader("ETag", etag);
+  const char* mime = mime_for(e.name);
+  if (server.hasHeader("If-None-Match") && server.header("If-None-Match").indexOf(etag) >= 0) {
+    f.close();
+    server.send(304, mime, "");
+    return;
+  }
+
+  if (is_image(e.name)) {
+    server.sendHeader("Content-Disposition", "inline");
+  } else {
+    const char* slash = strrchr(e.name, '/');
+    char cd[96];
+    snprintf(cd, sizeof(cd), "attachment; filename=\"%s\"", slash ? slash + 1 : e.name);
+    server.sendHeader("Content-Disposition", cd);
+  }
+  server.setContentLength(e.len);
+  server.send(200, mime, "");
+  stream_range(f, e.off, e.len);
+}
+
+// Serves a card path out of its boot's pack; false when it is not there.
+static bool send_packed(const char* path) {
+  char boot[16], name[sizeof(PackEntry::name)];
+  uint32_t id = 0;
+  PackEntry e;
+  if (!sd_pack_split_path(path, boot, sizeof(boot), name, sizeof(name)) ||
+      !sd_pack_find(boot, name, &id, e)) return false;
+  send_pack_entry(boot, id, e);
+  return true;
+}
+
 static void handle_sd_file() {
   String p = server.hasArg("path") ? server.arg("path") : "";
   p = normalize_path(p);
@@ -233,36 +670,280 @@ static void handle_sd_file() {
     return;
   }
 
+  const char* mime = mime_for(p.c_str());
+
   File f = SD_MMC.open(p, FILE_READ);
-  if (!f || f.isDirectory()) {
-    if (f) f.close();
+  if (f && !f.isDirectory()) {
+    send_file(f, mime, is_immutable(p));
+    return;
+  }
+  if (f) f.close();
+  if (send_packed(p.c_str())) return;
+
+  // overlays are drawn on first view; later views hit the cached copy
+  uint8_t* jpg = nullptr;
+  size_t len = 0;
+  const OverlayResult r = overlay_render(p.c_str(), &jpg, &len);
+  if (r == OverlayResult::Ok) {
+    send_rendered(p.c_str(), mime, jpg, len);
+    free(jpg);
+    return;
+  }
+  send_not_rendered(r);
+}
+
+static void handle_thumb() {
+  String p = server.hasArg("path") ? server.arg("path") : "";
+  p = normalize_path(p);
+
+  char tpath[192];
+  if (!safe_path(p) || !is_image(p.c_str()) || !overlay_thumb_path(p.c_str(), tpath, sizeof(tpath))) {
+    no_cache();
+    server.send(403, "text/plain", "forbidden");
+    return;
+  }
+
+  File f = SD_MMC.open(tpath, FILE_READ);
+  if (f && !f.isDirectory()) {
+    send_file(f, "image/jpeg", true);
+    return;
+  }
+  if (f) f.close();
+  if (send_packed(tpath)) return;
+
+  uint8_t* jpg = nullptr;
+  size_t len = 0;
+  const OverlayResult r = overlay_thumb(p.c_str(), &jpg, &len);
+  if (r == OverlayResult::Ok) {
+    send_rendered(tpath, "image/jpeg", jpg, len);
+    free(jpg);
+    return;
+  }
+  send_not_rendered(r);
+}
+
+
+// ---- packs ----
+
+static bool valid_boot_name(const String& b) {
+  if (!b.startsWith("boot_") || b.length() < 6 || b.length() > 16) return false;
+  for (size_t i = 5; i < b.length(); ++i) if (!isdigit((unsigned char)b[i])) return false;
+  return true;
+}
+
+// /api/pack?boot=boot_N[&prefix=crops/][&offset=&limit=]:
+//   {"items":[{id,name,frame,len}...],"total":N,"offset":O,"count":C}
+// with total counting the entries under prefix. /pack?boot=&id= serves one.
+struct PackListCtx {
+  uint32_t offset;
+  uint32_t limit;
+  uint32_t total;
+  uint32_t sent;
+};
+
+static void pack_list_emit(uint32_t id, const PackEntry& e, void* arg) {
+  PackListCtx& c = *(PackListCtx*)arg;
+  if (c.total++ < c.offset || c.sent >= c.limit) return;
+  char buf[160];
+  snprintf(buf, sizeof(buf), "%s{\"id\":%lu,\"name\":\"%s\",\"frame\":%lu,\"len\":%lu}",
+           c.sent ? "," : "", (unsigned long)id, e.name, (unsigned long)e.frame, (unsigned long)e.len);
+  server.sendContent(buf);
+  c.sent++;
+}
+
+static void handle_pack_list() {
+  const String boot = server.hasArg("boot") ? server.arg("boot") : "";
+  const String prefix = server.hasArg("prefix") ? server.arg("prefix") : "";
+  uint32_t count = 0;
+  if (!valid_boot_name(boot) || !sd_pack_count(boot.c_str(), &count)) {
+    no_cache();
+    server.send(404, "application/json", "{\"error\":\"no pack\"}");
+    return;
+  }
+
+  PackListCtx c = { arg_u32("offset", 0), arg_u32("limit", MANIFEST_PAGE_MAX), 0, 0 };
+  if (c.limit > MANIFEST_PAGE_MAX) c.limit = MANIFEST_PAGE_MAX;
+  json_chunk_begin();
+  server.sendContent("{\"items\":[");
+  (void)sd_pack_list(boot.c_str(), prefix.length() ? prefix.c_str() : nullptr, pack_list_emit, &c);
+  char buf[96];
+  snprintf(buf, sizeof(buf), "],\"total\":%lu,\"offset\":%lu,\"count\":%lu}",
+           (unsigned long)c.total, (unsigned long)c.offset, (unsigned long)c.sent);
+  server.sendContent(buf);
+  json_chunk_end();
+}
+
+static void handle_pack_entry() {
+  const String boot = server.hasArg("boot") ? server.arg("boot") : "";
+  PackEntry e;
+  const uint32_t id = arg_u32("id", 0xFFFFFFFFu);
+  if (!valid_boot_name(boot) || !server.hasArg("id") || !sd_pack_get(boot.c_str(), id, e)) {
     no_cache();
     server.send(404, "text/plain", "not found");
     return;
   }
+  send_pack_entry(boot.c_str(), id, e);
+}
 
-  const char* mime = mime_for(p.c_str());
-  const size_t total = f.size();
+// ---- /api/export ----
 
-  no_cache();
-  server.sendHeader("Content-Disposition", "inline");  // force display in <img>
-  server.setContentLength(total);
-  server.send(200, mime, ""); // headers only, body streamed below
+// The archive goes out as it is written, without framing: the response
+// ends when the connection closes, which HTTP/1.0 and 1.1 clients read
+// alike. A cut-off archive lacks tar's end blocks, which tar reports.
+static bool export_write(const uint8_t* p, size_t n, void* arg) {
+  return web_write_all(*(WiFiClient*)arg, p, n);
+}
 
-  WiFiClient c = server.client();
+// Pack entries under one tree, as the files they stand in for.
+struct ExportPackCtx {
+  TarStream* tar;
+  File* pack;
+  const char* tree;
+  const char* boot;
+};
+
+static void export_pack_entry(uint32_t, const PackEntry& e, void* arg) {
+  ExportPackCtx& x = *(ExportPackCtx*)arg;
+  if (strstr(e.name, "/thumbs/")) return;
+  char name[96];
+  snprintf(name, sizeof(name), "%s/%s%s", x.tree, x.boot, e.name + strlen(x.tree));
+  (void)tar_add_range(*x.tar, *x.pack, e.off, e.len, name, x.pack->getLastWrite());
+}
+
+static const char* const EXPORT_TREES[] = { "frames", "crops", "bee_overlays", "overlays" };
+
+struct ExportJob {
+  WiFiClient c;
+  char boot[17];
+  char root[16];   // "all", "logs" or one of EXPORT_TREES
+};
+
+static uint32_t g_exports = 0;
+static portMUX_TYPE g_export_mux = portMUX_INITIALIZER_UNLOCKED;
+
+// Adds the parts of the session job asks for.
+static void export_session(TarStream& tar, const ExportJob& job) {
+  const bool all = !strcmp(job.root, "all");
+  char path[64], name[64];
+  File pack = sd_pack_open_read(job.boot);
+  for (const char* t : EXPORT_TREES) {
+    if (!all && strcmp(job.root, t)) continue;
+    snprintf(path, sizeof(path), "/%s/%s", t, job.boot);
+    (void)tar_add_tree(tar, path, path + 1, EXPORT_MAX_DEPTH);
+    if (pack) {
+      snprintf(name, sizeof(name), "%s/", t);
+      ExportPackCtx x = { &tar, &pack, t, job.boot };
+      (void)sd_pack_list(job.boot, name, export_pack_entry, &x);
+    }
+  }
+  if (pack) pack.close();
+  if (all || !strcmp(job.root, "logs")) {
+    snprintf(path, sizeof(path), "%s/%s.blg", LOG_DIR, job.boot);
+    snprintf(name, sizeof(name), "%s", path + 1);
+    (void)tar_add_file(tar, path, name);
+  }
+}
+
+static void export_task(void* arg) {
+  ExportJob* job = (ExportJob*)arg;
+  WiFiClient& c = job->c;
+  const bool all = !strcmp(job->root, "all");
+  const uint32_t t0 = millis();
   c.setNoDelay(true);
-  static uint8_t buf[8192];
-  while (f.available()) {
-    size_t n = f.read(buf, sizeof(buf));
-    if (!n) break;
-    size_t w = c.write(buf, n);
-    if (w != n) break;
-    delay(0);
+
+  char head[320];
+  TarStream tar;
+  if (!tar_begin(tar, HTTP_STREAM_CHUNK, export_write, &c)) {
+    const int n = snprintf(head, sizeof(head),
+                           "HTTP/1.1 503 Service Unavailable\r\n"
+                           "Content-Type: text/plain\r\n"
+                           "Connection: close\r\n\r\n"
+                           "out of memory");
+    (void)web_write_all(c, (const uint8_t*)head, (size_t)n);
+  } else {
+    const int n = snprintf(head, sizeof(head),
+                           "HTTP/1.1 200 OK\r\n"
+                           "Content-Type: application/x-tar\r\n"
+                           "Content-Disposition: attachment; filename=\"%s%s%s.tar\"\r\n"
+                           "Cache-Control: no-store, no-cache, must-revalidate, max-age=0\r\n"
+                           "Connection: close\r\n\r\n",
+                           job->boot, all ? "" : "_", all ? "" : job->root);
+    const bool sent = web_write_all(c, (const uint8_t*)head, (size_t)n);
+    if (sent) export_session(tar, *job);
+    const bool ok = tar_end(tar) && sent;
+    EVLOG(EXPORT_DONE, job->boot, (unsigned long)tar.files, (unsigned long)tar.bytes,
+          (unsigned long)(millis() - t0), (unsigned)ok);
   }
 
-  f.close();
+  c.stop();
+  delete job;
+  portENTER_CRITICAL(&g_export_mux);
+  g_exports--;
+  portEXIT_CRITICAL(&g_export_mux);
+  vTaskDelete(nullptr);
 }
 
+// Streams one boot session as a tar, laid out as on the card
+// (frames/boot_N/..., logs/boot_N.blg; pack entries as the files they
+// replace), straight from the files: nothing is staged and memory use does
+// not grow with the session. ?root= narrows it to one of frames, crops,
+// bee_overlays, overlays or logs. The archive is written by a task of its
+// own, so a long export does not hold up the rest of the UI.
+static void handle_export() {
+  const String boot = server.hasArg("boot") ? server.arg("boot") : "";
+  const String root = server.hasArg("root") ? server.arg("root") : "all";
+  bool known = root == "all" || root == "logs";
+  for (const char* t : EXPORT_TREES) known = known || root == t;
+  if (!valid_boot_name(boot) || !known) {
+    no_cache();
+    server.send(400, "application/json", "{\"error\":\"bad boot or root\"}");
+    return;
+  }
+
+  portENTER_CRITICAL(&g_export_mux);
+  const bool room = g_exports < EXPORT_MAX_CLIENTS;
+  if (room) g_exports++;
+  portEXIT_CRITICAL(&g_export_mux);
+
+  ExportJob* job = room ? new (std::nothrow) ExportJob{ server.client(), {}, {} } : nullptr;
+  if (job) {
+    snprintf(job->boot, sizeof(job->boot), "%s", boot.c_str());
+    snprintf(job->root, sizeof(job->root), "%s", root.c_str());
+    if (xTaskCreatePinnedToCore(export_task, "export", EXPORT_TASK_STACK, job, 1,
+                                nullptr, WEB_TASK_CORE) == pdPASS) return;
+    delete job;
+  }
+  if (room) {
+    portENTER_CRITICAL(&g_export_mux);
+    g_exports--;
+    portEXIT_CRITICAL(&g_export_mux);
+  }
+  no_cache();
+  server.send(503, "text/plain", "export busy or unavailable");
+}
+
+// Hands the connection to an event stream task. Browsers resume with
+// Last-Event-ID; ?last_id= does the same for clients that cannot set it.
+static void handle_events() {
+  const bool has_last = server.hasHeader("Last-Event-ID") || server.hasArg("last_id");
+  const uint32_t last = server.hasHeader("Last-Event-ID")
+    ? (uint32_t)strtoul(server.header("Last-Event-ID").c_str(), nullptr, 10)
+    : arg_u32("last_id", 0);
+  if (!sse_serve(server.client(), has_last, last)) {
+    no_cache();
+    server.send(503, "text/plain", "event stream busy or unavailable");
+  }
+}
+
+// Hands the connection to a stream task; this task goes back to serving.
+static void handle_stream() {
+  const uint32_t fps = arg_u32("fps", LIVE_STREAM_MAX_FPS);
+  const uint32_t frames = arg_u32("frames", 0);
+  if (!live_stream_serve(server.client(), fps, frames)) {
+    no_cache();
+    server.send(503, "text/plain", "live view busy or unavailable");
+  }
+}
 
 static void handle_root() {
   static const char PAGE[] PROGMEM = R"HTML(
@@ -283,6 +964,7 @@ static void handle_root() {
   .item{padding:10px 12px;border-bottom:1px solid #f2f2f2;cursor:pointer;display:flex;gap:8px;align-items:center}
   .item:hover{background:#fafafa}
   .item.active{background:#eef6ff}
+  .item img.thumb{width:48px;height:48px;object-fit:cover;border-radius:6px;flex:none}
   .tag{font-size:12px;color:#666;border:1px solid #ddd;border-radius:999px;padding:2px 8px;white-space:nowrap}
   .name{font-size:13px;color:#111;word-break:break-all}
 
@@ -306,6 +988,7 @@ static void handle_root() {
   <button id="start">Start infer+save</button>
   <button id="stop">Stop (browse SD)</button>
   <button id="refresh">Refresh</button>
+  <button id="live">Live view</button>
   <span class="pill" id="state">state: ...</span>
 </header>
 
@@ -371,9 +1054,28 @@ static void handle_root() {
 <script>
 const qs = id => document.getElementById(id);
 
+// Images are immutable once written: no cache-buster, so the browser keeps
+// them and revalidates with the ETag.
 function sdUrl(path){
   const enc = encodeURIComponent(path).replace(/%2F/gi, "/");
-  return "/sd?path=" + enc + "&t=" + Date.now();
+  return "/sd?path=" + enc;
+}
+
+function thumbUrl(path){
+  const enc = encodeURIComponent(path).replace(/%2F/gi, "/");
+  return "/thumb?path=" + enc;
+}
+
+// Overlays and thumbnails not drawn yet come back 503 while the pipeline
+// has the decoder: load url into img, asking again a few times before
+// giving up with failed().
+function loadImg(img, url, failed){
+  let tries = 0;
+  img.onerror = () => {
+    if(++tries > 3){ if(failed) failed(); return; }
+    setTimeout(() => { img.src = url + "&retry=" + tries; }, 1000 * tries);
+  };
+  img.src = url;
 }
 
 async function jget(url){
@@ -400,15 +1102,20 @@ function fmtPct(x){
   return n.toFixed(2) + "%";
 }
 
-async function loadState(){
-  const st = await jget("/api/state?t="+Date.now());
+function showState(st){
   qs("state").textContent = `state: infer=${st.infer} save=${st.save}`;
+}
 
-  // Stats
+function showStats(st){
   qs("statBees").textContent  = String(st.bees ?? 0);
   qs("statMites").textContent = String(st.mites ?? 0);
   qs("statAvg").textContent   = fmtPct(st.avg_weighted ?? 0);
+}
 
+async function loadState(){
+  const st = await jget("/api/state?t="+Date.now());
+  showState(st);
+  showStats(st);
   return st;
 }
 
@@ -441,15 +1148,17 @@ function renderList(items){
     row.className = "item" + (it.path === g_activePath ? " active" : "");
     row.onclick = () => selectItem(it);
 
-    const tag = document.createElement("div");
-    tag.className = "tag";
-    tag.textContent = "img";
+    const thumb = document.createElement("img");
+    thumb.className = "thumb";
+    thumb.loading = "lazy";
+    thumb.alt = "";
+    loadImg(thumb, thumbUrl(it.path), null);
 
     const name = document.createElement("div");
     name.className = "name";
     name.textContent = it.path;
 
-    row.appendChild(tag);
+    row.appendChild(thumb);
     row.appendChild(name);
     list.appendChild(row);
   }
@@ -457,6 +1166,20 @@ function renderList(items){
 
 let g_imgLoading = false;
 
+// Live view for aiming and focusing; any list click replaces it.
+function showLive(){
+  g_activePath = "";
+  renderList(g_items);
+  qs("viewerPath").textContent = "live: stage 1 input, bee centres marked";
+  const area = qs("viewerArea");
+  area.innerHTML = "";
+  const img = document.createElement("img");
+  img.alt = "live";
+  img.onerror = () => { area.innerHTML = `<div class="hint">Live view unavailable (busy, or inference is off).</div>`; };
+  img.src = "/stream";
+  area.appendChild(img);
+}
+
 function selectItem(it){
   g_activePath = it.path;
   renderList(g_items);
@@ -470,21 +1193,26 @@ function selectItem(it){
 
   g_imgLoading = true;
   img.onload = () => { g_imgLoading = false; };
-  img.onerror = () => {
+  loadImg(img, sdUrl(it.path), () => {
     g_imgLoading = false;
     area.innerHTML = `<div class="hint">Failed to load image.<br>${it.path}</div>`;
-  };
-
-  img.src = sdUrl(it.path);
+  });
   area.appendChild(img);
 }
 
-async function loadImagesList(){
+let g_listKey = "";
+let g_maxFrame = -1;
+
+// Fetches only what is newer than the newest frame already listed, one page
+// at a time; reset (or another root/boot/sub) starts from scratch.
+async function loadImagesList(reset){
   const root = qs("rootSel").value;
   const boot = qs("bootSel").value;
   const sub  = qs("subSel").value;
 
   if(!boot){
+    g_listKey = "";
+    g_maxFrame = -1;
     g_items = [];
     g_activePath = "";
     renderList([]);
@@ -493,13 +1221,25 @@ async function loadImagesList(){
     return;
   }
 
-  let url = `/api/images?root=${encodeURIComponent(root)}&boot=${encodeURIComponent(boot)}&t=${Date.now()}`;
+  const key = `${root}|${boot}|${sub}`;
+  if(reset || key !== g_listKey){ g_listKey = key; g_maxFrame = -1; g_items = []; }
+
+  let url = `/api/images?root=${encodeURIComponent(root)}&boot=${encodeURIComponent(boot)}&limit=200`;
   if(root === "overlays") url += `&sub=${encodeURIComponent(sub)}`;
+  if(g_maxFrame >= 0) url += `&since=${g_maxFrame}`;
+
+  const fresh = [];
+  for(let off = 0;;){
+    const pg = await jget(`${url}&offset=${off}&t=${Date.now()}`);
+    fresh.push(...pg.items);
+    off += pg.count;
+    if(!pg.count || off >= pg.total) break;
+  }
+  for(const it of fresh) if(it.frame > g_maxFrame) g_maxFrame = it.frame;
 
-  const items = await jget(url);
-  g_items = items;
-  if(g_activePath && !items.some(x => x.path === g_activePath)) g_activePath = "";
-  renderList(items);
+  g_items = g_items.concat(fresh);
+  if(g_activePath && !g_items.some(x => x.path === g_activePath)) g_activePath = "";
+  renderList(g_items);
 }
 
 function syncSubUi(){
@@ -512,26 +1252,63 @@ async function refreshAll(){
   await loadState();
   syncSubUi();
   await loadBoots();
-  await loadImagesList();
+  await loadImagesList(true);
 }
 
 qs("start").onclick = async()=>{ await postState(true,true); await refreshAll(); };
 qs("stop").onclick  = async()=>{ await postState(false,false); await refreshAll(); };
 qs("refresh").onclick = async()=>{ await refreshAll(); };
+qs("live").onclick = showLive;
+
+qs("rootSel").onchange = async()=>{ g_activePath=""; syncSubUi(); await loadBoots(); await loadImagesList(true); };
+qs("bootSel").onchange = async()=>{ g_activePath=""; await loadImagesList(true); };
+qs("subSel").onchange  = async()=>{ g_activePath=""; await loadImagesList(true); };
+
+// New manifest entries for the listing on screen are appended as they come.
+function onImages(d){
+  const root = qs("rootSel").value;
+  if(d.root !== root || d.boot !== qs("bootSel").value) return;
+  if(root === "overlays" && d.sub !== qs("subSel").value) return;
+  if(!g_listKey) return;
+
+  const fresh = d.items.filter(it => it.frame > g_maxFrame);
+  if(!fresh.length) return;
+  for(const it of fresh) if(it.frame > g_maxFrame) g_maxFrame = it.frame;
+  g_items = g_items.concat(fresh);
+  renderList(g_items);
+}
 
-qs("rootSel").onchange = async()=>{ g_activePath=""; syncSubUi(); await loadBoots(); await loadImagesList(); };
-qs("bootSel").onchange = async()=>{ g_activePath=""; await loadImagesList(); };
-qs("subSel").onchange  = async()=>{ g_activePath=""; await loadImagesList(); };
+// The device pushes counts, new images and state changes over /api/events;
+// the 8 s poll below only runs while that stream is down.
+let g_eventsUp = false;
+
+function startEvents(){
+  if(!window.EventSource) return;
+  const es = new EventSource("/api/events");
+  es.onopen = () => {
+    g_eventsUp = true;
+    loadState().catch(()=>{});
+    loadImagesList(false).catch(()=>{});   // whatever arrived while it was down
+  };
+  es.onerror = () => { g_eventsUp = false; };   // the browser reconnects with Last-Event-ID
+  es.addEventListener("cycle",  e => showStats(JSON.parse(e.data)));
+  es.addEventListener("state",  e => showState(JSON.parse(e.data)));
+  es.addEventListener("images", e => onImages(JSON.parse(e.data)));
+  es.addEventListener("resync", () => { loadState().catch(()=>{}); loadImagesList(false).catch(()=>{}); });
+}
 
 setInterval(async()=>{
+  if(g_eventsUp) return;
   try{
     const st = await loadState();
-    if(!st.infer && !st.save && !g_imgLoading){
-      await loadImagesList();
+    if(!g_imgLoading){
+      await loadImagesList(false);
     }
   }catch{}
 }, 8000);
 
+startEvents();
+
 refreshAll();
 </script>
 </body></html>
@@ -545,24 +1322,44 @@ refreshAll();
 // COMMUNICATION — Web UI (Wi-Fi AP + HTTP server)
 // =============================================================
 // The ESP32 runs as an Access Point (AP_SSID, open password) and hosts a
-// lightweight HTTP UI used for:
+// lightweight HTTP UI, served from its own task (ui_web.cpp), used for:
 //
 // 1) Control plane:
-//    - POST /api/state with infer=0/1 and save=0/1
-//      -> toggles g_infer_enabled and g_save_enabled
+//    - POST /api/state with infer=0/1, save=0/1 and sched=0/1
+//      -> toggles g_infer_enabled, g_save_enabled and g_sched_adaptive
 //
 // 2) Telemetry (live stats):
 //    - GET /api/state returns JSON:
-//        { infer, save, bees, mites, avg_weighted }
+//        { infer, save, bees, mites, avg_weighted, sched }
+//
+//    - GET /api/events Server-Sent Events: "cycle" counts per frame,
+//      "images" new manifest entries, "state" flag changes (sse.h)
+//
+//    - GET /api/metrics returns per-stage latency histograms
+//        { stages: { cycle: { count, min_us, avg_us, p50_us, p95_us, p99_us, max_us }, ... }, sd, ... }
 //
 // 3) Data browsing:
 //    - GET /api/boots  lists boot session folders
-//    - GET /api/images lists images within selected boot session
-//    - GET /sd?path=... streams images from SD for preview
+//    - GET /api/images lists images within selected boot session, from
+//      the boot's manifest; offset/limit/since (frame number) page it
+//    - GET /sd?path=... streams images from SD for preview; overlays are
+//      drawn from the frame and its detection record on first request and
+//      cached at that path
+//    - GET /sd?path=/frames/... and /logs/... download raw frames, detection
+//      records and session logs; Range requests get 206 so they resume
+//    - GET /thumb?path=... a small copy of the same image for the list,
+//      made on first request and cached under thumbs/ next to it
+//    - GET /stream[?fps=N&frames=N] live MJPEG of the stage 1 input with
+//      the bee centres, from RAM; each client runs on a task of its own
+//
+// Caching:
+//    - images and thumbnails carry ETag / Last-Modified and a max-age, and
+//      get 304 when the browser's copy is current.
+//    - everything else (JSON, the page) is sent with no-cache headers.
 //
 // Safety:
-//    - safe_path() restricts SD file serving to /overlays and /bee_overlays.
-//    - no-cache headers prevent stale UI views.
+//    - safe_path() restricts SD file serving to /overlays, /bee_overlays,
+//      /frames and /logs, and refuses "..".
 // =============================================================
 
 
@@ -582,14 +1379,24 @@ void sd_web_ui_begin() {
   server.on("/api/health", HTTP_GET, handle_health);
   server.on("/api/state", HTTP_GET, handle_state_get);
   server.on("/api/state", HTTP_POST, handle_state_post);
+  server.on("/api/metrics", HTTP_GET, handle_metrics);
   server.on("/api/boots", HTTP_GET, handle_boots);
   server.on("/api/images", HTTP_GET, handle_images);
   server.on("/sd", HTTP_GET, handle_sd_file);
+  server.on("/thumb", HTTP_GET, handle_thumb);
+  server.on("/stream", HTTP_GET, handle_stream);
+  server.on("/api/events", HTTP_GET, handle_events);
+  server.on("/api/export", HTTP_GET, handle_export);
+  server.on("/api/pack", HTTP_GET, handle_pack_list);
+  server.on("/pack", HTTP_GET, handle_pack_entry);
   server.onNotFound([](){
     no_cache();
     server.send(404, "text/plain", "not found");
   });
 
+  static const char* REQ_HEADERS[] = { "If-None-Match", "If-Modified-Since", "Range", "If-Range", "Last-Event-ID" };
+  server.collectHeaders(REQ_HEADERS, sizeof(REQ_HEADERS) / sizeof(REQ_HEADERS[0]));
+
   server.begin();
   Serial.println("[WEB] server started");
 }
@@ -1,11 +1,11 @@
 #pragma once
-#include <stdint.h>
-
-extern volatile bool g_infer_enabled;
-extern volatile bool g_save_enabled;
-
-extern volatile uint32_t g_total_bees;
-extern volatile uint32_t g_total_mites;
+#include "../globals.h"
+#include <WiFi.h>
 
 void sd_web_ui_begin();
-void sd_web_ui_loop();
\ No newline at end of file
+void sd_web_ui_loop();
+
+// Writes all n bytes, waiting out a full socket buffer: a short write only
+// means the client is slower than the card. False once the client is gone
+// or has taken nothing for HTTP_WRITE_TIMEOUT_MS.
+bool web_write_all(WiFiClient& c, const uint8_t* p, size_t n);
@@ -0,0 +1,209 @@
+#include "sse.h"
+#include "sd_web_ui.h"
+#include "../log/evlog.h"
+#include <new>
+
+// Each slot holds one event already framed for the wire
+// ("id: N\nevent: T\ndata: {...}\n\n"), so a client copies it out and
+// writes it as is. Slot of id N is N % SSE_RING_EVENTS; ids start at 1.
+struct SseSlot {
+  uint32_t id;
+  uint16_t len;
+  char text[SSE_EVENT_MAX];
+};
+
+static SseSlot* g_ring = nullptr;
+static uint32_t g_next_id = 1;
+static SseStats g_stats = {};
+static portMUX_TYPE g_sse_mux = portMUX_INITIALIZER_UNLOCKED;
+
+bool sse_begin() {
+  if (g_ring) return true;
+  const size_t bytes = sizeof(SseSlot) * SSE_RING_EVENTS;
+  g_ring = (SseSlot*)ps_malloc(bytes);
+  if (!g_ring) g_ring = (SseSlot*)malloc(bytes);
+  if (!g_ring) return false;
+  memset(g_ring, 0, bytes);
+  return true;
+}
+
+bool sse_publish(const char* type, const char* json) {
+  if (!g_ring || !type || !json) return false;
+
+  // framed outside the lock; the id is zero-padded to a fixed width so it
+  // can be filled in under it without moving anything
+  char text[SSE_EVENT_MAX];
+  const int head = snprintf(text, sizeof(text), "id: %010lu\nevent: %s\ndata: ", 0ul, type);
+  const int n = snprintf(text + head, sizeof(text) - head, "%s\n\n", json);
+  if (head <= 0 || n <= 0 || (size_t)(head + n) >= sizeof(text)) return false;
+
+  portENTER_CRITICAL(&g_sse_mux);
+  const uint32_t id = g_next_id++;
+  SseSlot& s = g_ring[id % SSE_RING_EVENTS];
+  uint32_t v = id;
+  for (int k = 4 + 9; k >= 4; --k, v /= 10) text[k] = (char)('0' + v % 10);
+  memcpy(s.text, text, (size_t)(head + n));
+  s.len = (uint16_t)(head + n);
+  s.id = id;
+  g_stats.published++;
+  g_stats.last_id = id;
+  portEXIT_CRITICAL(&g_sse_mux);
+  return true;
+}
+
+// ---- clients ----
+
+struct SseClient {
+  WiFiClient client;
+  uint32_t last_id;
+};
+
+enum class SseNext : uint8_t { None, Event, Resync };
+
+// Copies the first event after last into out.
+static SseNext next_event(uint32_t last, SseSlot& out) {
+  SseNext r = SseNext::None;
+  portENTER_CRITICAL(&g_sse_mux);
+  const uint32_t newest = g_next_id - 1;
+  const uint32_t oldest = newest >= SSE_RING_EVENTS ? newest - SSE_RING_EVENTS + 1 : 1;
+  if (last < newest) {
+    if (last + 1 < oldest) {
+      out.id = oldest - 1;
+      r = SseNext::Resync;
+    } else {
+      const SseSlot& s = g_ring[(last + 1) % SSE_RING_EVENTS];
+      out.id = s.id;
+      out.len = s.len;
+      memcpy(out.text, s.text, s.len);
+      r = SseNext::Event;
+    }
+  }
+  portEXIT_CRITICAL(&g_sse_mux);
+  return r;
+}
+
+static bool write_str(WiFiClient& c, const char* s) {
+  return web_write_all(c, (const uint8_t*)s, strlen(s));
+}
+
+static void sse_task(void* arg) {
+  SseClient* sc = (SseClient*)arg;
+  WiFiClient& c = sc->client;
+  c.setNoDelay(true);
+
+  bool ok = write_str(c, "HTTP/1.1 200 OK\r\n"
+                         "Content-Type: text/event-stream\r\n"
+                         "Cache-Control: no-store, no-cache, must-revalidate, max-age=0\r\n"
+                         "Connection: close\r\n\r\n"
+                         "retry: 3000\n\n");
+
+  static_assert(sizeof(SseSlot) <= 1024, "one slot on the client task's stack");
+  SseSlot ev;
+  uint32_t last = sc->last_id, sent = 0, last_write_ms = millis();
+  while (ok && c.connected()) {
+    const SseNext n = next_event(last, ev);
+    if (n == SseNext::Event) {
+      ok = web_write_all(c, (const uint8_t*)ev.text, ev.len);
+      last = ev.id;
+      sent++;
+    } else if (n == SseNext::Resync) {
+      // fell out of the ring: the page reloads what it shows instead
+      char msg[48];
+      snprintf(msg, sizeof(msg), "id: %010lu\nevent: resync\ndata: {}\n\n", (unsigned long)ev.id);
+      ok = write_str(c, msg);
+      last = ev.id;
+    } else {
+      if (millis() - last_write_ms >= SSE_KEEPALIVE_MS) {
+        ok = write_str(c, ": ping\n\n");   // finds dead clients, keeps proxies open
+        last_write_ms = millis();
+      }
+      vTaskDelay(pdMS_TO_TICKS(SSE_POLL_MS));
+      continue;
+    }
+    last_write_ms = millis();
+  }
+
+  c.stop();
+  delete sc;
+  portENTER_CRITICAL(&g_sse_mux);
+  g_stats.clients--;
+  portEXIT_CRITICAL(&g_sse_mux);
+  EVLOG(SSE_CLOSE, (unsigned long)sent, (unsigned long)last);
+  vTaskDelete(nullptr);
+}
+
+bool sse_serve(const WiFiClient& client, bool has_last_id, uint32_t last_id) {
+  if (!g_ring) return false;
+
+  portENTER_CRITICAL(&g_sse_mux);
+  const bool room = g_stats.clients < SSE_MAX_CLIENTS;
+  if (room) g_stats.clients++;
+  const uint32_t newest = g_next_id - 1;
+  portEXIT_CRITICAL(&g_sse_mux);
+  if (!room) return false;
+
+  if (!has_last_id) last_id = newest;
+  else if (last_id > newest) last_id = 0;   // an id from before a reboot: start this boot over
+  SseClient* sc = new (std::nothrow) SseClient{ client, last_id };
+  if (sc && xTaskCreatePinnedToCore(sse_task, "sse", SSE_TASK_STACK, sc, 1,
+                                    nullptr, WEB_TASK_CORE) == pdPASS) {
+    EVLOG(SSE_OPEN, (unsigned long)last_id, (unsigned long)sse_stats().clients);
+    return true;
+  }
+
+  delete sc;
+  portENTER_CRITICAL(&g_sse_mux);
+  g_stats.clients--;
+  portEXIT_CRITICAL(&g_sse_mux);
+  return false;
+}
+
+SseStats sse_stats() {
+  portENTER_CRITICAL(&g_sse_mux);
+  const SseStats s = g_stats;
+  portEXIT_CRITICAL(&g_sse_mux);
+  return s;
+}
+
+// In the item form /api/images uses; split over as many events as it takes.
+void sse_publish_images(ManifestList l, const ManifestEntry* e, uint32_t n) {
+  if (!n) return;
+  const char* dir = l == ManifestList::Bee  ? g_bee_overlays_dir
+                  : l == ManifestList::Mite ? g_overlays_mite_dir
+                                            : g_overlays_nomite_dir;
+  const char* root = l == ManifestList::Bee ? "bee_overlays" : "overlays";
+  const char* sub  = l == ManifestList::Bee ? "" : l == ManifestList::Mite ? OVERLAY_MITE_SUBDIR : OVERLAY_NO_MITE_SUBDIR;
+  const char* boot = strrchr(g_frames_dir, '/');
+  boot = boot ? boot + 1 : g_frames_dir;
+
+  // the longest item: both names and the deepest listing dir at full length
+  static constexpr size_t ITEM_MAX = 2 * sizeof(ManifestEntry::name) + sizeof(g_overlays_mite_dir) + 48;
+  char json[SSE_EVENT_MAX - 48];   // leaves room for the id/event framing
+  static_assert(sizeof(json) >= ITEM_MAX + 160, "an SSE event must hold the header and one item");
+  const int head = snprintf(json, sizeof(json), "{\"root\":\"%s\",\"sub\":\"%s\",\"boot\":\"%.*s\",\"items\":[",
+                            root, sub, (int)(sizeof(g_frames_dir) - 1), boot);
+  if (head <= 0 || (size_t)head + ITEM_MAX + 3 > sizeof(json)) return;
+  size_t at = (size_t)head;
+  uint32_t in_event = 0;
+  for (uint32_t i = 0; i < n; ++i) {
+    char item[ITEM_MAX];
+    const int m = snprintf(item, sizeof(item), "%s{\"name\":\"%s\",\"path\":\"%s/%s\",\"frame\":%lu}",
+                           in_event ? "," : "", e[i].name, dir, e[i].name, (unsigned long)e[i].frame);
+    if (m <= 0 || (size_t)m >= sizeof(item)) continue;
+    if (in_event && at + (size_t)m + 3 > sizeof(json)) {
+      memcpy(json + at, "]}", 3);
+      (void)sse_publish("images", json);
+      at = (size_t)head;
+      in_event = 0;
+      --i;   // again, without the leading comma
+      continue;
+    }
+    memcpy(json + at, item, (size_t)m);
+    at += (size_t)m;
+    in_event++;
+  }
+  if (in_event) {
+    memcpy(json + at, "]}", 3);
+    (void)sse_publish("images", json);
+  }
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include "../globals.h"
+#include "../sd/manifest.h"
+#include <WiFi.h>
+
+// Server-Sent Events for the web UI (/api/events). Producers format a small
+// JSON payload and publish it under an event type; it is stamped with an id
+// and kept in a ring of the last SSE_RING_EVENTS, from which every client
+// task sends what it has not seen yet. A reconnecting browser sends
+// Last-Event-ID and gets what it missed, or a "resync" event when that has
+// already left the ring.
+//
+// Event types:
+//   cycle   one frame's counts and the running totals
+//   images  manifest entries just added to one listing of the current boot
+//   state   infer/save/sched flags after a change
+
+struct SseStats {
+  uint32_t clients;
+  uint32_t published;
+  uint32_t last_id;
+};
+
+bool sse_begin();
+
+// Callable from any task; json must fit SSE_EVENT_MAX with its framing.
+bool sse_publish(const char* type, const char* json);
+
+// An "images" event for entries just added to a listing of this boot.
+void sse_publish_images(ManifestList l, const ManifestEntry* e, uint32_t n);
+
+// Hands the client to a task of its own that sends every event after
+// last_id (from Last-Event-ID; 0 for only what comes next).
+// False (and the client untouched) when full or unavailable.
+bool sse_serve(const WiFiClient& client, bool has_last_id, uint32_t last_id);
+
+SseStats sse_stats();
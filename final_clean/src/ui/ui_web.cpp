@@ -1,11 +1,28 @@
 #include "ui_web.h"
 #include "sd_web_ui.h"
 
-void web_begin() {
+// WebServer is not thread-safe: only one task may pump it. Normally that is
+// the web task on WEB_TASK_CORE; if it cannot be started, loop() pumps the
+// server between cycles instead.
+static TaskHandle_t g_web_task = nullptr;
+static bool g_web_own_task = false;
+
+static void web_task(void*) {
+  while (true) {
+    sd_web_ui_loop();
+    vTaskDelay(1);
+  }
+}
+
+bool web_begin() {
   sd_web_ui_begin();
+  g_web_own_task = xTaskCreatePinnedToCore(web_task, "web", WEB_TASK_STACK, nullptr, 1,
+                                           &g_web_task, WEB_TASK_CORE) == pdPASS;
+  if (!g_web_own_task) g_web_task = xTaskGetCurrentTaskHandle();
   g_web_started = true;
+  return g_web_own_task;
 }
 
 void web_pump() {
-  if (g_web_started) sd_web_ui_loop();
+  if (g_web_started && !g_web_own_task && xTaskGetCurrentTaskHandle() == g_web_task) sd_web_ui_loop();
 }
@@ -1,5 +1,7 @@
 #pragma once
 #include "../globals.h"
 
-void web_begin();
+// Starts the Wi-Fi AP and the HTTP server task; false when the task could
+// not be created and loop() has to pump the server itself.
+bool web_begin();
 void web_pump();
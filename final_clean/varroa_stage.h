@@ -1,5 +1,8 @@
 #pragma once
 #include "src/globals.h"
 #include <merge_b.h>
+#include "src/crops/crop_queue.h"
+#include "src/overlay/det_record.h"
 
-uint32_t varroa_run_on_new_crops_and_count();
+// Mite boxes of every crop are appended to rec.
+uint32_t varroa_run_on_batch_and_count(const CropBatch& batch, DetRecord& rec);
@@ -0,0 +1,196 @@
+// Host simulation driver: runs the real setup()/loop() over replayed frames
+// and reports end-to-end throughput plus per-stage timing.
+#include <Arduino.h>
+#include <SD_MMC.h>
+#include <esp_camera.h>
+#include <merge_b.h>
+#include <sys/stat.h>
+#include <chrono>
+#include <WebServer.h>
+#include <string>
+#include <vector>
+
+#include "../final_clean/src/globals.h"
+#include "sim_timing.h"
+#include <img_converters.h>
+
+void setup();
+void loop();
+void pipeline_drain();
+
+extern bool g_sim_serial_quiet;
+
+static void usage(const char* argv0) {
+  fprintf(stderr,
+    "usage: %s --frames DIR --sd DIR [--bee-fixture F] [--varroa-fixture F]\n"
+    "          [--bee-ms N] [--varroa-ms N] [--period-ms N] [--repeat N] [--no-save] [--adaptive] [--quiet]\n"
+    "          [--header 'Name: value']... [--get URI OUT]...\n"
+    "       %s --synth-frames DIR N\n",
+    argv0, argv0);
+}
+
+// Writes N textured SXGA frames so the pipeline can be exercised without camera captures.
+static int synth_frames(const char* dir, int n) {
+  mkdir(dir, 0755);
+  const int W = FULL_W, H = FULL_H;
+  uint8_t* px = (uint8_t*)malloc((size_t)W * H * 3);
+  for (int f = 0; f < n; ++f) {
+    for (int y = 0; y < H; ++y) {
+      for (int x = 0; x < W; ++x) {
+        uint8_t* p = px + ((size_t)y * W + x) * 3;
+        const int blob = ((x + f * 9) / 40 + y / 40) & 1;
+        p[0] = (uint8_t)(60 + (x * 3 + y) % 64);
+        p[1] = (uint8_t)(90 + blob * 70);
+        p[2] = (uint8_t)(120 + ((x ^ y) & 31));
+      }
+    }
+    uint8_t* jpg = nullptr; size_t len = 0;
+    if (!fmt2jpg(px, (size_t)W * H * 3, W, H, PIXFORMAT_RGB888, 80, &jpg, &len)) { free(px); return 1; }
+    char path[512];
+    snprintf(path, sizeof(path), "%s/%06d.jpg", dir, f);
+    FILE* out = fopen(path, "wb");
+    if (out) { fwrite(jpg, 1, len, out); fclose(out); }
+    free(jpg);
+  }
+  free(px);
+  printf("wrote %d frames to %s\n", n, dir);
+  return 0;
+}
+
+// Issues GET uri (path?k=v&...) against the sketch's web server after the run
+// and writes the response body to out; prints the status line and the
+// response headers.
+static void http_get(const char* uri, const char* out_path, const std::map<std::string, std::string>& headers) {
+  std::string path = uri, query;
+  const size_t q = path.find('?');
+  if (q != std::string::npos) { query = path.substr(q + 1); path.resize(q); }
+
+  std::map<std::string, std::string> args;
+  size_t p = 0;
+  while (p < query.size()) {
+    size_t amp = query.find('&', p);
+    if (amp == std::string::npos) amp = query.size();
+    const std::string kv = query.substr(p, amp - p);
+    const size_t eq = kv.find('=');
+    if (eq == std::string::npos) args[kv] = "";
+    else args[kv.substr(0, eq)] = kv.substr(eq + 1);
+    p = amp + 1;
+  }
+
+  std::string raw;
+  int code = sim_http_request(HTTP_GET, path.c_str(), args, raw, headers);
+  if (!code && !raw.compare(0, 9, "HTTP/1.1 ")) code = atoi(raw.c_str() + 9);   // written raw by a handler's task
+  const size_t hdr_end = raw.find("\r\n\r\n");
+  std::string head = raw.substr(0, hdr_end), body = (hdr_end == std::string::npos) ? "" : raw.substr(hdr_end + 4);
+
+  if (head.find("Transfer-Encoding: chunked") != std::string::npos) {
+    std::string plain;
+    size_t at = 0;
+    while (at < body.size()) {
+      const size_t eol = body.find("\r\n", at);
+      if (eol == std::string::npos) break;
+      const size_t n = strtoul(body.substr(at, eol - at).c_str(), nullptr, 16);
+      if (!n) break;
+      plain += body.substr(eol + 2, n);
+      at = eol + 2 + n + 2;
+    }
+    body = plain;
+  }
+
+  FILE* f = fopen(out_path, "wb");
+  if (f) { fwrite(body.data(), 1, body.size(), f); fclose(f); }
+  printf("GET %s -> %d (%zu bytes)\n", uri, code, body.size());
+  size_t at = head.find("\r\n");
+  while (at != std::string::npos && at < head.size()) {
+    const size_t eol = head.find("\r\n", at + 2);
+    printf("  %s\n", head.substr(at + 2, (eol == std::string::npos ? head.size() : eol) - at - 2).c_str());
+    at = eol;
+  }
+}
+
+struct SimGet {
+  const char* uri;
+  const char* out;
+  std::map<std::string, std::string> headers;
+};
+
+int main(int argc, char** argv) {
+  const char* frames_dir = nullptr;
+  const char* sd_dir = nullptr;
+  const char* bee_fx = nullptr;
+  const char* var_fx = nullptr;
+  uint32_t bee_ms = 0, var_ms = 0, period_ms = 0, repeat = 1;
+  bool save = true, adaptive = false;
+  std::vector<SimGet> gets;
+  std::map<std::string, std::string> headers;   // sent with every later --get
+
+  if (argc == 4 && !strcmp(argv[1], "--synth-frames")) return synth_frames(argv[2], atoi(argv[3]));
+
+  for (int i = 1; i < argc; ++i) {
+    const char* a = argv[i];
+    auto next = [&]() -> const char* { return (i + 1 < argc) ? argv[++i] : nullptr; };
+    if      (!strcmp(a, "--frames"))         frames_dir = next();
+    else if (!strcmp(a, "--sd"))             sd_dir = next();
+    else if (!strcmp(a, "--bee-fixture"))    bee_fx = next();
+    else if (!strcmp(a, "--varroa-fixture")) var_fx = next();
+    else if (!strcmp(a, "--bee-ms"))         bee_ms = (uint32_t)atoi(next());
+    else if (!strcmp(a, "--varroa-ms"))      var_ms = (uint32_t)atoi(next());
+    else if (!strcmp(a, "--period-ms"))      period_ms = (uint32_t)atoi(next());
+    else if (!strcmp(a, "--repeat"))         repeat = (uint32_t)atoi(next());
+    else if (!strcmp(a, "--no-save"))        save = false;
+    else if (!strcmp(a, "--adaptive"))       adaptive = true;
+    else if (!strcmp(a, "--quiet"))          g_sim_serial_quiet = true;
+    else if (!strcmp(a, "--get") && i + 2 < argc) { gets.push_back({ argv[i + 1], argv[i + 2], headers }); i += 2; }
+    else if (!strcmp(a, "--header") && i + 1 < argc) {
+      const std::string h = argv[++i];
+      const size_t colon = h.find(':');
+      if (colon == std::string::npos) { usage(argv[0]); return 2; }
+      const size_t v = h.find_first_not_of(' ', colon + 1);
+      headers[h.substr(0, colon)] = (v == std::string::npos) ? "" : h.substr(v);
+    }
+    else { usage(argv[0]); return 2; }
+  }
+  if (!frames_dir || !sd_dir) { usage(argv[0]); return 2; }
+
+  mkdir(sd_dir, 0755);
+  sim_fs_set_root(sd_dir);
+  if (!sim_camera_open_dir(frames_dir, false)) {
+    fprintf(stderr, "no .jpg frames in %s\n", frames_dir);
+    return 1;
+  }
+  if (bee_fx && !sim_ei_load_bee_fixture(bee_fx)) { fprintf(stderr, "bad bee fixture %s\n", bee_fx); return 1; }
+  if (var_fx && !sim_ei_load_varroa_fixture(var_fx)) { fprintf(stderr, "bad varroa fixture %s\n", var_fx); return 1; }
+  sim_ei_set_latency_ms(bee_ms, var_ms);
+
+  setup();
+  sim_camera_open_dir(frames_dir, false);  // camera_init_ei() drained warm-up frames
+
+  g_infer_enabled = true;
+  g_save_enabled = save;
+  INFER_PERIOD_MS = period_ms;
+  g_sched_adaptive = adaptive;
+
+  sim_timing_reset();
+  const auto t0 = std::chrono::steady_clock::now();
+  uint32_t frames = 0;
+
+  for (uint32_t r = 0; r < repeat; ++r) {
+    if (r > 0) sim_camera_open_dir(frames_dir, false);
+    while (!sim_camera_exhausted()) {
+      const uint32_t before = g_frame_counter;
+      loop();
+      if (!sim_camera_exhausted()) frames += g_frame_counter - before;
+    }
+  }
+
+  pipeline_drain();
+  g_infer_enabled = false;   // the run is over: gets see an idle pipeline
+
+  const double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+  sim_timing_report(wall, frames);
+  printf("totals bees=%lu mites=%lu\n", (unsigned long)g_total_bees, (unsigned long)g_total_mites);
+  printf("led color=%06lx shows=%lu\n", (unsigned long)strip.shownColor(), (unsigned long)strip.showCount());
+
+  for (auto& g : gets) http_get(g.uri, g.out, g.headers);
+  return 0;
+}
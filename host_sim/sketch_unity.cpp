@@ -0,0 +1,7 @@
+// The Arduino builder concatenates every .ino of the sketch into one
+// translation unit; do the same here so the real stage code is compiled as-is.
+#include "../final_clean/final_clean.ino"
+#include "../final_clean/bee_stage.ino"
+#include "../final_clean/crop_stage.ino"
+#include "../final_clean/pipeline.ino"
+#include "../final_clean/varroa_stage.ino"
@@ -0,0 +1,24 @@
+// Host stand-in for Adafruit_NeoPixel: records the last colour shown.
+#pragma once
+#include <stdint.h>
+
+#define NEO_GRB     0x52
+#define NEO_KHZ800  0x0000
+
+class Adafruit_NeoPixel {
+public:
+  Adafruit_NeoPixel(uint16_t n, int16_t pin, uint16_t type) : n_(n) { (void)pin; (void)type; }
+  void begin() {}
+  void show() { shows_++; shown_ = color_; }
+  void setBrightness(uint8_t b) { brightness_ = b; }
+  void setPixelColor(uint16_t i, uint32_t c) { if (i < n_) color_ = c; }
+  static uint32_t Color(uint8_t r, uint8_t g, uint8_t b) { return ((uint32_t)r << 16) | ((uint32_t)g << 8) | b; }
+
+  uint32_t shownColor() const { return shown_; }
+  uint32_t showCount() const { return shows_; }
+
+private:
+  uint16_t n_;
+  uint8_t brightness_ = 255;
+  uint32_t color_ = 0, shown_ = 0, shows_ = 0;
+};
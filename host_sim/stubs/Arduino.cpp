@@ -0,0 +1,46 @@
+#include "Arduino.h"
+#include <chrono>
+#include <thread>
+
+static const auto g_t0 = std::chrono::steady_clock::now();
+
+uint32_t millis() {
+  return (uint32_t)std::chrono::duration_cast<std::chrono::milliseconds>(
+    std::chrono::steady_clock::now() - g_t0).count();
+}
+
+uint32_t micros() {
+  return (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(
+    std::chrono::steady_clock::now() - g_t0).count();
+}
+
+void delay(uint32_t ms) { std::this_thread::sleep_for(std::chrono::milliseconds(ms)); }
+void yield() { std::this_thread::yield(); }
+
+void* ps_malloc(size_t n) { return malloc(n); }
+void* ps_calloc(size_t n, size_t sz) { return calloc(n, sz); }
+
+size_t Print::printf(const char* fmt, ...) {
+  char stack_buf[256];
+  va_list ap;
+  va_start(ap, fmt);
+  int n = vsnprintf(stack_buf, sizeof(stack_buf), fmt, ap);
+  va_end(ap);
+  if (n < 0) return 0;
+  if ((size_t)n < sizeof(stack_buf)) return write((const uint8_t*)stack_buf, (size_t)n);
+
+  std::string big((size_t)n + 1, '\0');
+  va_start(ap, fmt);
+  vsnprintf(&big[0], big.size(), fmt, ap);
+  va_end(ap);
+  return write((const uint8_t*)big.data(), (size_t)n);
+}
+
+bool g_sim_serial_quiet = false;
+
+size_t HostSerial::write(const uint8_t* buf, size_t n) {
+  if (!g_sim_serial_quiet) fwrite(buf, 1, n, stdout);
+  return n;
+}
+
+HostSerial Serial;
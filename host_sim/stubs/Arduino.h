@@ -0,0 +1,101 @@
+// Host stand-in for the subset of the Arduino-ESP32 core the sketch uses.
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdarg.h>
+#include <math.h>
+#include <string>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+
+#define PROGMEM
+
+uint32_t millis();
+uint32_t micros();
+void delay(uint32_t ms);
+void yield();
+
+void* ps_malloc(size_t n);
+void* ps_calloc(size_t n, size_t sz);
+
+class String {
+public:
+  String() {}
+  String(const char* s) : s_(s ? s : "") {}
+  String(const std::string& s) : s_(s) {}
+  String(int v) : s_(std::to_string(v)) {}
+  String(unsigned v) : s_(std::to_string(v)) {}
+  String(long v) : s_(std::to_string(v)) {}
+  String(unsigned long v) : s_(std::to_string(v)) {}
+
+  const char* c_str() const { return s_.c_str(); }
+  unsigned length() const { return (unsigned)s_.size(); }
+  char operator[](unsigned i) const { return i < s_.size() ? s_[i] : 0; }
+
+  int indexOf(const char* p) const { auto r = s_.find(p); return r == std::string::npos ? -1 : (int)r; }
+  int indexOf(char c) const { auto r = s_.find(c); return r == std::string::npos ? -1 : (int)r; }
+  bool startsWith(const char* p) const { return s_.rfind(p, 0) == 0; }
+  bool startsWith(const String& p) const { return startsWith(p.c_str()); }
+  bool endsWith(const char* p) const {
+    size_t n = strlen(p);
+    return s_.size() >= n && s_.compare(s_.size() - n, n, p) == 0;
+  }
+  String substring(unsigned from) const { return from < s_.size() ? String(s_.substr(from)) : String(); }
+  String substring(unsigned from, unsigned to) const {
+    if (from >= s_.size() || to <= from) return String();
+    return String(s_.substr(from, to - from));
+  }
+  void replace(const char* a, const char* b) {
+    size_t an = strlen(a), bn = strlen(b), pos = 0;
+    if (!an) return;
+    while ((pos = s_.find(a, pos)) != std::string::npos) { s_.replace(pos, an, b); pos += bn; }
+  }
+  void trim() {
+    size_t b = s_.find_first_not_of(" \t\r\n");
+    size_t e = s_.find_last_not_of(" \t\r\n");
+    s_ = (b == std::string::npos) ? std::string() : s_.substr(b, e - b + 1);
+  }
+  long toInt() const { return strtol(s_.c_str(), nullptr, 10); }
+
+  String& operator+=(const String& o) { s_ += o.s_; return *this; }
+  String& operator+=(const char* o) { s_ += o; return *this; }
+  String& operator+=(char c) { s_ += c; return *this; }
+  friend String operator+(const String& a, const String& b) { return String(a.s_ + b.s_); }
+  friend String operator+(const String& a, const char* b) { return String(a.s_ + b); }
+  friend String operator+(const char* a, const String& b) { return String(std::string(a) + b.s_); }
+  bool operator==(const char* o) const { return s_ == o; }
+  bool operator!=(const char* o) const { return s_ != o; }
+  bool operator==(const String& o) const { return s_ == o.s_; }
+
+private:
+  std::string s_;
+};
+
+class Print {
+public:
+  virtual ~Print() {}
+  virtual size_t write(const uint8_t* buf, size_t n) = 0;
+  size_t write(uint8_t c) { return write(&c, 1); }
+  size_t print(const char* s) { return write((const uint8_t*)s, strlen(s)); }
+  size_t print(const String& s) { return print(s.c_str()); }
+  size_t println(const char* s = "") { size_t n = print(s); return n + print("\n"); }
+  size_t println(const String& s) { return println(s.c_str()); }
+  size_t printf(const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+};
+
+class HostSerial : public Print {
+public:
+  void begin(unsigned long) {}
+  size_t write(const uint8_t* buf, size_t n) override;
+  using Print::write;
+};
+
+extern HostSerial Serial;
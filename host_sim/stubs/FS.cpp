@@ -0,0 +1,159 @@
+#include "FS.h"
+#include "SD_MMC.h"
+#include "sim_timing.h"
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+#include <unistd.h>
+#include <string>
+
+static std::string g_root = ".";
+
+void sim_fs_set_root(const char* dir) { g_root = dir ? dir : "."; }
+const char* sim_fs_root() { return g_root.c_str(); }
+
+static std::string host_path(const char* p) {
+  std::string s = g_root;
+  if (p && p[0] != '/') s += "/";
+  s += p ? p : "";
+  return s;
+}
+
+namespace fs {
+
+struct FileImpl {
+  std::string path;       // card-relative, e.g. "/frames/boot_000001/000000.jpg"
+  std::string base;
+  FILE* fp = nullptr;
+  DIR* dir = nullptr;
+  size_t size = 0;
+  ~FileImpl() { if (fp) fclose(fp); if (dir) closedir(dir); }
+};
+
+File::operator bool() const { return impl_ && (impl_->fp || impl_->dir); }
+
+size_t File::write(const uint8_t* buf, size_t n) {
+  if (!impl_ || !impl_->fp) return 0;
+  SimStageTimer t(SimStage::SdWrite);
+  return fwrite(buf, 1, n, impl_->fp);
+}
+
+size_t File::read(uint8_t* buf, size_t n) {
+  if (!impl_ || !impl_->fp) return 0;
+  return fread(buf, 1, n, impl_->fp);
+}
+
+int File::read() {
+  uint8_t c;
+  return read(&c, 1) == 1 ? c : -1;
+}
+
+int File::available() {
+  if (!impl_ || !impl_->fp) return 0;
+  long cur = ftell(impl_->fp);
+  fseek(impl_->fp, 0, SEEK_END);
+  long end = ftell(impl_->fp);
+  fseek(impl_->fp, cur, SEEK_SET);
+  return (int)(end - cur);
+}
+
+bool File::seek(uint32_t pos) {
+  return impl_ && impl_->fp && fseek(impl_->fp, (long)pos, SEEK_SET) == 0;
+}
+
+size_t File::position() const {
+  return (impl_ && impl_->fp) ? (size_t)ftell(impl_->fp) : 0;
+}
+
+size_t File::size() const {
+  if (!impl_ || !impl_->fp) return 0;
+  long cur = ftell(impl_->fp);
+  fseek(impl_->fp, 0, SEEK_END);
+  long end = ftell(impl_->fp);
+  fseek(impl_->fp, cur, SEEK_SET);
+  return (size_t)end;
+}
+
+void File::flush() { if (impl_ && impl_->fp) fflush(impl_->fp); }
+void File::close() { impl_.reset(); }
+bool File::isDirectory() const { return impl_ && impl_->dir; }
+const char* File::name() const { return impl_ ? impl_->base.c_str() : ""; }
+const char* File::path() const { return impl_ ? impl_->path.c_str() : ""; }
+
+time_t File::getLastWrite() {
+  struct stat st;
+  if (!impl_ || stat(host_path(impl_->path.c_str()).c_str(), &st) != 0) return 0;
+  return st.st_mtime;
+}
+
+File File::openNextFile() {
+  if (!impl_ || !impl_->dir) return File();
+  while (struct dirent* e = readdir(impl_->dir)) {
+    if (!strcmp(e->d_name, ".") || !strcmp(e->d_name, "..")) continue;
+    std::string child = impl_->path;
+    if (child.empty() || child.back() != '/') child += "/";
+    child += e->d_name;
+    return SD_MMC.open(child.c_str(), FILE_READ);
+  }
+  return File();
+}
+
+String File::readStringUntil(char term) {
+  std::string s;
+  int c;
+  while ((c = read()) >= 0 && c != term) s += (char)c;
+  return String(s);
+}
+
+File FS::open(const char* path, const char* mode) {
+  if (!path) return File();
+  auto impl = std::make_shared<FileImpl>();
+  impl->path = path;
+  const char* slash = strrchr(path, '/');
+  impl->base = slash ? slash + 1 : path;
+
+  const std::string hp = host_path(path);
+  struct stat st;
+  const bool exists = stat(hp.c_str(), &st) == 0;
+  if (exists && S_ISDIR(st.st_mode)) {
+    impl->dir = opendir(hp.c_str());
+    return impl->dir ? File(impl) : File();
+  }
+
+  const char* m = !strcmp(mode, FILE_WRITE) ? "wb"
+                : !strcmp(mode, FILE_APPEND) ? "ab"
+                : !strcmp(mode, "r+") ? "r+b" : "rb";
+  impl->fp = fopen(hp.c_str(), m);
+  return impl->fp ? File(impl) : File();
+}
+
+bool FS::exists(const char* path) {
+  struct stat st;
+  return path && stat(host_path(path).c_str(), &st) == 0;
+}
+
+bool FS::mkdir(const char* path) { return ::mkdir(host_path(path).c_str(), 0755) == 0; }
+bool FS::rmdir(const char* path) { return ::rmdir(host_path(path).c_str()) == 0; }
+bool FS::remove(const char* path) { return ::unlink(host_path(path).c_str()) == 0; }
+bool FS::rename(const char* from, const char* to) {
+  return ::rename(host_path(from).c_str(), host_path(to).c_str()) == 0;
+}
+
+} // namespace fs
+
+uint64_t SDMMCFS::cardSize() { return totalBytes(); }
+
+uint64_t SDMMCFS::totalBytes() {
+  struct statvfs v;
+  if (statvfs(g_root.c_str(), &v) != 0) return 0;
+  return (uint64_t)v.f_blocks * v.f_frsize;
+}
+
+uint64_t SDMMCFS::usedBytes() {
+  struct statvfs v;
+  if (statvfs(g_root.c_str(), &v) != 0) return 0;
+  return (uint64_t)(v.f_blocks - v.f_bfree) * v.f_frsize;
+}
+
+SDMMCFS SD_MMC;
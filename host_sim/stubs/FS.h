@@ -0,0 +1,60 @@
+// Host stand-in for the Arduino-ESP32 FS/File API, backed by a local directory.
+#pragma once
+#include "Arduino.h"
+#include <memory>
+
+#define FILE_READ   "r"
+#define FILE_WRITE  "w"
+#define FILE_APPEND "a"
+
+namespace fs {
+
+struct FileImpl;
+
+class File : public Print {
+public:
+  File() {}
+  explicit File(std::shared_ptr<FileImpl> impl) : impl_(std::move(impl)) {}
+
+  explicit operator bool() const;
+  size_t write(const uint8_t* buf, size_t n) override;
+  using Print::write;
+  size_t read(uint8_t* buf, size_t n);
+  int read();
+  int available();
+  bool seek(uint32_t pos);
+  size_t position() const;
+  size_t size() const;
+  void flush();
+  void close();
+  bool isDirectory() const;
+  const char* name() const;
+  const char* path() const;
+  time_t getLastWrite();
+  File openNextFile();
+  String readStringUntil(char term);
+
+private:
+  std::shared_ptr<FileImpl> impl_;
+};
+
+class FS {
+public:
+  File open(const char* path, const char* mode = FILE_READ);
+  File open(const String& path, const char* mode = FILE_READ) { return open(path.c_str(), mode); }
+  bool exists(const char* path);
+  bool exists(const String& path) { return exists(path.c_str()); }
+  bool mkdir(const char* path);
+  bool rmdir(const char* path);
+  bool remove(const char* path);
+  bool rename(const char* from, const char* to);
+};
+
+} // namespace fs
+
+using fs::File;
+using fs::FS;
+
+// Directory on the host that stands in for the SD card root.
+void sim_fs_set_root(const char* dir);
+const char* sim_fs_root();
@@ -0,0 +1,17 @@
+// Host stand-in for SD_MMC: the card root maps onto a local directory.
+#pragma once
+#include "FS.h"
+
+enum sdcard_type_t { CARD_NONE, CARD_MMC, CARD_SD, CARD_SDHC, CARD_UNKNOWN };
+
+class SDMMCFS : public fs::FS {
+public:
+  bool setPins(int, int, int) { return true; }
+  bool begin(const char* = "/sdcard", bool = false, bool = false) { return true; }
+  uint64_t cardSize();
+  uint64_t totalBytes();
+  uint64_t usedBytes();
+  sdcard_type_t cardType() { return CARD_SDHC; }
+};
+
+extern SDMMCFS SD_MMC;
@@ -0,0 +1,71 @@
+#include "WebServer.h"
+#include <chrono>
+#include <thread>
+
+WiFiClass WiFi;
+
+static WebServer* g_last_server = nullptr;
+
+WebServer::WebServer(int port) { (void)port; g_last_server = this; }
+
+size_t WiFiClient::write(const uint8_t* buf, size_t n) {
+  std::lock_guard<std::mutex> lk(st_->mu);
+  if (!st_->connected) return 0;
+  if (st_->sink) st_->sink->append((const char*)buf, n);
+  return n;
+}
+
+void WebServer::sendHeader(const char* name, const char* value, bool first) {
+  if (first) resp_headers_.insert(resp_headers_.begin(), { name, value });
+  else       resp_headers_.push_back({ name, value });
+}
+
+void WebServer::send(int code, const char* type, const char* content) {
+  code_ = code;
+  std::string head = "HTTP/1.1 " + std::to_string(code) + "\r\n";
+  head += std::string("Content-Type: ") + (type ? type : "text/plain") + "\r\n";
+  const size_t body_len = content ? strlen(content) : 0;
+  chunked_ = (content_len_ == CONTENT_LENGTH_UNKNOWN);
+  if (chunked_) head += "Transfer-Encoding: chunked\r\n";
+  else head += "Content-Length: " + std::to_string(content_len_ == CONTENT_LENGTH_NOT_SET ? body_len : content_len_) + "\r\n";
+  for (auto& h : resp_headers_) head += h.first + ": " + h.second + "\r\n";
+  head += "\r\n";
+  resp_headers_.clear();
+  client_.write((const uint8_t*)head.data(), head.size());
+  if (body_len) sendContent(content, body_len);
+  content_len_ = CONTENT_LENGTH_NOT_SET;
+}
+
+void WebServer::sendContent(const char* s, size_t n) {
+  if (!chunked_) { client_.write((const uint8_t*)s, n); return; }
+  char hdr[24];
+  snprintf(hdr, sizeof(hdr), "%zx\r\n", n);
+  client_.write((const uint8_t*)hdr, strlen(hdr));
+  client_.write((const uint8_t*)s, n);
+  client_.write((const uint8_t*)"\r\n", 2);
+}
+
+int WebServer::sim_dispatch(HTTPMethod m, const char* uri, const std::map<std::string, std::string>& args,
+                            const std::map<std::string, std::string>& headers, std::string& out) {
+  args_ = args; headers_ = headers; uri_ = uri; method_ = m;
+  code_ = 0; chunked_ = false; content_len_ = CONTENT_LENGTH_NOT_SET;
+  client_.sim_attach(&out);
+  bool found = false;
+  for (auto& r : routes_) {
+    if (r.uri == uri && (r.method == HTTP_ANY || r.method == m)) { r.fn(); found = true; break; }
+  }
+  if (!found && not_found_) not_found_();
+
+  // A handler that handed the client to a task of its own: give that task a
+  // few seconds, then hang up and wait for it to let go of out.
+  for (int i = 0; i < 500 && client_.sim_refs() > 1; ++i) std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  client_.stop();
+  while (client_.sim_refs() > 1) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  return code_;
+}
+
+int sim_http_request(HTTPMethod m, const char* uri, const std::map<std::string, std::string>& args,
+                     std::string& out, const std::map<std::string, std::string>& headers) {
+  WebServer* s = g_last_server;
+  return s ? s->sim_dispatch(m, uri, args, headers, out) : -1;
+}
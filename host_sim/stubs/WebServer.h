@@ -0,0 +1,67 @@
+// Host stand-in for the synchronous Arduino WebServer. Requests are injected
+// with sim_http_request() and the full response is captured as text.
+#pragma once
+#include "WiFi.h"
+#include <functional>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#define CONTENT_LENGTH_UNKNOWN ((size_t)-1)
+#define CONTENT_LENGTH_NOT_SET ((size_t)-2)
+
+enum HTTPMethod { HTTP_ANY, HTTP_GET, HTTP_HEAD, HTTP_POST, HTTP_PUT, HTTP_PATCH, HTTP_DELETE, HTTP_OPTIONS };
+
+class WebServer {
+public:
+  typedef std::function<void(void)> THandlerFunction;
+
+  explicit WebServer(int port = 80);
+
+  void begin() {}
+  void handleClient() {}
+  void on(const char* uri, HTTPMethod m, THandlerFunction fn) { routes_.push_back({ uri, m, fn }); }
+  void on(const char* uri, THandlerFunction fn) { on(uri, HTTP_ANY, fn); }
+  void onNotFound(THandlerFunction fn) { not_found_ = fn; }
+  void collectHeaders(const char* names[], size_t n) { (void)names; (void)n; }
+
+  bool hasArg(const char* name) const { return args_.count(name) != 0; }
+  String arg(const char* name) const { auto it = args_.find(name); return it == args_.end() ? String() : String(it->second); }
+  bool hasHeader(const char* name) const { return headers_.count(name) != 0; }
+  String header(const char* name) const { auto it = headers_.find(name); return it == headers_.end() ? String() : String(it->second); }
+  String uri() const { return String(uri_); }
+  HTTPMethod method() const { return method_; }
+
+  void sendHeader(const char* name, const char* value, bool first = false);
+  void sendHeader(const char* name, const String& value, bool first = false) { sendHeader(name, value.c_str(), first); }
+  void setContentLength(size_t len) { content_len_ = len; }
+  void send(int code, const char* type = "text/plain", const char* content = "");
+  void send(int code, const char* type, const String& content) { send(code, type, content.c_str()); }
+  void send_P(int code, const char* type, const char* content) { send(code, type, content); }
+  void sendContent(const char* s) { sendContent(s, strlen(s)); }
+  void sendContent(const String& s) { sendContent(s.c_str(), s.length()); }
+  void sendContent(const char* s, size_t n);
+  WiFiClient& client() { return client_; }
+
+  // Host only.
+  int sim_dispatch(HTTPMethod m, const char* uri, const std::map<std::string, std::string>& args,
+                   const std::map<std::string, std::string>& headers, std::string& out);
+
+private:
+  struct Route { std::string uri; HTTPMethod method; THandlerFunction fn; };
+  std::vector<Route> routes_;
+  THandlerFunction not_found_;
+  std::map<std::string, std::string> args_, headers_;
+  std::vector<std::pair<std::string, std::string>> resp_headers_;
+  std::string uri_;
+  HTTPMethod method_ = HTTP_GET;
+  size_t content_len_ = CONTENT_LENGTH_NOT_SET;
+  bool chunked_ = false;
+  int code_ = 0;
+  WiFiClient client_;
+};
+
+// Host only: dispatch one request against the most recently constructed server.
+int sim_http_request(HTTPMethod m, const char* uri, const std::map<std::string, std::string>& args,
+                     std::string& out, const std::map<std::string, std::string>& headers = {});
@@ -0,0 +1,48 @@
+// Host stand-in for the WiFi AP API and client sockets.
+#pragma once
+#include "Arduino.h"
+#include <string>
+#include <memory>
+#include <mutex>
+#include <atomic>
+
+enum wifi_mode_t { WIFI_OFF, WIFI_STA, WIFI_AP, WIFI_AP_STA };
+
+class IPAddress {
+public:
+  String toString() const { return String("192.168.4.1"); }
+};
+
+// Copies share one connection, as on the device, so a handler may hand its
+// client to another task.
+class WiFiClient : public Print {
+public:
+  size_t write(const uint8_t* buf, size_t n) override;
+  using Print::write;
+  void setNoDelay(bool) {}
+  bool connected() const { return st_->connected; }
+  void stop() { st_->connected = false; }
+  explicit operator bool() const { return st_->connected; }
+
+  // Host only: bytes written by the handler under test go to sink.
+  void sim_attach(std::string* sink) { st_ = std::make_shared<State>(); st_->sink = sink; }
+  long sim_refs() const { return st_.use_count(); }
+
+private:
+  struct State {
+    std::mutex mu;
+    std::string* sink = nullptr;
+    std::atomic<bool> connected{ true };
+  };
+  std::shared_ptr<State> st_ = std::make_shared<State>();
+};
+
+class WiFiClass {
+public:
+  bool mode(wifi_mode_t) { return true; }
+  bool setSleep(bool) { return true; }
+  bool softAP(const char*, const char* = nullptr) { return true; }
+  IPAddress softAPIP() { return IPAddress(); }
+};
+
+extern WiFiClass WiFi;
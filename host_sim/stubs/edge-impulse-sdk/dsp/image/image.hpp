@@ -0,0 +1,11 @@
+// Host stand-in for the Edge Impulse image helpers the sketch uses.
+#pragma once
+#include <stdint.h>
+
+namespace ei { namespace image { namespace processing {
+
+// Center-crop src to the destination aspect ratio, then bilinear-resize.
+int crop_and_interpolate_rgb888(const uint8_t* src, int src_w, int src_h,
+                                uint8_t* dst, int dst_w, int dst_h);
+
+}}} // namespace ei::image::processing
@@ -0,0 +1,176 @@
+#include "merge_b.h"
+#include "edge-impulse-sdk/dsp/image/image.hpp"
+#include "sim_timing.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <string>
+#include <vector>
+
+// Fixture formats (whitespace separated, '#' comments):
+//   bee:    <frame_index> <label> <x> <y> <w> <h> <score>   (bee model input coords)
+//   varroa: <call_index> <x> <y> <w> <h> <score>            (varroa model input coords)
+// Bee fixtures are keyed by the order of run_classifier() calls (one per frame).
+// Varroa fixtures are keyed by the order of process_impulse() calls and wrap around.
+// Without fixtures a deterministic synthetic pattern is generated.
+
+struct FixtureBox { uint32_t key; std::string label; uint32_t x, y, w, h; float score; };
+
+static std::vector<FixtureBox> g_bee_fx, g_var_fx;
+static bool g_have_bee_fx = false, g_have_var_fx = false;
+static uint32_t g_bee_calls = 0, g_var_calls = 0;
+static uint32_t g_bee_ms = 0, g_var_ms = 0;
+static std::mutex g_mu;
+
+static thread_local ei_impulse_result_bounding_box_t t_boxes[EI_CLASSIFIER_MAX_BOXES];
+static thread_local std::string t_labels[EI_CLASSIFIER_MAX_BOXES];
+
+ei_impulse_handle_t& ei_bee_impulse() {
+  static ei_impulse_handle_t h = { "bee", EI_CLASSIFIER_INPUT_WIDTH, EI_CLASSIFIER_INPUT_HEIGHT };
+  return h;
+}
+
+ei_impulse_handle_t& ei_varroa_impulse() {
+  static ei_impulse_handle_t h = { "varroa", EI_VARROA_INPUT_WIDTH, EI_VARROA_INPUT_HEIGHT };
+  return h;
+}
+
+static bool load_fixture(const char* path, bool bee, std::vector<FixtureBox>& out) {
+  FILE* f = fopen(path, "r");
+  if (!f) return false;
+  char line[256];
+  while (fgets(line, sizeof(line), f)) {
+    if (line[0] == '#' || line[0] == '\n') continue;
+    FixtureBox b{};
+    char lab[32] = "bee";
+    int m = bee
+      ? sscanf(line, "%u %31s %u %u %u %u %f", &b.key, lab, &b.x, &b.y, &b.w, &b.h, &b.score)
+      : sscanf(line, "%u %u %u %u %u %f", &b.key, &b.x, &b.y, &b.w, &b.h, &b.score);
+    if (m != (bee ? 7 : 6)) continue;
+    b.label = bee ? lab : "varroa";
+    out.push_back(b);
+  }
+  fclose(f);
+  return true;
+}
+
+bool sim_ei_load_bee_fixture(const char* path) { return g_have_bee_fx = load_fixture(path, true, g_bee_fx); }
+bool sim_ei_load_varroa_fixture(const char* path) { return g_have_var_fx = load_fixture(path, false, g_var_fx); }
+void sim_ei_set_latency_ms(uint32_t bee_ms, uint32_t varroa_ms) { g_bee_ms = bee_ms; g_var_ms = varroa_ms; }
+
+// Pull the whole signal through get_data() so the shim cost is part of the measurement.
+static float drain_signal(ei::signal_t* signal) {
+  static thread_local float chunk[1024];
+  float acc = 0.f;
+  for (size_t off = 0; off < signal->total_length; off += 1024) {
+    const size_t n = (signal->total_length - off) < 1024 ? (signal->total_length - off) : 1024;
+    signal->get_data(off, n, chunk);
+    acc += chunk[0];
+  }
+  return acc;
+}
+
+static void emit(ei_impulse_result_t* result, const std::vector<FixtureBox>& boxes) {
+  uint32_t n = 0;
+  for (const auto& b : boxes) {
+    if (n >= EI_CLASSIFIER_MAX_BOXES) break;
+    t_labels[n] = b.label;
+    t_boxes[n] = { t_labels[n].c_str(), b.x, b.y, b.w, b.h, b.score };
+    n++;
+  }
+  result->bounding_boxes = t_boxes;
+  result->bounding_boxes_count = n;
+}
+
+EI_IMPULSE_ERROR run_classifier(ei::signal_t* signal, ei_impulse_result_t* result, bool) {
+  SimStageTimer t(SimStage::BeeInference);
+  if (!signal || !result || !signal->get_data) return EI_IMPULSE_DSP_ERROR;
+  (void)drain_signal(signal);
+  if (g_bee_ms) std::this_thread::sleep_for(std::chrono::milliseconds(g_bee_ms));
+
+  uint32_t frame;
+  { std::lock_guard<std::mutex> lk(g_mu); frame = g_bee_calls++; }
+
+  std::vector<FixtureBox> boxes;
+  if (g_have_bee_fx) {
+    for (const auto& b : g_bee_fx) if (b.key == frame) boxes.push_back(b);
+  } else {
+    // A few 8x8 FOMO cells per frame, moving slowly across the board.
+    const uint32_t n = (frame * 7u) % 9u;
+    for (uint32_t i = 0; i < n; ++i) {
+      const uint32_t x = (40u + i * 31u + frame * 3u) % (EI_CLASSIFIER_INPUT_WIDTH - 8);
+      const uint32_t y = (60u + i * 23u) % (EI_CLASSIFIER_INPUT_HEIGHT - 8);
+      boxes.push_back({ frame, "bee", x, y, 8, 8, 0.5f + 0.05f * (float)(i % 9) });
+    }
+  }
+  emit(result, boxes);
+  return EI_IMPULSE_OK;
+}
+
+EI_IMPULSE_ERROR process_impulse(ei_impulse_handle_t* handle, ei::signal_t* signal,
+                                 ei_impulse_result_t* result, bool debug) {
+  if (handle == &ei_bee_impulse()) return run_classifier(signal, result, debug);
+
+  SimStageTimer t(SimStage::VarroaInference);
+  if (!signal || !result || !signal->get_data) return EI_IMPULSE_DSP_ERROR;
+  (void)drain_signal(signal);
+  if (g_var_ms) std::this_thread::sleep_for(std::chrono::milliseconds(g_var_ms));
+
+  uint32_t call;
+  { std::lock_guard<std::mutex> lk(g_mu); call = g_var_calls++; }
+
+  std::vector<FixtureBox> boxes;
+  if (g_have_var_fx && !g_var_fx.empty()) {
+    const uint32_t span = g_var_fx.back().key + 1;
+    for (const auto& b : g_var_fx) if (b.key == call % span) boxes.push_back(b);
+  } else if (call % 5 == 4) {
+    boxes.push_back({ call, "varroa", 72, 64, 8, 8, 0.8f });
+  }
+  emit(result, boxes);
+  return EI_IMPULSE_OK;
+}
+
+namespace ei { namespace image { namespace processing {
+
+int crop_and_interpolate_rgb888(const uint8_t* src, int src_w, int src_h,
+                                uint8_t* dst, int dst_w, int dst_h) {
+  SimStageTimer t(SimStage::Resize);
+  if (!src || !dst || src_w <= 0 || src_h <= 0 || dst_w <= 0 || dst_h <= 0) return -1;
+
+  // Same center-crop rule as ei_calc_crop_map() in the sketch.
+  const float src_ar = (float)src_w / (float)src_h;
+  const float dst_ar = (float)dst_w / (float)dst_h;
+  int cw = src_w, ch = src_h;
+  if (src_ar > dst_ar) cw = (int)lrintf((float)src_h * dst_ar);
+  else                 ch = (int)lrintf((float)src_w / dst_ar);
+  const int cx = (src_w - cw) / 2, cy = (src_h - ch) / 2;
+
+  const float sx = (float)cw / (float)dst_w, sy = (float)ch / (float)dst_h;
+  for (int y = 0; y < dst_h; ++y) {
+    float fy = ((float)y + 0.5f) * sy - 0.5f;
+    if (fy < 0) fy = 0;
+    int y0 = (int)fy; int y1 = y0 + 1 < ch ? y0 + 1 : y0; float wy = fy - (float)y0;
+    for (int x = 0; x < dst_w; ++x) {
+      float fx = ((float)x + 0.5f) * sx - 0.5f;
+      if (fx < 0) fx = 0;
+      int x0 = (int)fx; int x1 = x0 + 1 < cw ? x0 + 1 : x0; float wx = fx - (float)x0;
+      const uint8_t* p00 = src + ((size_t)(cy + y0) * src_w + (cx + x0)) * 3;
+      const uint8_t* p01 = src + ((size_t)(cy + y0) * src_w + (cx + x1)) * 3;
+      const uint8_t* p10 = src + ((size_t)(cy + y1) * src_w + (cx + x0)) * 3;
+      const uint8_t* p11 = src + ((size_t)(cy + y1) * src_w + (cx + x1)) * 3;
+      uint8_t* o = dst + ((size_t)y * dst_w + x) * 3;
+      for (int c = 0; c < 3; ++c) {
+        const float top = p00[c] + (p01[c] - p00[c]) * wx;
+        const float bot = p10[c] + (p11[c] - p10[c]) * wx;
+        o[c] = (uint8_t)lrintf(top + (bot - top) * wy);
+      }
+    }
+  }
+  return 0;
+}
+
+}}} // namespace ei::image::processing
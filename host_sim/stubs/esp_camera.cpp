@@ -0,0 +1,91 @@
+#include "esp_camera.h"
+#include "img_converters.h"
+#include "sim_timing.h"
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <stdio.h>
+#include <jpeglib.h>
+
+static std::vector<std::string> g_frames;
+static size_t g_next = 0;
+static bool g_loop = false;
+static bool g_exhausted = false;
+
+bool sim_camera_open_dir(const char* dir, bool loop) {
+  g_frames.clear();
+  g_next = 0;
+  g_loop = loop;
+  g_exhausted = false;
+
+  DIR* d = opendir(dir);
+  if (!d) return false;
+  while (struct dirent* e = readdir(d)) {
+    const char* dot = strrchr(e->d_name, '.');
+    if (dot && (!strcasecmp(dot, ".jpg") || !strcasecmp(dot, ".jpeg"))) {
+      g_frames.push_back(std::string(dir) + "/" + e->d_name);
+    }
+  }
+  closedir(d);
+  std::sort(g_frames.begin(), g_frames.end());
+  return !g_frames.empty();
+}
+
+bool sim_camera_exhausted() { return g_exhausted; }
+size_t sim_camera_frame_count() { return g_frames.size(); }
+
+esp_err_t esp_camera_init(const camera_config_t*) {
+  return g_frames.empty() ? ESP_FAIL : ESP_OK;
+}
+
+static bool read_dims(const uint8_t* buf, size_t len, size_t& w, size_t& h) {
+  jpeg_decompress_struct cinfo;
+  jpeg_error_mgr jerr;
+  cinfo.err = jpeg_std_error(&jerr);
+  jpeg_create_decompress(&cinfo);
+  jpeg_mem_src(&cinfo, buf, (unsigned long)len);
+  const bool ok = jpeg_read_header(&cinfo, TRUE) == JPEG_HEADER_OK;
+  w = cinfo.image_width;
+  h = cinfo.image_height;
+  jpeg_destroy_decompress(&cinfo);
+  return ok;
+}
+
+camera_fb_t* esp_camera_fb_get() {
+  SimStageTimer t(SimStage::CameraGrab);
+  if (g_frames.empty()) return nullptr;
+  if (g_next >= g_frames.size()) {
+    if (!g_loop) { g_exhausted = true; return nullptr; }
+    g_next = 0;
+  }
+
+  FILE* f = fopen(g_frames[g_next++].c_str(), "rb");
+  if (!f) return nullptr;
+  fseek(f, 0, SEEK_END);
+  long n = ftell(f);
+  fseek(f, 0, SEEK_SET);
+
+  camera_fb_t* fb = (camera_fb_t*)calloc(1, sizeof(camera_fb_t));
+  fb->buf = (uint8_t*)malloc((size_t)n);
+  fb->len = fread(fb->buf, 1, (size_t)n, f);
+  fb->format = PIXFORMAT_JPEG;
+  fclose(f);
+
+  if (!read_dims(fb->buf, fb->len, fb->width, fb->height)) {
+    esp_camera_fb_return(fb);
+    return nullptr;
+  }
+  return fb;
+}
+
+void esp_camera_fb_return(camera_fb_t* fb) {
+  if (!fb) return;
+  free(fb->buf);
+  free(fb);
+}
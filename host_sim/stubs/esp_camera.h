@@ -0,0 +1,53 @@
+// Host stand-in for esp_camera: frames are replayed from a directory of JPEGs.
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+typedef int esp_err_t;
+#define ESP_OK   0
+#define ESP_FAIL -1
+
+typedef enum { PIXFORMAT_RGB565, PIXFORMAT_YUV422, PIXFORMAT_GRAYSCALE, PIXFORMAT_JPEG, PIXFORMAT_RGB888 } pixformat_t;
+typedef enum { FRAMESIZE_QVGA, FRAMESIZE_VGA, FRAMESIZE_SVGA, FRAMESIZE_XGA, FRAMESIZE_SXGA, FRAMESIZE_UXGA } framesize_t;
+typedef enum { LEDC_TIMER_0 } ledc_timer_t;
+typedef enum { LEDC_CHANNEL_0 } ledc_channel_t;
+typedef enum { CAMERA_FB_IN_PSRAM, CAMERA_FB_IN_DRAM } camera_fb_location_t;
+typedef enum { CAMERA_GRAB_WHEN_EMPTY, CAMERA_GRAB_LATEST } camera_grab_mode_t;
+
+typedef struct {
+  int pin_pwdn;
+  int pin_reset;
+  int pin_xclk;
+  int pin_sscb_sda;
+  int pin_sscb_scl;
+  int pin_d7, pin_d6, pin_d5, pin_d4, pin_d3, pin_d2, pin_d1, pin_d0;
+  int pin_vsync;
+  int pin_href;
+  int pin_pclk;
+  int xclk_freq_hz;
+  ledc_timer_t ledc_timer;
+  ledc_channel_t ledc_channel;
+  pixformat_t pixel_format;
+  framesize_t frame_size;
+  int jpeg_quality;
+  size_t fb_count;
+  camera_fb_location_t fb_location;
+  camera_grab_mode_t grab_mode;
+} camera_config_t;
+
+typedef struct {
+  uint8_t* buf;
+  size_t len;
+  size_t width;
+  size_t height;
+  pixformat_t format;
+} camera_fb_t;
+
+esp_err_t esp_camera_init(const camera_config_t* config);
+camera_fb_t* esp_camera_fb_get();
+void esp_camera_fb_return(camera_fb_t* fb);
+
+// Replay control (host only).
+bool sim_camera_open_dir(const char* dir, bool loop);
+bool sim_camera_exhausted();
+size_t sim_camera_frame_count();
@@ -0,0 +1,10 @@
+// Host stand-in for esp32-camera's esp_jpg_decode (TJpgDec wrapper).
+// The writer receives R,G,B blocks in decode order, as on the device.
+#pragma once
+#include "img_converters.h"
+#include "esp_camera.h"
+
+typedef unsigned int (*jpg_reader_cb)(void* arg, size_t index, uint8_t* buf, size_t len);
+typedef bool (*jpg_writer_cb)(void* arg, uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint8_t* data);
+
+esp_err_t esp_jpg_decode(size_t len, jpg_scale_t scale, jpg_reader_cb reader, jpg_writer_cb writer, void* arg);
@@ -0,0 +1,200 @@
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+
+#include <pthread.h>
+#include <string.h>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+static const auto g_t0 = std::chrono::steady_clock::now();
+
+static std::chrono::steady_clock::time_point deadline_for(TickType_t ticks) {
+  if (ticks == portMAX_DELAY) return std::chrono::steady_clock::time_point::max();
+  return std::chrono::steady_clock::now() + std::chrono::milliseconds(ticks);
+}
+
+template <class Pred>
+static bool wait_until(std::condition_variable& cv, std::unique_lock<std::mutex>& lk,
+                       TickType_t ticks, Pred pred) {
+  if (ticks == portMAX_DELAY) { cv.wait(lk, pred); return true; }
+  return cv.wait_until(lk, deadline_for(ticks), pred);
+}
+
+int64_t esp_timer_get_time() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - g_t0).count();
+}
+
+TickType_t xTaskGetTickCount() { return (TickType_t)(esp_timer_get_time() / 1000); }
+
+// ---- critical sections: one recursive mutex per portMUX ----
+static std::mutex g_mux_init;
+
+void host_port_enter_critical(portMUX_TYPE* mux) {
+  {
+    std::lock_guard<std::mutex> lk(g_mux_init);
+    if (!mux->impl) mux->impl = new std::recursive_mutex();
+  }
+  static_cast<std::recursive_mutex*>(mux->impl)->lock();
+}
+
+void host_port_exit_critical(portMUX_TYPE* mux) {
+  static_cast<std::recursive_mutex*>(mux->impl)->unlock();
+}
+
+// ---- tasks ----
+struct HostTask {
+  std::mutex mu;
+  std::condition_variable cv;
+  uint32_t notify = 0;
+  BaseType_t core = 0;
+};
+
+static thread_local HostTask* t_self = nullptr;
+static HostTask g_main_task;
+
+static HostTask* self() { return t_self ? t_self : &g_main_task; }
+
+BaseType_t xPortGetCoreID() { return self()->core == tskNO_AFFINITY ? 0 : self()->core; }
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char*, uint32_t, void* arg,
+                                   UBaseType_t, TaskHandle_t* out, BaseType_t core) {
+  HostTask* t = new HostTask();
+  t->core = core;
+  if (out) *out = t;
+  std::thread([fn, arg, t]() { t_self = t; fn(arg); }).detach();
+  return pdPASS;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char* name, uint32_t depth, void* arg,
+                       UBaseType_t prio, TaskHandle_t* out) {
+  return xTaskCreatePinnedToCore(fn, name, depth, arg, prio, out, tskNO_AFFINITY);
+}
+
+void vTaskDelay(TickType_t ticks) { std::this_thread::sleep_for(std::chrono::milliseconds(ticks)); }
+
+void vTaskDelete(TaskHandle_t t) {
+  if (t == nullptr || t == t_self) pthread_exit(nullptr);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle() { return self(); }
+
+void xTaskNotifyGive(TaskHandle_t t) {
+  if (!t) return;
+  std::lock_guard<std::mutex> lk(t->mu);
+  t->notify++;
+  t->cv.notify_all();
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks) {
+  HostTask* t = self();
+  std::unique_lock<std::mutex> lk(t->mu);
+  wait_until(t->cv, lk, ticks, [&] { return t->notify > 0; });
+  const uint32_t v = t->notify;
+  if (v) t->notify = clear_on_exit ? 0 : v - 1;
+  return v;
+}
+
+// ---- queues ----
+struct HostQueue {
+  std::mutex mu;
+  std::condition_variable cv;
+  std::deque<std::vector<uint8_t>> items;
+  size_t cap, item_size;
+};
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size) {
+  HostQueue* q = new HostQueue();
+  q->cap = length;
+  q->item_size = item_size;
+  return q;
+}
+
+static BaseType_t queue_put(QueueHandle_t q, const void* item, TickType_t ticks, bool front) {
+  std::unique_lock<std::mutex> lk(q->mu);
+  if (!wait_until(q->cv, lk, ticks, [&] { return q->items.size() < q->cap; })) return errQUEUE_FULL;
+  std::vector<uint8_t> v((const uint8_t*)item, (const uint8_t*)item + q->item_size);
+  if (front) q->items.push_front(std::move(v)); else q->items.push_back(std::move(v));
+  q->cv.notify_all();
+  return pdTRUE;
+}
+
+BaseType_t xQueueSend(QueueHandle_t q, const void* item, TickType_t ticks) { return queue_put(q, item, ticks, false); }
+BaseType_t xQueueSendToFront(QueueHandle_t q, const void* item, TickType_t ticks) { return queue_put(q, item, ticks, true); }
+
+BaseType_t xQueueOverwrite(QueueHandle_t q, const void* item) {
+  std::lock_guard<std::mutex> lk(q->mu);
+  q->items.clear();
+  q->items.emplace_back((const uint8_t*)item, (const uint8_t*)item + q->item_size);
+  q->cv.notify_all();
+  return pdTRUE;
+}
+
+static BaseType_t queue_get(QueueHandle_t q, void* item, TickType_t ticks, bool pop) {
+  std::unique_lock<std::mutex> lk(q->mu);
+  if (!wait_until(q->cv, lk, ticks, [&] { return !q->items.empty(); })) return pdFALSE;
+  memcpy(item, q->items.front().data(), q->item_size);
+  if (pop) { q->items.pop_front(); q->cv.notify_all(); }
+  return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t q, void* item, TickType_t ticks) { return queue_get(q, item, ticks, true); }
+BaseType_t xQueuePeek(QueueHandle_t q, void* item, TickType_t ticks) { return queue_get(q, item, ticks, false); }
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t q) {
+  std::lock_guard<std::mutex> lk(q->mu);
+  return (UBaseType_t)q->items.size();
+}
+
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t q) {
+  std::lock_guard<std::mutex> lk(q->mu);
+  return (UBaseType_t)(q->cap - q->items.size());
+}
+
+BaseType_t xQueueReset(QueueHandle_t q) {
+  std::lock_guard<std::mutex> lk(q->mu);
+  q->items.clear();
+  q->cv.notify_all();
+  return pdPASS;
+}
+
+// ---- semaphores (mutexes are recursive-safe enough for the sketch's use) ----
+struct HostSemaphore {
+  std::mutex mu;
+  std::condition_variable cv;
+  UBaseType_t count, max;
+};
+
+SemaphoreHandle_t xSemaphoreCreateMutex() { return new HostSemaphore{ {}, {}, 1, 1 }; }
+SemaphoreHandle_t xSemaphoreCreateBinary() { return new HostSemaphore{ {}, {}, 0, 1 }; }
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max_count, UBaseType_t initial) {
+  return new HostSemaphore{ {}, {}, initial, max_count };
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t s, TickType_t ticks) {
+  std::unique_lock<std::mutex> lk(s->mu);
+  if (!wait_until(s->cv, lk, ticks, [&] { return s->count > 0; })) return pdFALSE;
+  s->count--;
+  return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t s) {
+  std::lock_guard<std::mutex> lk(s->mu);
+  if (s->count >= s->max) return pdFALSE;
+  s->count++;
+  s->cv.notify_one();
+  return pdTRUE;
+}
+
+UBaseType_t uxSemaphoreGetCount(SemaphoreHandle_t s) {
+  std::lock_guard<std::mutex> lk(s->mu);
+  return s->count;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t s) { delete s; }
@@ -0,0 +1,33 @@
+// Host stand-in for the FreeRTOS kernel API subset the sketch uses.
+// Tasks are std::threads, queues are bounded condition-variable FIFOs.
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+typedef int BaseType_t;
+typedef unsigned UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdFALSE 0
+#define pdTRUE  1
+#define pdPASS  pdTRUE
+#define pdFAIL  pdFALSE
+#define errQUEUE_FULL 0
+
+#define portMAX_DELAY       ((TickType_t)0xffffffffu)
+#define portTICK_PERIOD_MS  1
+#define pdMS_TO_TICKS(ms)   ((TickType_t)(ms))
+#define tskIDLE_PRIORITY    0
+#define tskNO_AFFINITY      0x7fffffff
+#define configMAX_PRIORITIES 25
+
+struct HostSpinlock;
+typedef struct { void* impl; } portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED { nullptr }
+void host_port_enter_critical(portMUX_TYPE* mux);
+void host_port_exit_critical(portMUX_TYPE* mux);
+#define portENTER_CRITICAL(mux) host_port_enter_critical(mux)
+#define portEXIT_CRITICAL(mux)  host_port_exit_critical(mux)
+
+TickType_t xTaskGetTickCount();
+BaseType_t xPortGetCoreID();
@@ -0,0 +1,15 @@
+#pragma once
+#include "FreeRTOS.h"
+
+typedef struct HostQueue* QueueHandle_t;
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size);
+BaseType_t xQueueSend(QueueHandle_t q, const void* item, TickType_t ticks);
+BaseType_t xQueueSendToFront(QueueHandle_t q, const void* item, TickType_t ticks);
+BaseType_t xQueueReceive(QueueHandle_t q, void* item, TickType_t ticks);
+BaseType_t xQueuePeek(QueueHandle_t q, void* item, TickType_t ticks);
+BaseType_t xQueueOverwrite(QueueHandle_t q, const void* item);
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t q);
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t q);
+BaseType_t xQueueReset(QueueHandle_t q);
+#define xQueueSendToBack xQueueSend
@@ -0,0 +1,12 @@
+#pragma once
+#include "FreeRTOS.h"
+
+typedef struct HostSemaphore* SemaphoreHandle_t;
+
+SemaphoreHandle_t xSemaphoreCreateMutex();
+SemaphoreHandle_t xSemaphoreCreateBinary();
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max_count, UBaseType_t initial);
+BaseType_t xSemaphoreTake(SemaphoreHandle_t s, TickType_t ticks);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t s);
+UBaseType_t uxSemaphoreGetCount(SemaphoreHandle_t s);
+void vSemaphoreDelete(SemaphoreHandle_t s);
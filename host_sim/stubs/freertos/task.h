@@ -0,0 +1,16 @@
+#pragma once
+#include "FreeRTOS.h"
+
+typedef void (*TaskFunction_t)(void*);
+typedef struct HostTask* TaskHandle_t;
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char* name, uint32_t stack_depth,
+                                   void* arg, UBaseType_t prio, TaskHandle_t* out, BaseType_t core);
+BaseType_t xTaskCreate(TaskFunction_t fn, const char* name, uint32_t stack_depth,
+                       void* arg, UBaseType_t prio, TaskHandle_t* out);
+void vTaskDelay(TickType_t ticks);
+void vTaskDelete(TaskHandle_t t);
+TaskHandle_t xTaskGetCurrentTaskHandle();
+
+void xTaskNotifyGive(TaskHandle_t t);
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks);
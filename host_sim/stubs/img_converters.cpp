@@ -0,0 +1,114 @@
+#include "img_converters.h"
+#include "esp_jpg_decode.h"
+#include "sim_timing.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include <stdio.h>
+#include <jpeglib.h>
+
+bool fmt2rgb888(const uint8_t* src_buf, size_t src_len, pixformat_t format, uint8_t* rgb_buf) {
+  SimStageTimer t(SimStage::JpegDecode);
+  if (format != PIXFORMAT_JPEG || !src_buf || !rgb_buf) return false;
+
+  jpeg_decompress_struct cinfo;
+  jpeg_error_mgr jerr;
+  cinfo.err = jpeg_std_error(&jerr);
+  jpeg_create_decompress(&cinfo);
+  jpeg_mem_src(&cinfo, src_buf, (unsigned long)src_len);
+  if (jpeg_read_header(&cinfo, TRUE) != JPEG_HEADER_OK) { jpeg_destroy_decompress(&cinfo); return false; }
+  cinfo.out_color_space = JCS_EXT_BGR;
+  jpeg_start_decompress(&cinfo);
+
+  const size_t stride = (size_t)cinfo.output_width * 3;
+  while (cinfo.output_scanline < cinfo.output_height) {
+    JSAMPROW row = rgb_buf + (size_t)cinfo.output_scanline * stride;
+    jpeg_read_scanlines(&cinfo, &row, 1);
+  }
+  jpeg_finish_decompress(&cinfo);
+  jpeg_destroy_decompress(&cinfo);
+  return true;
+}
+
+bool fmt2jpg(uint8_t* src, size_t src_len, uint16_t width, uint16_t height, pixformat_t format,
+             uint8_t quality, uint8_t** out, size_t* out_len) {
+  SimStageTimer t(SimStage::JpegEncode);
+  if (format != PIXFORMAT_RGB888 || !src || !out || !out_len) return false;
+  if (src_len < (size_t)width * height * 3) return false;
+
+  jpeg_compress_struct cinfo;
+  jpeg_error_mgr jerr;
+  cinfo.err = jpeg_std_error(&jerr);
+  jpeg_create_compress(&cinfo);
+
+  unsigned char* mem = nullptr;
+  unsigned long mem_len = 0;
+  jpeg_mem_dest(&cinfo, &mem, &mem_len);
+
+  cinfo.image_width = width;
+  cinfo.image_height = height;
+  cinfo.input_components = 3;
+  cinfo.in_color_space = JCS_EXT_BGR;
+  jpeg_set_defaults(&cinfo);
+  jpeg_set_quality(&cinfo, quality, TRUE);
+  jpeg_start_compress(&cinfo, TRUE);
+
+  const size_t stride = (size_t)width * 3;
+  while (cinfo.next_scanline < cinfo.image_height) {
+    JSAMPROW row = src + (size_t)cinfo.next_scanline * stride;
+    jpeg_write_scanlines(&cinfo, &row, 1);
+  }
+  jpeg_finish_compress(&cinfo);
+  jpeg_destroy_compress(&cinfo);
+
+  // Hand back a malloc'd buffer like the device does (callers free()).
+  *out = (uint8_t*)malloc(mem_len);
+  memcpy(*out, mem, mem_len);
+  *out_len = mem_len;
+  free(mem);
+  return true;
+}
+
+// Emulates TJpgDec's output: MCU-row strips (16 lines), R,G,B order, start
+// and end calls with data == NULL, and abort when the writer returns false.
+esp_err_t esp_jpg_decode(size_t len, jpg_scale_t scale, jpg_reader_cb reader, jpg_writer_cb writer, void* arg) {
+  SimStageTimer t(SimStage::JpegDecode);
+  std::vector<uint8_t> src(len);
+  reader(arg, 0, src.data(), len);
+
+  jpeg_decompress_struct cinfo;
+  jpeg_error_mgr jerr;
+  cinfo.err = jpeg_std_error(&jerr);
+  jpeg_create_decompress(&cinfo);
+  jpeg_mem_src(&cinfo, src.data(), (unsigned long)len);
+  if (jpeg_read_header(&cinfo, TRUE) != JPEG_HEADER_OK) { jpeg_destroy_decompress(&cinfo); return ESP_FAIL; }
+  cinfo.out_color_space = JCS_RGB;
+  cinfo.scale_num = 1;
+  cinfo.scale_denom = 1u << (unsigned)scale;
+  jpeg_start_decompress(&cinfo);
+
+  const uint16_t W = (uint16_t)cinfo.output_width;
+  const uint16_t H = (uint16_t)cinfo.output_height;
+  writer(arg, 0, 0, W, H, nullptr);
+
+  const unsigned STRIP = 16;
+  std::vector<uint8_t> strip((size_t)W * 3 * STRIP);
+  bool ok = true;
+  while (ok && cinfo.output_scanline < H) {
+    const uint16_t y = (uint16_t)cinfo.output_scanline;
+    unsigned rows = 0;
+    while (rows < STRIP && cinfo.output_scanline < H) {
+      JSAMPROW row = strip.data() + (size_t)rows * W * 3;
+      rows += jpeg_read_scanlines(&cinfo, &row, 1);
+    }
+    ok = writer(arg, 0, y, W, (uint16_t)rows, strip.data());
+  }
+  writer(arg, W, H, W, H, nullptr);
+
+  if (ok) jpeg_finish_decompress(&cinfo);
+  else    jpeg_abort_decompress(&cinfo);
+  jpeg_destroy_decompress(&cinfo);
+  return ok ? ESP_OK : ESP_FAIL;
+}
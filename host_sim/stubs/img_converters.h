@@ -0,0 +1,11 @@
+// Host stand-in for the esp32-camera converters, backed by libjpeg.
+// Byte order matches the device: fmt2rgb888 emits B,G,R triplets and
+// fmt2jpg(PIXFORMAT_RGB888) consumes them.
+#pragma once
+#include "esp_camera.h"
+
+typedef enum { JPG_SCALE_NONE, JPG_SCALE_2X, JPG_SCALE_4X, JPG_SCALE_8X, JPG_SCALE_MAX = JPG_SCALE_8X } jpg_scale_t;
+
+bool fmt2rgb888(const uint8_t* src_buf, size_t src_len, pixformat_t format, uint8_t* rgb_buf);
+bool fmt2jpg(uint8_t* src, size_t src_len, uint16_t width, uint16_t height, pixformat_t format,
+             uint8_t quality, uint8_t** out, size_t* out_len);
@@ -0,0 +1,69 @@
+// Host stand-in for the merged Edge Impulse library (bee + varroa impulses).
+// Inference is replaced by replayable detection fixtures; see ei_stub.cpp.
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <functional>
+
+#define EI_CLASSIFIER_INPUT_WIDTH        320
+#define EI_CLASSIFIER_INPUT_HEIGHT       320
+#define EI_CLASSIFIER_OBJECT_DETECTION   1
+#define EI_CLASSIFIER_MAX_BOXES          64
+
+#define EI_VARROA_INPUT_WIDTH            160
+#define EI_VARROA_INPUT_HEIGHT           160
+
+namespace ei {
+struct signal_t {
+  std::function<int(size_t offset, size_t length, float* out_ptr)> get_data;
+  size_t total_length;
+};
+} // namespace ei
+
+typedef enum {
+  EI_IMPULSE_OK = 0,
+  EI_IMPULSE_ERROR_SHAPES_DONT_MATCH = -1,
+  EI_IMPULSE_CANCELED = -2,
+  EI_IMPULSE_DSP_ERROR = -5,
+  EI_IMPULSE_OUT_OF_MEMORY = -6,
+} EI_IMPULSE_ERROR;
+
+typedef struct {
+  const char* label;
+  uint32_t x;
+  uint32_t y;
+  uint32_t width;
+  uint32_t height;
+  float value;
+} ei_impulse_result_bounding_box_t;
+
+typedef struct {
+  int sampling;
+  int dsp;
+  int classification;
+  int anomaly;
+} ei_impulse_result_timing_t;
+
+typedef struct {
+  ei_impulse_result_bounding_box_t* bounding_boxes;
+  uint32_t bounding_boxes_count;
+  ei_impulse_result_timing_t timing;
+} ei_impulse_result_t;
+
+typedef struct {
+  const char* name;
+  int input_width;
+  int input_height;
+} ei_impulse_handle_t;
+
+ei_impulse_handle_t& ei_bee_impulse();
+ei_impulse_handle_t& ei_varroa_impulse();
+
+EI_IMPULSE_ERROR run_classifier(ei::signal_t* signal, ei_impulse_result_t* result, bool debug = false);
+EI_IMPULSE_ERROR process_impulse(ei_impulse_handle_t* handle, ei::signal_t* signal,
+                                 ei_impulse_result_t* result, bool debug = false);
+
+// Fixture/latency control (host only).
+bool sim_ei_load_bee_fixture(const char* path);
+bool sim_ei_load_varroa_fixture(const char* path);
+void sim_ei_set_latency_ms(uint32_t bee_ms, uint32_t varroa_ms);
@@ -0,0 +1,34 @@
+#include "sim_timing.h"
+#include <atomic>
+#include <stdio.h>
+
+static constexpr size_t kStages = (size_t)SimStage::Count;
+static const char* const kNames[kStages] = {
+  "camera_grab", "jpeg_decode", "jpeg_encode", "resize",
+  "bee_inference", "varroa_inference", "sd_write",
+};
+
+static std::atomic<uint64_t> g_us[kStages];
+static std::atomic<uint64_t> g_calls[kStages];
+
+void sim_timing_add(SimStage s, uint64_t us) {
+  g_us[(size_t)s] += us;
+  g_calls[(size_t)s] += 1;
+}
+
+void sim_timing_reset() {
+  for (size_t i = 0; i < kStages; ++i) { g_us[i] = 0; g_calls[i] = 0; }
+}
+
+void sim_timing_report(double wall_s, uint32_t frames) {
+  printf("\n== host_sim report ==\n");
+  printf("frames=%u wall=%.3fs fps=%.2f\n", (unsigned)frames, wall_s,
+         wall_s > 0 ? (double)frames / wall_s : 0.0);
+  printf("%-18s %10s %12s %12s %10s\n", "stage", "calls", "total_ms", "avg_us", "ms/frame");
+  for (size_t i = 0; i < kStages; ++i) {
+    const uint64_t c = g_calls[i], us = g_us[i];
+    printf("%-18s %10llu %12.2f %12.1f %10.2f\n", kNames[i], (unsigned long long)c,
+           (double)us / 1000.0, c ? (double)us / (double)c : 0.0,
+           frames ? (double)us / 1000.0 / (double)frames : 0.0);
+  }
+}
@@ -0,0 +1,31 @@
+// Host-only per-stage wall-clock accounting for the stand-in layers.
+#pragma once
+#include <stdint.h>
+#include <chrono>
+
+enum class SimStage : uint8_t {
+  CameraGrab,
+  JpegDecode,
+  JpegEncode,
+  Resize,
+  BeeInference,
+  VarroaInference,
+  SdWrite,
+  Count
+};
+
+void sim_timing_add(SimStage s, uint64_t us);
+void sim_timing_reset();
+void sim_timing_report(double wall_s, uint32_t frames);
+
+class SimStageTimer {
+public:
+  explicit SimStageTimer(SimStage s) : s_(s), t0_(std::chrono::steady_clock::now()) {}
+  ~SimStageTimer() {
+    const auto dt = std::chrono::steady_clock::now() - t0_;
+    sim_timing_add(s_, (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(dt).count());
+  }
+private:
+  SimStage s_;
+  std::chrono::steady_clock::time_point t0_;
+};
@@ -0,0 +1,51 @@
+// Track expiry counts processed frames, not wall time. At a 5 s cycle a bee
+// sitting still must be counted once, a gap shorter than TRACK_EXPIRE_FRAMES
+// must not count it again, and one that long must.
+#include "../../final_clean/src/globals.h"
+#include "../../final_clean/src/track/bee_tracker.h"
+
+#include <stdio.h>
+
+static constexpr uint32_t PERIOD_MS = 5000;
+
+static uint32_t g_now = 1000;
+static uint32_t g_frame = 0;
+static uint32_t g_failed = 0;
+
+// One processed frame holding n bees at (x, y); returns the bees counted.
+static uint32_t frame(uint32_t n, float x, float y) {
+  static BeeDetections dets, todo;
+  dets.count = n;
+  for (uint32_t i = 0; i < n; ++i) dets.items[i] = { i, x, y, 0.9f, "bee", 0 };
+  const TrackUpdate u = tracker_update(dets, g_now, todo);
+
+  // classify the due ones the way the pipeline does: bind, then let go
+  for (uint32_t i = 0; i < todo.count; ++i) tracker_bind(todo.items[i].track, g_frame, i, g_now);
+  tracker_credit(g_frame, 0, 0);
+  tracker_unbind(g_frame);
+
+  g_frame++;
+  g_now += PERIOD_MS;
+  return u.fresh;
+}
+
+static void expect(const char* what, uint32_t got, uint32_t want) {
+  if (got == want) return;
+  g_failed++;
+  printf("FAIL %s: counted %u, want %u\n", what, got, want);
+}
+
+int main() {
+  uint32_t counted = 0;
+  for (int i = 0; i < 12; ++i) counted += frame(1, 48.0f, 48.0f);
+  expect("stationary bee", counted, 1);
+
+  for (uint32_t i = 0; i + 1 < TRACK_EXPIRE_FRAMES; ++i) frame(0, 0, 0);
+  expect("short gap", frame(1, 48.0f, 48.0f), 0);
+
+  for (uint32_t i = 0; i < TRACK_EXPIRE_FRAMES; ++i) frame(0, 0, 0);
+  expect("expired", frame(1, 48.0f, 48.0f), 1);
+
+  printf("%s\n", g_failed ? "FAILED" : "ok");
+  return g_failed ? 1 : 0;
+}
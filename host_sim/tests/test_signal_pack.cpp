@@ -0,0 +1,67 @@
+// The signal shim packs model input four pixels at a time from 32-bit
+// loads. Over random buffers, every start alignment and lengths that are
+// not a multiple of 4, it must match the old per-pixel packing bit for bit:
+// src[0]<<16 | src[1]<<8 | src[2] for the bee input, and the same with R
+// and B swapped for the varroa input.
+#include "../../final_clean/src/globals.h"
+#include "../../final_clean/src/ei/ei_signal_shim.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <random>
+#include <vector>
+
+static constexpr size_t MAX_PIXELS = 1024;
+
+static float ref_pixel(const uint8_t* p, bool swap) {
+  return swap ? (float)((uint32_t)p[2] << 16 | (uint32_t)p[1] << 8 | (uint32_t)p[0])
+              : (float)((uint32_t)p[0] << 16 | (uint32_t)p[1] << 8 | (uint32_t)p[2]);
+}
+
+int main() {
+  std::mt19937 rng(12345);
+  // room for a misaligned start on either side
+  std::vector<uint8_t> buf(MAX_PIXELS * 3 + 16);
+  std::vector<float> got(MAX_PIXELS), want(MAX_PIXELS);
+  uint32_t cases = 0, failed = 0;
+
+  for (int round = 0; round < 64; ++round) {
+    for (uint8_t& b : buf) b = (uint8_t)rng();
+
+    for (size_t shift = 0; shift < 4; ++shift) {
+      uint8_t* base = buf.data() + shift;
+      const size_t lengths[] = { 0, 1, 2, 3, 4, 5, 7, 8, 13, 64, 255, (size_t)(rng() % 900) + 1 };
+      for (size_t length : lengths) {
+        const size_t offset = rng() % 17;   // moves the start by 3 bytes a pixel
+        if (offset + length > MAX_PIXELS) continue;
+
+        for (int swap = 0; swap < 2; ++swap) {
+          memset(got.data(), 0xAB, length * sizeof(float));
+          if (swap) {
+            ei_varroa_set_input(base);
+            ei_varroa_get_data(offset, length, got.data());
+          } else {
+            snapshot_buf = base;
+            ei_bee_get_data(offset, length, got.data());
+          }
+          for (size_t i = 0; i < length; ++i) want[i] = ref_pixel(base + (offset + i) * 3, swap);
+
+          cases++;
+          if (memcmp(got.data(), want.data(), length * sizeof(float)) != 0) {
+            failed++;
+            printf("FAIL %s shift=%zu offset=%zu length=%zu\n", swap ? "varroa" : "bee", shift, offset, length);
+          }
+        }
+      }
+    }
+  }
+
+  snapshot_buf = nullptr;
+  ei_varroa_set_input(nullptr);
+  if (failed) {
+    printf("%lu of %lu cases differ\n", (unsigned long)failed, (unsigned long)cases);
+    return 1;
+  }
+  printf("ok: %lu cases\n", (unsigned long)cases);
+  return 0;
+}
@@ -0,0 +1,95 @@
+// A crop of a solid-colour frame, decoded the way the crop stage does it,
+// must reach the varroa model as 0xRRGGBB: the order the baseline's
+// swap -> fmt2jpg -> fmt2rgb888 round trip handed it, and the one the model
+// was trained on. Covers the direct tile path and the resize path.
+#include "../../final_clean/src/camera/jpeg_decode.h"
+#include "../../final_clean/src/ei/ei_signal_shim.h"
+#include "edge-impulse-sdk/dsp/image/image.hpp"
+#include "merge_b.h"
+
+#include <jpeglib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+static constexpr int FRAME = 320;
+static constexpr int TOLERANCE = 8;   // JPEG noise on a flat colour
+
+struct Rgb { uint8_t r, g, b; };
+
+static std::vector<uint8_t> encode_solid(Rgb c) {
+  std::vector<uint8_t> row((size_t)FRAME * 3);
+  for (int x = 0; x < FRAME; ++x) { row[x * 3] = c.r; row[x * 3 + 1] = c.g; row[x * 3 + 2] = c.b; }
+
+  jpeg_compress_struct ci;
+  jpeg_error_mgr jerr;
+  ci.err = jpeg_std_error(&jerr);
+  jpeg_create_compress(&ci);
+  unsigned char* out = nullptr;
+  unsigned long out_len = 0;
+  jpeg_mem_dest(&ci, &out, &out_len);
+  ci.image_width = FRAME;
+  ci.image_height = FRAME;
+  ci.input_components = 3;
+  ci.in_color_space = JCS_RGB;
+  jpeg_set_defaults(&ci);
+  jpeg_set_quality(&ci, 95, TRUE);
+  jpeg_start_compress(&ci, TRUE);
+  while (ci.next_scanline < ci.image_height) {
+    JSAMPROW r = row.data();
+    jpeg_write_scanlines(&ci, &r, 1);
+  }
+  jpeg_finish_compress(&ci);
+  jpeg_destroy_compress(&ci);
+
+  std::vector<uint8_t> jpg(out, out + out_len);
+  free(out);
+  return jpg;
+}
+
+static bool near(uint32_t got, uint8_t want) {
+  return abs((int)got - (int)want) <= TOLERANCE;
+}
+
+// Every packed pixel of the model input holds c as 0xRRGGBB.
+static bool check_input(const char* what, Rgb c, size_t pixels) {
+  std::vector<float> px(pixels);
+  ei_varroa_get_data(0, pixels, px.data());
+  for (size_t i = 0; i < pixels; ++i) {
+    const uint32_t v = (uint32_t)px[i];
+    if (!near(v >> 16, c.r) || !near((v >> 8) & 0xffu, c.g) || !near(v & 0xffu, c.b)) {
+      printf("FAIL %s colour %02x%02x%02x: pixel %zu reached the model as %06lx\n",
+             what, c.r, c.g, c.b, i, (unsigned long)v);
+      return false;
+    }
+  }
+  return true;
+}
+
+int main() {
+  const Rgb colours[] = { {255, 0, 0}, {0, 0, 255}, {0, 255, 0}, {200, 120, 40} };
+  std::vector<uint8_t> tile((size_t)CROP_SIZE * CROP_SIZE * 3);
+  std::vector<uint8_t> resized((size_t)EI_VARROA_INPUT_WIDTH * EI_VARROA_INPUT_HEIGHT * 3);
+  int failed = 0;
+
+  for (const Rgb& c : colours) {
+    const std::vector<uint8_t> jpg = encode_solid(c);
+    const JpegWindow win = { 64, 64, (uint16_t)CROP_SIZE, (uint16_t)CROP_SIZE, tile.data() };
+    if (!jpeg_decode_windows(jpg.data(), jpg.size(), &win, 1)) {
+      printf("FAIL window decode\n");
+      return 1;
+    }
+
+    ei_varroa_set_input(tile.data());
+    if (!check_input("tile", c, (size_t)CROP_SIZE * CROP_SIZE)) failed++;
+
+    ei::image::processing::crop_and_interpolate_rgb888(tile.data(), CROP_SIZE, CROP_SIZE, resized.data(),
+                                                        EI_VARROA_INPUT_WIDTH, EI_VARROA_INPUT_HEIGHT);
+    ei_varroa_set_input(resized.data());
+    if (!check_input("resized", c, (size_t)EI_VARROA_INPUT_WIDTH * EI_VARROA_INPUT_HEIGHT)) failed++;
+  }
+
+  if (failed) return 1;
+  printf("ok\n");
+  return 0;
+}
@@ -0,0 +1,151 @@
+"""Decode a binary session log (/logs/boot_NNNNNN.blg) back into the text log.
+
+Usage:
+    python tools/decode_log.py boot_000001.blg [-o boot_000001.txt] [--timestamps]
+
+The event table is read from final_clean/src/log/evlog_events.h, so decode with
+the same source tree the firmware was built from (a table hash mismatch is
+reported as a warning).
+"""
+
+import argparse
+import re
+import struct
+import sys
+from pathlib import Path
+
+DEFAULT_EVENTS_H = Path(__file__).resolve().parent.parent / "final_clean" / "src" / "log" / "evlog_events.h"
+
+MAGIC = b"EVLG"
+FILE_HEADER = struct.Struct("<4sBBHI")   # magic, version, record header size, event count, table hash
+RECORD_HEADER = struct.Struct("<HHI")    # id, args length, millis
+
+_EVENT_RE = re.compile(r'X\(\s*(\w+)\s*,\s*(\w+)\s*,\s*(\w+)\s*,\s*("(?:[^"\\]|\\.)*")\s*\)')
+_SPEC_RE = re.compile(r"%(?P<flags>[-+ #0]*)(?P<width>\d+)?(?:\.(?P<prec>\d+))?(?:hh|h|ll|l|z|j|t|L)?(?P<conv>[diouxXeEfFgGcs%])")
+_ESCAPES = {"n": "\n", "t": "\t", "r": "\r", '"': '"', "\\": "\\", "0": "\0"}
+
+
+def _unescape_c(lit: str) -> str:
+    body = lit[1:-1]
+    return re.sub(r"\\(.)", lambda m: _ESCAPES.get(m.group(1), m.group(1)), body)
+
+
+def load_events(path: Path) -> list:
+    text = path.read_text(encoding="utf-8")
+    events = []
+    for m in _EVENT_RE.finditer(text):
+        events.append((m.group(1), _unescape_c(m.group(4))))
+    if not events:
+        raise SystemExit(f"no events found in {path}")
+    return events
+
+
+def table_hash(events: list) -> int:
+    # must match table_hash() in evlog.cpp: FNV-1a over each format plus its NUL
+    h = 2166136261
+    for _, fmt in events:
+        for b in fmt.encode("latin-1") + b"\0":
+            h ^= b
+            h = (h * 16777619) & 0xFFFFFFFF
+    return h
+
+
+def read_args(buf: bytes) -> list:
+    args, p = [], 0
+    while p < len(buf):
+        tag = chr(buf[p]); p += 1
+        if tag in "iu":
+            args.append(struct.unpack_from("<i" if tag == "i" else "<I", buf, p)[0]); p += 4
+        elif tag in "IU":
+            args.append(struct.unpack_from("<q" if tag == "I" else "<Q", buf, p)[0]); p += 8
+        elif tag == "f":
+            args.append(struct.unpack_from("<f", buf, p)[0]); p += 4
+        elif tag == "s":
+            n = buf[p]; p += 1
+            args.append(buf[p:p + n].decode("latin-1")); p += n
+        else:
+            break
+    return args
+
+
+def format_event(fmt: str, args: list) -> str:
+    it = iter(args)
+
+    def one(m):
+        conv = m.group("conv")
+        if conv == "%":
+            return "%"
+        spec = "%" + m.group("flags") + (m.group("width") or "") + (("." + m.group("prec")) if m.group("prec") else "")
+        v = next(it, "?")
+        if conv in "di":
+            return (spec + "d") % int(v) if not isinstance(v, str) else v
+        if conv in "uoxX":
+            if isinstance(v, str):
+                return v
+            v = int(v)
+            if v < 0:
+                v &= 0xFFFFFFFF
+            return (spec + ("d" if conv == "u" else conv)) % v
+        if conv in "eEfFgG":
+            return (spec + conv) % float(v) if not isinstance(v, str) else v
+        if conv == "c":
+            return chr(int(v))
+        return (spec + "s") % v
+
+    return _SPEC_RE.sub(one, fmt)
+
+
+def decode(data: bytes, events: list, timestamps: bool, out) -> int:
+    if len(data) < FILE_HEADER.size:
+        raise SystemExit("file too short")
+    magic, version, rec_hdr, count, file_hash = FILE_HEADER.unpack_from(data, 0)
+    if magic != MAGIC:
+        raise SystemExit("not an EVLG log")
+    if version != 1 or rec_hdr != RECORD_HEADER.size:
+        raise SystemExit(f"unsupported log version={version} header={rec_hdr}")
+    if count != len(events) or file_hash != table_hash(events):
+        print(f"warning: log was written with a different event table "
+              f"(file {count} events hash={file_hash:08x}, source {len(events)} hash={table_hash(events):08x})",
+              file=sys.stderr)
+
+    p, n = FILE_HEADER.size, 0
+    while p + RECORD_HEADER.size <= len(data):
+        ev_id, length, ms = RECORD_HEADER.unpack_from(data, p)
+        p += RECORD_HEADER.size
+        if p + length > len(data):
+            print("warning: log ends mid-record (truncated)", file=sys.stderr)
+            break
+        args = read_args(data[p:p + length])
+        p += length
+
+        if ev_id < len(events):
+            line = format_event(events[ev_id][1], args)
+        else:
+            line = f"EVLOG unknown id={ev_id}\n"
+        if timestamps:
+            line = f"[{ms:>9}] " + line
+        out.write(line)
+        n += 1
+    return n
+
+
+def main() -> None:
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("log", type=Path)
+    ap.add_argument("-o", "--out", type=Path, help="write text here instead of stdout")
+    ap.add_argument("--events", type=Path, default=DEFAULT_EVENTS_H, help="path to evlog_events.h")
+    ap.add_argument("--timestamps", action="store_true", help="prefix each event with its millis() stamp")
+    a = ap.parse_args()
+
+    events = load_events(a.events)
+    data = a.log.read_bytes()
+    if a.out:
+        with a.out.open("w", encoding="utf-8", newline="\n") as f:
+            n = decode(data, events, a.timestamps, f)
+        print(f"{n} events -> {a.out}", file=sys.stderr)
+    else:
+        decode(data, events, a.timestamps, sys.stdout)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,78 @@
+"""List or extract the entries of a boot's pack file (/packs/boot_NNNNNN.pak).
+
+Usage:
+    python tools/unpack_pack.py boot_000001.pak            # list entries
+    python tools/unpack_pack.py boot_000001.pak -o out/    # extract as out/<name>
+
+Entries are read from their blob headers, so a pack cut short by a power loss
+(index segments missing for the newest entries) unpacks all the same. The
+layout is described in final_clean/src/sd/sd_pack.h.
+"""
+
+import argparse
+import struct
+import sys
+from pathlib import Path
+
+PACK_MAGIC = 0x314B4150   # "PAK1"
+BLOB_MAGIC = 0x31424C42   # "BLB1"
+SEG_MAGIC = 0x31584449    # "IDX1"
+DATA_START = 512
+
+HEADER = struct.Struct("<5I")          # magic, boot, last_seg, sealed, data_end
+ENTRY = struct.Struct("<3I52s")        # off, len, frame, name
+BLOB = struct.Struct("<2I")            # magic, id; an ENTRY follows
+SEGMENT = struct.Struct("<5I")         # magic, first_id, count, prev, sum
+
+
+def read_entries(data: bytes):
+    magic, boot, _last_seg, _sealed, _data_end = HEADER.unpack_from(data, 0)
+    if magic != PACK_MAGIC:
+        raise ValueError("not a pack file")
+
+    entries, off, next_id = [], DATA_START, 0
+    while off + BLOB.size + ENTRY.size <= len(data):
+        magic, ident = BLOB.unpack_from(data, off)
+        if magic == SEG_MAGIC:
+            count = SEGMENT.unpack_from(data, off)[2]
+            off += SEGMENT.size + count * ENTRY.size
+            continue
+        if magic != BLOB_MAGIC or ident != next_id:
+            break
+        e_off, e_len, frame, name = ENTRY.unpack_from(data, off + BLOB.size)
+        if e_off + e_len > len(data):
+            break
+        entries.append((ident, name.split(b"\0", 1)[0].decode(errors="replace"), frame, e_off, e_len))
+        next_id += 1
+        off = e_off + e_len
+    return boot, entries
+
+
+def main() -> int:
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("pack", type=Path)
+    ap.add_argument("-o", "--out", type=Path, help="extract entries under this directory")
+    args = ap.parse_args()
+
+    data = args.pack.read_bytes()
+    try:
+        boot, entries = read_entries(data)
+    except (ValueError, struct.error) as exc:
+        print(f"{args.pack}: {exc}", file=sys.stderr)
+        return 1
+
+    for ident, name, frame, off, length in entries:
+        if args.out:
+            dst = args.out / name
+            if ".." in Path(name).parts:
+                continue
+            dst.parent.mkdir(parents=True, exist_ok=True)
+            dst.write_bytes(data[off:off + length])
+        else:
+            print(f"{ident:6d}  frame {frame:6d}  {length:8d}  {name}")
+    print(f"boot {boot}: {len(entries)} entries", file=sys.stderr)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())